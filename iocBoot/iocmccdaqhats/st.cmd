@@ -10,8 +10,11 @@ dbLoadDatabase "$(TOP)/dbd/mccdaqhats.dbd"
 mccdaqhats_registerRecordDeviceDriver(pdbbase)
 
 # initialize controller
-# portname, timeout
+# portname, timeout, (optional) address list
 mccdaqhatsInitialize("MYPORT", 1)
+# alternative: split modules across ports, every port has its own lock and thread
+#mccdaqhatsInitialize("FASTPORT", 1, "0,1")
+#mccdaqhatsInitialize("SLOWPORT", 1, "2-7")
 
 # write to DB file, what was found
 # (optional) portname, required filename
@@ -9,12 +9,20 @@
 #include <epicsExport.h>
 #include <epicsStdlib.h>
 #include <epicsThread.h>
+#include <epicsEvent.h>
+#include <epicsTime.h>
 #include <epicsMath.h>
+#include <epicsAtomic.h>
+#include <ellLib.h>
 #include <iocsh.h>
 #include <asynPortClient.h>
 #include <daqhats/daqhats.h>
 #include "mccdaqhats.h"
+#include "mccdaqhatsBlock.h"
+#include "mccdaqhatsBus.h"
+#include "mccdaqhatsDsp.h"
 #include <limits>
+#include <deque>
 
 #ifndef ARRAY_SIZE
 /// preprocessor helper macro to return the length of a static array
@@ -39,6 +47,9 @@
  * parameters
  * ======================================================================== */
 
+/// preprocessor helper macro for a parameter with 8 consecutive channel ids
+#define MCCDAQHAT_PER_CHANNEL(x) x##0, x##1, x##2, x##3, x##4, x##5, x##6, x##7
+
 /**
  * @brief The ParameterId enumeration defines internal parameter meanings.
  */
@@ -82,6 +93,9 @@ enum ParameterId
     MCCDAQHAT_DO,          // MCC152 DIO digital outputs
     MCCDAQHAT_MASK,        // channel bit mask
     MCCDAQHAT_START,       // acquisition status
+    MCCDAQHAT_STATE,       // acquisition state machine
+    MCCDAQHAT_BUSY,        // start/stop command pending
+    MCCDAQHAT_GAP,         // acquisition gap of last reconfiguration
     MCCDAQHAT_RATE,        // clock rate
     MCCDAQHAT_TRIG,        // trigger configuration
     MCCDAQHAT_CLKSRC,      // clock pin configuration
@@ -92,9 +106,102 @@ enum ParameterId
     MCCDAQHAT_IN_PULL_CFG, // MCC152 pullup configuration
     MCCDAQHAT_IN_INV,      // MCC152 data inversion
     MCCDAQHAT_IN_LATCH,    // MCC152 data latch
-    MCCDAQHAT_OUT_TYPE     // MCC152 output type
+    MCCDAQHAT_OUT_TYPE,    // MCC152 output type
+    MCCDAQHAT_BUS_LOAD,    // predicted load of all running scans
+    MCCDAQHAT_BUS_LIMIT,   // allowed load for admission control
+    MCCDAQHAT_BUS_POLICY,  // admission control: warn or refuse
+    MCCDAQHAT_BUS_WAIT_STREAM, // maximum bus wait of scan data
+    MCCDAQHAT_BUS_WAIT_INTR,   // maximum bus wait of interrupt service
+    MCCDAQHAT_BUS_WAIT_CONFIG, // maximum bus wait of configuration and slow reads
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_DEC_FACTOR), // decimation factor, 1=disabled
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_DEC_TYPE),   // decimation filter type
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_DEC_C),      // decimated channel values
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_DEC_VAL),    // last decimated channel value
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_STAT_MODE),  // statistics window
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_STAT_N),     // statistics: sliding window length
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_STAT_RESET), // statistics: reset cumulative statistics
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_STAT_MEAN),  // statistics: mean
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_STAT_RMS),   // statistics: root mean square
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_STAT_MIN),   // statistics: minimum
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_STAT_MAX),   // statistics: maximum
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_STAT_STD),   // statistics: standard deviation
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_FFT_MODE),   // spectrum output type
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_FFT_SIZE),   // spectrum: FFT size
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_FFT_WIN),    // spectrum: window function
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_FFT_OVERLAP),// spectrum: segment overlap in percent
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_FFT_AVG),    // spectrum: number of averaged segments
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_FFT_SPEC),   // spectrum: magnitude or PSD
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_FFT_FREQ),   // spectrum: frequency axis
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_SCOPE_C),    // scope: captured channel values
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_HIST_LEN),   // history: length in samples
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_HIST_RATE),  // history: maximum update rate
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_HIST_C),     // history: channel values
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_LOD_TIME),   // envelope: retention time
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_LOD_AGO),    // envelope: end of requested range before now
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_LOD_SPAN),   // envelope: length of requested range
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_LOD_WIDTH),  // envelope: number of pixels
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_LOD_RATE),   // envelope: update rate
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_LOD_ENV),    // envelope: min/max pairs
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_LOD_MEAN),   // envelope: mean values
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_LOD_DT),     // envelope: time per pixel
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_ROI_START),  // region of interest: first sample of block
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_ROI_LEN),    // region of interest: number of samples
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_ROI_C),      // region of interest: channel values
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_LAST),       // latest value with deadband
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_LAST_SRC),   // latest value: last sample or block mean
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_LAST_DB),    // latest value: deadband
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_LAST_DBMODE),// latest value: absolute or relative deadband
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_EU_MODE),    // engineering unit conversion type
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_EU_COEF),    // engineering unit conversion coefficients or table
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_IIR_TYPE),   // IIR filter type
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_IIR_FREQ),   // IIR filter: cutoff or center frequency
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_IIR_Q),      // IIR filter: quality factor
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_IIR_STAGES), // IIR filter: number of cascaded biquads
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_IIR_OUT),    // IIR filter: separate waveform or inline
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_IIR_C),      // IIR filter: filtered channel values
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_EVT_MODE),   // events: detected level crossings
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_EVT_LEVEL),  // events: threshold
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_EVT_HYST),   // events: hysteresis
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_EVT_COUNT),  // events: number of events
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_EVT_TIME),   // events: time of last event
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_EVT_LIST),   // events: time and direction of events
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_FREQ_GATE),  // frequency counter: gate time
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_FREQ_LEVEL), // frequency counter: threshold
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_FREQ_HYST),  // frequency counter: hysteresis
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_FREQ),       // frequency counter: frequency
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_FREQ_PERIOD),// frequency counter: mean period
+    MCCDAQHAT_PER_CHANNEL(MCCDAQHAT_FREQ_JITTER),// frequency counter: standard deviation of period
+    MCCDAQHAT_SCOPE_MODE,  // scope: trigger mode
+    MCCDAQHAT_SCOPE_SRC,   // scope: trigger channel
+    MCCDAQHAT_SCOPE_LEVEL, // scope: trigger level
+    MCCDAQHAT_SCOPE_SLOPE, // scope: trigger slope
+    MCCDAQHAT_SCOPE_HYST,  // scope: trigger hysteresis
+    MCCDAQHAT_SCOPE_PRE,   // scope: samples before trigger
+    MCCDAQHAT_SCOPE_POST,  // scope: samples from trigger on
+    MCCDAQHAT_SCOPE_ARM,   // scope: arm single capture
+    MCCDAQHAT_SCOPE_STATE, // scope: trigger state
+    MCCDAQHAT_SCOPE_COUNT, // scope: number of captures
+    MCCDAQHAT_PUB_RATE,    // maximum publish rate of waveforms and scalars
+    MCCDAQHAT_PUB_MAX,     // maximum length of concatenated waveforms
+    MCCDAQHAT_BLOCK_MODE,  // multi-channel block: layout
+    MCCDAQHAT_BLOCK_C,     // multi-channel block: values of all channels
+    MCCDAQHAT_BLOCK_SHAPE, // multi-channel block: channels, samples, channel numbers
+    MCCDAQHAT_BLOCK_PTR,   // block for in-process consumers (struct mccdaqhatsBlock)
+    MCCDAQHAT_BLOCK_SEQ,   // counter of published blocks
+    MCCDAQHAT_LAZY,        // process outputs with interrupt users only
+    MCCDAQHAT_VIRT_EXPR0,  // virtual channel 0: expression
+    MCCDAQHAT_VIRT_EXPR1,  // virtual channel 1: expression
+    MCCDAQHAT_VIRT_EXPR2,  // virtual channel 2: expression
+    MCCDAQHAT_VIRT_EXPR3,  // virtual channel 3: expression
+    MCCDAQHAT_VIRT_C0,     // virtual channel 0: values
+    MCCDAQHAT_VIRT_C1,     // virtual channel 1: values
+    MCCDAQHAT_VIRT_C2,     // virtual channel 2: values
+    MCCDAQHAT_VIRT_C3      // virtual channel 3: values
 };
 
+/// number of virtual channels of a streaming module
+#define MCCDAQHAT_VIRTUAL_CHANNELS 4
+
 /**
  * @brief The paramMccDaqHats struct defines asyn parameter mappings.
  */
@@ -102,7 +209,7 @@ struct paramMccDaqHats
 {
     int         iAsynReason;  ///< for later: asyn reason/index for registered parameter
     epicsUInt8  byAddress;    ///< HAT address
-    epicsUInt16 wHatID;       ///< HAT id -> hardware type
+    epicsUInt16 wHatID;       ///< HAT id -> hardware type (0=shared SPI bus)
     ParameterId iHatParam;    ///< parameter id
     bool        bWritable;    ///< data direction for generated DB file
     std::string sDescription; ///< description for generated DB file
@@ -110,14 +217,815 @@ struct paramMccDaqHats
     std::vector<double>      adCache; ///< cache of last read data
 };
 
+/**
+ * @brief The streamParamMccDaqHats struct defines parameters of the stream processing stages;
+ *        they are created for every channel of a streaming module (MCC118, MCC128, MCC172)
+ *        and the writeable ones are checked against their limits
+ */
+static const struct streamParamMccDaqHats
+{
+    const char*   szSuffix;   ///< parameter name, the channel number is appended
+    asynParamType iAsynType;  ///< asyn parameter type
+    ParameterId   iHatParam;  ///< parameter id of 1st channel
+    bool          bWriteable; ///< data direction
+    const char*   szDesc;     ///< description for generated DB file
+    const char*   szEnum;     ///< enumeration or nullptr
+    double        dMin;       ///< minimum value of writeable parameter
+    double        dMax;       ///< maximum value of writeable parameter
+    double        dDefault;   ///< initial value
+} g_aStreamParams[] =
+{
+    { "DEC_FACTOR", asynParamInt32,        MCCDAQHAT_DEC_FACTOR0, true,  "decimation factor (1=off)", nullptr,          1., 4096., 1. },
+    { "DEC_TYPE",   asynParamInt32,        MCCDAQHAT_DEC_TYPE0,   true,  "decimation filter",         "boxcar|CIC|FIR", 0.,    2., 0. },
+    { "DEC_C",      asynParamFloat64Array, MCCDAQHAT_DEC_C0,      false, "decimated channel values",  nullptr,          0.,    0., 0. },
+    { "DEC_VAL",    asynParamFloat64,      MCCDAQHAT_DEC_VAL0,    false, "last decimated value",      nullptr,          0.,    0., 0. },
+    { "STAT_MODE",  asynParamInt32,        MCCDAQHAT_STAT_MODE0,  true,  "statistics window",         "off|block|sliding|cumulative", 0., 3., 0. },
+    { "STAT_N",     asynParamInt32,        MCCDAQHAT_STAT_N0,     true,  "statistics sliding length", nullptr,          2., 1000000., 1000. },
+    { "STAT_RESET", asynParamInt32,        MCCDAQHAT_STAT_RESET0, true,  "reset statistics",          "idle|reset",     0.,    1., 0. },
+    { "STAT_MEAN",  asynParamFloat64,      MCCDAQHAT_STAT_MEAN0,  false, "statistics mean",           nullptr,          0.,    0., 0. },
+    { "STAT_RMS",   asynParamFloat64,      MCCDAQHAT_STAT_RMS0,   false, "statistics RMS",            nullptr,          0.,    0., 0. },
+    { "STAT_MIN",   asynParamFloat64,      MCCDAQHAT_STAT_MIN0,   false, "statistics minimum",        nullptr,          0.,    0., 0. },
+    { "STAT_MAX",   asynParamFloat64,      MCCDAQHAT_STAT_MAX0,   false, "statistics maximum",        nullptr,          0.,    0., 0. },
+    { "STAT_STD",   asynParamFloat64,      MCCDAQHAT_STAT_STD0,   false, "statistics std deviation",  nullptr,          0.,    0., 0. },
+    { "FFT_MODE",   asynParamInt32,        MCCDAQHAT_FFT_MODE0,   true,  "spectrum output",           "off|magnitude|PSD", 0., 2., 0. },
+    { "FFT_SIZE",   asynParamInt32,        MCCDAQHAT_FFT_SIZE0,   true,  "FFT size (power of two)",   nullptr,          64., 16384., 1024. },
+    { "FFT_WIN",    asynParamInt32,        MCCDAQHAT_FFT_WIN0,    true,  "FFT window",                "rect|Hann|Hamming|Blackman", 0., 3., 1. },
+    { "FFT_OVERLAP",asynParamInt32,        MCCDAQHAT_FFT_OVERLAP0,true,  "FFT overlap in %",          nullptr,          0.,   90., 50. },
+    { "FFT_AVG",    asynParamInt32,        MCCDAQHAT_FFT_AVG0,    true,  "FFT averages",              nullptr,          1., 1000., 1. },
+    { "FFT_SPEC",   asynParamFloat64Array, MCCDAQHAT_FFT_SPEC0,   false, "spectrum",                  nullptr,          0.,    0., 0. },
+    { "FFT_FREQ",   asynParamFloat64Array, MCCDAQHAT_FFT_FREQ0,   false, "spectrum frequency axis",   nullptr,          0.,    0., 0. },
+    { "SCOPE_C",    asynParamFloat64Array, MCCDAQHAT_SCOPE_C0,    false, "scope capture",             nullptr,          0.,    0., 0. },
+    { "HIST_LEN",   asynParamInt32,        MCCDAQHAT_HIST_LEN0,   true,  "history length (0=off)",    nullptr,          0., 4000000., 0. },
+    { "HIST_RATE",  asynParamFloat64,      MCCDAQHAT_HIST_RATE0,  true,  "history update rate in Hz", nullptr,          0.,  100., 1. },
+    { "HIST_C",     asynParamFloat64Array, MCCDAQHAT_HIST_C0,     false, "history",                   nullptr,          0.,    0., 0. },
+    { "LOD_TIME",   asynParamFloat64,      MCCDAQHAT_LOD_TIME0,   true,  "envelope retention in s",   nullptr,          0., 86400., 0. },
+    { "LOD_AGO",    asynParamFloat64,      MCCDAQHAT_LOD_AGO0,    true,  "envelope end before now",   nullptr,          0., 86400., 0. },
+    { "LOD_SPAN",   asynParamFloat64,      MCCDAQHAT_LOD_SPAN0,   true,  "envelope range in s",       nullptr,       1e-6, 86400., 60. },
+    { "LOD_WIDTH",  asynParamInt32,        MCCDAQHAT_LOD_WIDTH0,  true,  "envelope pixels",           nullptr,          1., 5000., 1000. },
+    { "LOD_RATE",   asynParamFloat64,      MCCDAQHAT_LOD_RATE0,   true,  "envelope update rate in Hz",nullptr,          0.,   10., 1. },
+    { "LOD_ENV",    asynParamFloat64Array, MCCDAQHAT_LOD_ENV0,    false, "envelope min/max pairs",    nullptr,          0.,    0., 0. },
+    { "LOD_MEAN",   asynParamFloat64Array, MCCDAQHAT_LOD_MEAN0,   false, "envelope mean",             nullptr,          0.,    0., 0. },
+    { "LOD_DT",     asynParamFloat64,      MCCDAQHAT_LOD_DT0,     false, "envelope time per pixel",   nullptr,          0.,    0., 0. },
+    { "ROI_START",  asynParamInt32,        MCCDAQHAT_ROI_START0,  true,  "ROI first sample of block", nullptr,          0., 1e6,  0. },
+    { "ROI_LEN",    asynParamInt32,        MCCDAQHAT_ROI_LEN0,    true,  "ROI length (0=off)",        nullptr,          0., 1e6,  0. },
+    { "ROI_C",      asynParamFloat64Array, MCCDAQHAT_ROI_C0,      false, "ROI channel values",        nullptr,          0.,    0., 0. },
+    { "LAST",       asynParamFloat64,      MCCDAQHAT_LAST0,       false, "latest value",              nullptr,          0.,    0., 0. },
+    { "LAST_SRC",   asynParamInt32,        MCCDAQHAT_LAST_SRC0,   true,  "latest value source",       "last|mean",      0.,    1., 0. },
+    { "LAST_DB",    asynParamFloat64,      MCCDAQHAT_LAST_DB0,    true,  "latest value deadband",     nullptr,          0.,  1e6,  0. },
+    { "LAST_DBMODE",asynParamInt32,        MCCDAQHAT_LAST_DBMODE0,true,  "deadband type",             "absolute|relative", 0., 1., 0. },
+    { "EU_MODE",    asynParamInt32,        MCCDAQHAT_EU_MODE0,    true,  "unit conversion",           "off|linear|polynomial|table", 0., 3., 0. },
+    { "EU_COEF",    asynParamFloat64Array, MCCDAQHAT_EU_COEF0,    true,  "unit conversion coeff.",    nullptr,          0.,    0., 0. },
+    { "IIR_TYPE",   asynParamInt32,        MCCDAQHAT_IIR_TYPE0,   true,  "IIR filter type",           "off|low-pass|high-pass|band-pass|notch", 0., 4., 0. },
+    { "IIR_FREQ",   asynParamFloat64,      MCCDAQHAT_IIR_FREQ0,   true,  "IIR frequency in Hz",       nullptr,      0.001, 1e5,  50. },
+    { "IIR_Q",      asynParamFloat64,      MCCDAQHAT_IIR_Q0,      true,  "IIR quality factor",        nullptr,         0.1, 1000., 0.7071 },
+    { "IIR_STAGES", asynParamInt32,        MCCDAQHAT_IIR_STAGES0, true,  "IIR cascaded biquads",      nullptr,          1.,    8., 1. },
+    { "IIR_OUT",    asynParamInt32,        MCCDAQHAT_IIR_OUT0,    true,  "IIR output",                "waveform|inline",0.,    1., 0. },
+    { "IIR_C",      asynParamFloat64Array, MCCDAQHAT_IIR_C0,      false, "filtered channel values",   nullptr,          0.,    0., 0. },
+    { "EVT_MODE",   asynParamInt32,        MCCDAQHAT_EVT_MODE0,   true,  "event detection",           "off|rising|falling|both", 0., 3., 0. },
+    { "EVT_LEVEL",  asynParamFloat64,      MCCDAQHAT_EVT_LEVEL0,  true,  "event threshold",           nullptr,       -1e6,  1e6,  0. },
+    { "EVT_HYST",   asynParamFloat64,      MCCDAQHAT_EVT_HYST0,   true,  "event hysteresis",          nullptr,          0.,  1e6,  0. },
+    { "EVT_COUNT",  asynParamInt32,        MCCDAQHAT_EVT_COUNT0,  false, "number of events",          nullptr,          0.,    0., 0. },
+    { "EVT_TIME",   asynParamFloat64,      MCCDAQHAT_EVT_TIME0,   false, "time of last event",        nullptr,          0.,    0., 0. },
+    { "EVT_LIST",   asynParamFloat64Array, MCCDAQHAT_EVT_LIST0,   false, "event times, directions",   nullptr,          0.,    0., 0. },
+    { "FREQ_GATE",  asynParamFloat64,      MCCDAQHAT_FREQ_GATE0,  true,  "frequency gate in s (0=off)",nullptr,         0.,  100., 0. },
+    { "FREQ_LEVEL", asynParamFloat64,      MCCDAQHAT_FREQ_LEVEL0, true,  "frequency threshold",       nullptr,       -1e6,  1e6,  0. },
+    { "FREQ_HYST",  asynParamFloat64,      MCCDAQHAT_FREQ_HYST0,  true,  "frequency hysteresis",      nullptr,          0.,  1e6,  0. },
+    { "FREQ",       asynParamFloat64,      MCCDAQHAT_FREQ0,       false, "frequency in Hz",           nullptr,          0.,    0., 0. },
+    { "FREQ_PERIOD",asynParamFloat64,      MCCDAQHAT_FREQ_PERIOD0,false, "mean period in s",          nullptr,          0.,    0., 0. },
+    { "FREQ_JITTER",asynParamFloat64,      MCCDAQHAT_FREQ_JITTER0,false, "period std deviation in s", nullptr,          0.,    0., 0. }
+};
+
+/**
+ * @brief The g_aBoardStreamParams table defines the stream processing parameters of a module,
+ *        which exist once per streaming module and have no channel number
+ */
+static const struct streamParamMccDaqHats g_aBoardStreamParams[] =
+{
+    { "SCOPE_MODE",  asynParamInt32,   MCCDAQHAT_SCOPE_MODE,  true,  "scope trigger mode",    "off|auto|normal|single", 0., 3., 0. },
+    { "SCOPE_SRC",   asynParamInt32,   MCCDAQHAT_SCOPE_SRC,   true,  "scope trigger channel", nullptr,           0.,     7., 0. },
+    { "SCOPE_LEVEL", asynParamFloat64, MCCDAQHAT_SCOPE_LEVEL, true,  "scope trigger level",   nullptr,        -1e6,    1e6, 0. },
+    { "SCOPE_SLOPE", asynParamInt32,   MCCDAQHAT_SCOPE_SLOPE, true,  "scope trigger slope",   "rising|falling",  0.,     1., 0. },
+    { "SCOPE_HYST",  asynParamFloat64, MCCDAQHAT_SCOPE_HYST,  true,  "scope hysteresis",      nullptr,           0.,    1e6, 0. },
+    { "SCOPE_PRE",   asynParamInt32,   MCCDAQHAT_SCOPE_PRE,   true,  "scope pre-trigger len", nullptr,           0., 10000., 100. },
+    { "SCOPE_POST",  asynParamInt32,   MCCDAQHAT_SCOPE_POST,  true,  "scope post-trigger len",nullptr,           1., 10000., 900. },
+    { "SCOPE_ARM",   asynParamInt32,   MCCDAQHAT_SCOPE_ARM,   true,  "scope arm single",      "idle|arm",        0.,     1., 0. },
+    { "SCOPE_STATE", asynParamInt32,   MCCDAQHAT_SCOPE_STATE, false, "scope state",           "idle|waiting|triggered|done", 0., 0., 0. },
+    { "SCOPE_COUNT", asynParamInt32,   MCCDAQHAT_SCOPE_COUNT, false, "scope captures",        nullptr,           0.,     0., 0. },
+    { "PUB_RATE",    asynParamFloat64, MCCDAQHAT_PUB_RATE,    true,  "max. publish rate in Hz",nullptr,          0.,  1000., 0. },
+    { "PUB_MAX",     asynParamInt32,   MCCDAQHAT_PUB_MAX,     true,  "max. concatenated length",nullptr,       100.,   1e7, 10000. },
+    { "BLOCK_MODE",  asynParamInt32,   MCCDAQHAT_BLOCK_MODE,  true,  "block layout",          "off|interleaved|channel-major", 0., 2., 0. },
+    { "BLOCK_C",     asynParamFloat64Array, MCCDAQHAT_BLOCK_C, false, "block of all channels", nullptr,          0.,     0., 0. },
+    { "BLOCK_SHAPE", asynParamFloat64Array, MCCDAQHAT_BLOCK_SHAPE, false, "block shape",     nullptr,          0.,     0., 0. },
+    { "BLOCK_PTR",   asynParamGenericPointer, MCCDAQHAT_BLOCK_PTR, false, "block for in-process consumers", nullptr, 0., 0., 0. },
+    { "BLOCK_SEQ",   asynParamInt32,   MCCDAQHAT_BLOCK_SEQ,   false, "published blocks",      nullptr,           0.,     0., 0. },
+    { "LAZY",        asynParamInt32,   MCCDAQHAT_LAZY,        true,  "process subscribed only","off|on",          0.,     1., 0. },
+    { "VIRT_EXPR0",  asynParamOctet,   MCCDAQHAT_VIRT_EXPR0,  true,  "virtual channel 0 expr.",nullptr,          0.,     0., 0. },
+    { "VIRT_EXPR1",  asynParamOctet,   MCCDAQHAT_VIRT_EXPR1,  true,  "virtual channel 1 expr.",nullptr,          0.,     0., 0. },
+    { "VIRT_EXPR2",  asynParamOctet,   MCCDAQHAT_VIRT_EXPR2,  true,  "virtual channel 2 expr.",nullptr,          0.,     0., 0. },
+    { "VIRT_EXPR3",  asynParamOctet,   MCCDAQHAT_VIRT_EXPR3,  true,  "virtual channel 3 expr.",nullptr,          0.,     0., 0. },
+    { "VIRT_C0",     asynParamFloat64Array, MCCDAQHAT_VIRT_C0, false, "virtual channel 0",    nullptr,           0.,     0., 0. },
+    { "VIRT_C1",     asynParamFloat64Array, MCCDAQHAT_VIRT_C1, false, "virtual channel 1",    nullptr,           0.,     0., 0. },
+    { "VIRT_C2",     asynParamFloat64Array, MCCDAQHAT_VIRT_C2, false, "virtual channel 2",    nullptr,           0.,     0., 0. },
+    { "VIRT_C3",     asynParamFloat64Array, MCCDAQHAT_VIRT_C3, false, "virtual channel 3",    nullptr,           0.,     0., 0. }
+};
+
+/**
+ * @brief split an enumeration string "a|b|c" into its items
+ * @param[in]  szEnum  enumeration string or nullptr
+ * @param[out] asEnum  items, empty for less than 2 items
+ */
+static void parseEnum(const char* szEnum, std::vector<std::string>& asEnum)
+{
+    asEnum.clear();
+    while (szEnum && *szEnum)
+    {
+      size_t iLen(strlen(szEnum));
+      const char* pSep(strchr(szEnum, '|'));
+      if (pSep) iLen = pSep - szEnum;
+      asEnum.push_back(std::string(szEnum, iLen));
+      if (!pSep) break;
+      szEnum = pSep + 1;
+    }
+    if (asEnum.size() < 2)
+       asEnum.clear();
+}
+
+/**
+ * @brief search a stream processing parameter
+ * @param[in]  iHatParam  parameter id (enum \ref ParameterId)
+ * @param[out] piChannel  (optional) channel number of this parameter id
+ * @return definition or nullptr
+ */
+static const struct streamParamMccDaqHats* findStreamParam(int iHatParam, int* piChannel)
+{
+    for (size_t i = 0; i < sizeof(g_aStreamParams) / sizeof(g_aStreamParams[0]); ++i)
+    {
+        if (iHatParam >= g_aStreamParams[i].iHatParam && iHatParam < g_aStreamParams[i].iHatParam + 8)
+        {
+            if (piChannel)
+                *piChannel = iHatParam - g_aStreamParams[i].iHatParam;
+            return &g_aStreamParams[i];
+        }
+    }
+    for (size_t i = 0; i < sizeof(g_aBoardStreamParams) / sizeof(g_aBoardStreamParams[0]); ++i)
+    {
+        if (iHatParam == g_aBoardStreamParams[i].iHatParam)
+        {
+            if (piChannel)
+                *piChannel = -1;
+            return &g_aBoardStreamParams[i];
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @brief check, if a stream processing parameter exists for polled modules (MCC134) too
+ * @param[in] iHatParam  parameter id of 1st channel (enum \ref ParameterId)
+ * @return true, if this parameter is created for polled modules
+ */
+static bool isPolledStreamParam(int iHatParam)
+{
+    return iHatParam == MCCDAQHAT_LAST0 || iHatParam == MCCDAQHAT_LAST_DB0 || iHatParam == MCCDAQHAT_LAST_DBMODE0;
+}
+
+/**
+ * @brief check a new value of a writeable stream processing parameter
+ * @param[in] pasynUser  pasynUser structure for messages
+ * @param[in] pParam     parameter
+ * @param[in] dValue     new value
+ * @return asyn result code
+ */
+static asynStatus checkStreamParam(asynUser* pasynUser, const struct paramMccDaqHats* pParam, double dValue)
+{
+    const struct streamParamMccDaqHats* pDef(findStreamParam(pParam->iHatParam, nullptr));
+    if (!pDef || !pDef->bWriteable)
+    {
+        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::checkStreamParam - read only parameter\n");
+        return asynError;
+    }
+    if (!isfinite(dValue) || dValue < pDef->dMin || dValue > pDef->dMax)
+    {
+        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::checkStreamParam - %s: value %g out of range %g...%g\n",
+                  pDef->szSuffix, dValue, pDef->dMin, pDef->dMax);
+        return asynError;
+    }
+    if (pDef->iHatParam == MCCDAQHAT_FFT_SIZE0 && (static_cast<int>(dValue) & (static_cast<int>(dValue) - 1)))
+    {
+        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::checkStreamParam - %s: value %g is not a power of two\n",
+                  pDef->szSuffix, dValue);
+        return asynError;
+    }
+    return asynSuccess;
+}
+
+/**
+ * @brief Call a function of the HAT library while holding the shared SPI bus.
+ *        Lock order: controller list, asyn port lock, bus - the bus is always the
+ *        innermost lock, no other lock may be taken while holding it.
+ * @param[in] func  library function
+ * @param[in] args  arguments of the library function
+ * @return result of the library function
+ */
+template<typename F, typename... A> static inline int busCall(F func, A... args)
+{
+    mccdaqhatsBusGuard guard(mccdaqhatsBus::PRIO_CONFIG);
+    return func(args...);
+}
+
+/**
+ * @brief Calibrate the bandwidth model of a HAT type with the median time of some
+ *        single transactions, every transaction holds the shared SPI bus.
+ * @param[in] wHatID       HAT type
+ * @param[in] transaction  callable, which does a single transaction and returns a result of the HAT library
+ */
+template<typename F> static void busCalibrate(epicsUInt16 wHatID, F transaction)
+{
+    double adTime[9];
+    size_t uCount(0);
+    for (; uCount < ARRAY_SIZE(adTime); ++uCount)
+    {
+        mccdaqhatsBusGuard guard(mccdaqhatsBus::PRIO_CONFIG);
+        epicsUInt64 qwStart(epicsMonotonicGet());
+        if (transaction() != RESULT_SUCCESS)
+            break;
+        adTime[uCount] = 1e-9 * static_cast<double>(epicsMonotonicGet() - qwStart);
+    }
+    mccdaqhatsBus::calibrate(wHatID, adTime, uCount);
+}
+
+/**
+ * @brief The ScanState enumeration defines the acquisition state machine of a module.
+ */
+enum ScanState
+{
+    SCAN_IDLE,    // no acquisition
+    SCAN_ARMED,   // started, waiting for trigger
+    SCAN_RUNNING, // started and triggered
+    SCAN_OVERRUN, // stopped by hardware or buffer overrun
+    SCAN_STOPPED  // stopped by itself
+};
+
+/**
+ * @brief The commandMccDaqHats struct is a start/stop command for the board thread;
+ *        the configuration is captured while the port is locked, so the board thread
+ *        does not need to lock the port for reading it
+ */
+struct commandMccDaqHats
+{
+    bool        bStart;  ///< true=start acquisition, false=stop acquisition
+    bool        bRestart;///< true=apply new configuration to a running acquisition
+    epicsUInt8  byMask;  ///< channel selection bit mask
+    epicsInt32  iTrig;   ///< trigger mode
+    epicsInt32  iRange;  ///< MCC128 analog range
+    epicsInt32  iMode;   ///< MCC128 single-ended/differential mode
+    epicsInt32  iClkSrc; ///< MCC172 clock source
+    double      dRate;   ///< requested clock rate
+};
+
+/**
+ * @brief The configMccDaqHats struct is an immutable configuration snapshot of a module;
+ *        it is created with locked port by "PublishConfig" and used by the acquisition
+ *        thread without any lock, a new snapshot is picked up at the next block
+ */
+struct configMccDaqHats
+{
+    int                      iGeneration;     ///< increasing number of this snapshot
+    epicsUInt8               byMask;          ///< channel selection bit mask
+    epicsUInt8               byChannels;      ///< number of enabled channels = samples per interleaved scan
+    epicsUInt8               abyOffset[8];    ///< offset of channel inside an interleaved scan, 0xFF=disabled
+    double                   dRate;           ///< sample rate per channel in Hz, 0=unknown
+    struct paramMccDaqHats*  apChannel[8];    ///< waveform output parameter of channel or nullptr
+    struct stageConfigMccDaqHats
+    {
+        int                      iDecFactor;  ///< decimation factor, 1=disabled
+        int                      iDecType;    ///< decimation filter (enum mccdaqhatsDecimator::FilterType)
+        struct paramMccDaqHats*  pDecArray;   ///< decimated waveform output or nullptr
+        struct paramMccDaqHats*  pDecValue;   ///< last decimated value output or nullptr
+        int                      iStatMode;   ///< statistics window (enum mccdaqhatsStatistics::StatMode)
+        int                      iStatWindow; ///< statistics: sliding window length
+        int                      iStatReset;  ///< statistics: reset counter, changes clear the accumulators
+        struct paramMccDaqHats*  apStat[5];   ///< statistics outputs mean, RMS, minimum, maximum, std deviation
+        int                      iFftMode;    ///< spectrum output (enum mccdaqhatsSpectrum::OutputType)
+        int                      iFftSize;    ///< spectrum: FFT size
+        int                      iFftWindow;  ///< spectrum: window function (enum mccdaqhatsSpectrum::WindowType)
+        int                      iFftOverlap; ///< spectrum: segment overlap in percent
+        int                      iFftAvg;     ///< spectrum: number of averaged segments
+        struct paramMccDaqHats*  pFftSpec;    ///< spectrum output or nullptr
+        struct paramMccDaqHats*  pFftFreq;    ///< frequency axis output or nullptr
+        struct paramMccDaqHats*  pScope;      ///< scope capture output or nullptr
+        int                      iHistLen;    ///< history length in samples, 0=disabled
+        double                   dHistRate;   ///< history: maximum update rate in Hz, 0=on read only
+        struct paramMccDaqHats*  pHist;       ///< history output or nullptr
+        double                   dLodTime;    ///< envelope: retention time in seconds, 0=disabled
+        double                   dLodAgo;     ///< envelope: end of requested range in seconds before now
+        double                   dLodSpan;    ///< envelope: length of requested range in seconds
+        int                      iLodWidth;   ///< envelope: number of pixels
+        double                   dLodRate;    ///< envelope: update rate in Hz, 0=on request changes only
+        struct paramMccDaqHats*  pLodEnv;     ///< envelope min/max output or nullptr
+        struct paramMccDaqHats*  pLodMean;    ///< envelope mean output or nullptr
+        struct paramMccDaqHats*  pLodDt;      ///< envelope time per pixel output or nullptr
+        int                      iRoiStart;   ///< region of interest: first sample of block
+        int                      iRoiLen;     ///< region of interest: number of samples, 0=disabled
+        struct paramMccDaqHats*  pRoi;        ///< region of interest output or nullptr
+        struct paramMccDaqHats*  pLast;       ///< latest value output or nullptr
+        int                      iLastSrc;    ///< latest value: 0=last sample, 1=block mean
+        double                   dLastDb;     ///< latest value: deadband
+        int                      iLastDbMode; ///< latest value: enum mccdaqhatsDeadband::DeadbandMode
+        int                      iEuMode;     ///< unit conversion (enum mccdaqhatsConversion::ConversionMode)
+        std::vector<double>      adEuCoef;    ///< unit conversion: coefficients or table
+        int                      iIirType;    ///< IIR filter type (enum mccdaqhatsBiquad::BiquadType)
+        double                   dIirFreq;    ///< IIR filter: cutoff or center frequency in Hz
+        double                   dIirQ;       ///< IIR filter: quality factor
+        int                      iIirStages;  ///< IIR filter: number of cascaded biquads
+        int                      iIirOut;     ///< IIR filter: 0=separate waveform, 1=inline (input of other stages)
+        struct paramMccDaqHats*  pIir;        ///< filtered waveform output or nullptr
+        int                      iEvtMode;    ///< events: detected crossings (enum mccdaqhatsEvents::EventMode)
+        double                   dEvtLevel;   ///< events: threshold
+        double                   dEvtHyst;    ///< events: hysteresis
+        struct paramMccDaqHats*  pEvtCount;   ///< number of events output or nullptr
+        struct paramMccDaqHats*  pEvtTime;    ///< time of last event output or nullptr
+        struct paramMccDaqHats*  pEvtList;    ///< event list output or nullptr
+        double                   dFreqGate;   ///< frequency counter: gate time in seconds, 0=disabled
+        double                   dFreqLevel;  ///< frequency counter: threshold
+        double                   dFreqHyst;   ///< frequency counter: hysteresis
+        struct paramMccDaqHats*  apFreq[3];   ///< frequency counter outputs frequency, period, jitter
+    } aStage[8];                              ///< processing stages of every channel
+    struct scopeConfigMccDaqHats
+    {
+        int                      iMode;       ///< trigger mode (enum mccdaqhatsScope::ScopeMode)
+        int                      iSource;     ///< trigger channel
+        double                   dLevel;      ///< trigger level
+        int                      iSlope;      ///< trigger slope (enum mccdaqhatsScope::ScopeSlope)
+        double                   dHyst;       ///< trigger hysteresis
+        int                      iPre;        ///< samples before trigger
+        int                      iPost;       ///< samples from trigger on
+        int                      iArm;        ///< arm counter, changes re-arm the trigger
+        struct paramMccDaqHats*  pState;      ///< state output or nullptr
+        struct paramMccDaqHats*  pCount;      ///< capture counter output or nullptr
+    } scope;                                  ///< software oscilloscope of module
+    double                   dPubRate;        ///< maximum publish rate in Hz, 0=every block
+    size_t                   uPubMax;         ///< maximum length of concatenated waveforms
+    int                      iBlockMode;      ///< multi-channel block: 0=off, 1=interleaved, 2=channel-major
+    struct paramMccDaqHats*  pBlock;          ///< multi-channel block output or nullptr
+    struct paramMccDaqHats*  pBlockShape;     ///< multi-channel block shape output or nullptr
+    struct paramMccDaqHats*  pBlockPtr;       ///< block for in-process consumers or nullptr
+    struct paramMccDaqHats*  pBlockSeq;       ///< counter of published blocks or nullptr
+    bool                     bLazy;           ///< process outputs with interrupt users only
+    struct virtualConfigMccDaqHats
+    {
+        std::string              sExpression; ///< expression over the channels of this module, empty=disabled
+        struct paramMccDaqHats*  pOutput;     ///< waveform output or nullptr
+    } aVirtual[MCCDAQHAT_VIRTUAL_CHANNELS];   ///< virtual channels of module
+};
+
+/**
+ * @brief The OutputUsers enumeration defines bits for the outputs of a channel,
+ *        which have interrupt users; outputs without users are not processed
+ */
+enum OutputUsers
+{
+    USERS_C    = 0x01, ///< full rate waveform
+    USERS_ROI  = 0x02, ///< region of interest
+    USERS_DEC  = 0x04, ///< decimated waveform or value
+    USERS_STAT = 0x08, ///< statistics
+    USERS_FFT  = 0x10, ///< spectrum
+    USERS_LOD  = 0x20, ///< envelope
+    USERS_LAST = 0x40, ///< latest value
+    USERS_IIR  = 0x80, ///< filtered waveform
+    USERS_FREQ = 0x100,///< frequency counter
+    USERS_ALL  = 0x1FF
+};
+
+/**
+ * @brief The channelMccDaqHats struct holds the processing state of a channel,
+ *        it is used by the acquisition thread only
+ */
+struct channelMccDaqHats
+{
+    std::vector<double> adData;      ///< channel values of current block
+    std::vector<double> adDec;       ///< decimated values of current block
+    mccdaqhatsDecimator decimator;   ///< decimation filter
+    mccdaqhatsStatistics statistics; ///< streaming statistics
+    int                 iStatReset;  ///< last seen statistics reset counter
+    bool                bStatValid;  ///< "stat" contains a new result of current block
+    mccdaqhatsStatistics::Result stat; ///< statistics result of current block
+    mccdaqhatsSpectrum  spectrum;    ///< spectrum analyzer
+    std::vector<double> adSpec;      ///< last spectrum
+    std::vector<double> adFreq;      ///< frequency axis of spectrum
+    bool                bSpecValid;  ///< "adSpec" contains a new spectrum
+    bool                bFreqValid;  ///< "adFreq" contains a new frequency axis
+    double              dFreqRate;   ///< sample rate of "adFreq"
+    mccdaqhatsHistory   history;     ///< rolling history (locked port)
+    epicsUInt64         qwHistLast;  ///< time of last history update (monotonic ns)
+    mccdaqhatsPyramid   pyramid;     ///< min/max/mean level-of-detail pyramid
+    std::vector<double> adLodEnv;    ///< last envelope min/max pairs
+    std::vector<double> adLodMean;   ///< last envelope mean values
+    double              dLodDt;      ///< last envelope time per pixel
+    bool                bLodValid;   ///< a new envelope is available
+    epicsUInt64         qwLodLast;   ///< time of last envelope (monotonic ns)
+    double              adLodRequest[3]; ///< last request: ago, span, width
+    std::vector<double> adRoi;       ///< region of interest of current block
+    std::vector<double> adPendData;  ///< throttled publishing: concatenated channel values
+    std::vector<double> adPendDec;   ///< throttled publishing: concatenated decimated values
+    std::vector<double> adPendRoi;   ///< throttled publishing: concatenated regions of interest
+    double              dDecLast;    ///< last decimated value
+    bool                bDecLast;    ///< "dDecLast" was updated since last publication
+    mccdaqhatsDeadband  deadband;    ///< deadband of latest value (locked port)
+    mccdaqhatsConversion conversion; ///< engineering unit conversion
+    mccdaqhatsBiquad    iir;         ///< IIR filter
+    std::vector<double> adIir;       ///< filtered values of current block
+    std::vector<double> adPendIir;   ///< throttled publishing: concatenated filtered values
+    mccdaqhatsEvents    events;      ///< level-crossing event detector
+    std::vector<double> adEvt;       ///< events of current block: time and direction pairs
+    std::vector<double> adPendEvt;   ///< throttled publishing: concatenated events
+    double              dEvtTime;    ///< time of last event (POSIX seconds)
+    bool                bEvtTime;    ///< "dEvtTime" was updated since last publication
+    mccdaqhatsFrequency freqCounter; ///< frequency counter
+    mccdaqhatsFrequency::Result counter; ///< frequency counter result of current block
+    bool                bCounterValid; ///< "counter" contains a new result of current block
+    double              dLast;       ///< latest value of current block
+    bool                bLast;       ///< "dLast" is valid
+    int                 iUsers;      ///< outputs with interrupt users (enum \ref OutputUsers, updated every block)
+    int                 iActive;     ///< outputs processed in the last block (enum \ref OutputUsers)
+};
+
+/**
+ * @brief The virtualMccDaqHats struct holds the state of a virtual channel,
+ *        it is used by the acquisition thread only
+ */
+struct virtualMccDaqHats
+{
+    mccdaqhatsExpression expression; ///< compiled expression of current configuration
+    std::vector<double> adData;      ///< values of current block
+    std::vector<double> adPend;      ///< throttled publishing: concatenated values
+    bool                bUsers;      ///< the output has interrupt users (updated every block)
+};
+
+/**
+ * @brief The boardMccDaqHats struct holds the runtime state of a module.
+ */
+struct boardMccDaqHats
+{
+    int             iScanState;  ///< acquisition state (enum \ref ScanState), atomic access, updated by acquisition path
+    int             iBusy;       ///< number of queued or executing start/stop commands, atomic access
+    epicsUInt8      byAddress;   ///< HAT address
+    epicsUInt16     wHatID;      ///< HAT id -> hardware type
+    mccdaqhatsCtrl* pCtrl;       ///< owning controller
+    epicsMutexId    hQueueLock;  ///< protects "aQueue" and "bExit"
+    epicsEventId    hQueueEvent; ///< signals new commands or exit to the board thread
+    epicsThreadId   hThread;     ///< board thread, which executes start/stop commands
+    bool            bExit;       ///< request to terminate the board thread
+    std::deque<struct commandMccDaqHats> aQueue; ///< pending start/stop commands
+    struct commandMccDaqHats running; ///< configuration of the running acquisition with actual rate (board thread)
+    EpicsAtomicPtrT pConfig;     ///< current configuration snapshot (struct configMccDaqHats*), atomic access
+    int             iConfigSeen; ///< generation of snapshot used by acquisition thread, atomic access
+    int             iGapMarker;  ///< 1=next block follows a reconfiguration gap, atomic access
+    int             iReconfig;   ///< 1=board thread changes hardware and configuration, atomic access
+    std::vector<struct configMccDaqHats*> apRetired; ///< replaced snapshots, which could be still in use (locked port)
+    struct channelMccDaqHats aChannel[8]; ///< processing state of every channel
+    int             aiStatReset[8]; ///< statistics reset counter of every channel (locked port)
+    int             iScopeArm;   ///< scope arm counter (locked port)
+    int             iScopeArmSeen; ///< last seen scope arm counter (acquisition thread)
+    bool            bScopeValid; ///< scope contains a new capture of current block
+    mccdaqhatsScope scope;       ///< software oscilloscope (acquisition thread)
+    epicsUInt64     qwPubLast;   ///< time of last publication (monotonic ns)
+    epicsUInt64     qwPollNext;  ///< polled modules: time of next read (monotonic ns)
+    epicsUInt32     dwReadErrors; ///< number of consecutive failed scan reads (acquisition thread)
+    std::vector<double> adBlock; ///< interleaved scans of all channels since last publication
+    epicsUInt8      byBlockMask; ///< channel selection bit mask of "adBlock"
+    epicsUInt64     qwSamples;   ///< number of acquired scans since IOC start (acquisition thread)
+    epicsInt32      iBlockSeq;   ///< number of published blocks (locked port)
+    bool            bBlockUsers; ///< the multi-channel block has interrupt users (updated every block)
+    struct virtualMccDaqHats aVirtual[MCCDAQHAT_VIRTUAL_CHANNELS]; ///< virtual channels (acquisition thread)
+};
+
+/**
+ * @brief The scanBlockMccDaqHats struct describes the scans of a single read,
+ *        it is used by the acquisition thread only
+ */
+struct scanBlockMccDaqHats
+{
+    double*         pdData;     ///< interleaved scans of all enabled channels (buffer of acquisition thread)
+    uint32_t        dwCount;    ///< number of scans
+    uint16_t        wStatus;    ///< scan status of library
+    size_t          uGap;       ///< 1=block follows a reconfiguration gap: outputs start with a NaN marker
+    epicsTimeStamp  tStamp;     ///< time of read
+    double          dStart;     ///< time of first scan (POSIX seconds)
+    int             iVirtualInputs; ///< bit mask of channels, which are inputs of active virtual channels
+    epicsUInt8      byConverted; ///< bit mask of channels in engineering units
+    epicsUInt8      byFiltered;  ///< bit mask of channels replaced by the inline IIR filter
+};
+
+/**
+ * @brief engineering unit conversion (and inline filter) inside the acquired block, so every output
+ *        uses the same units
+ * @param[in,out] pBoard   runtime state of this module
+ * @param[in]     pConfig  configuration snapshot of this block
+ * @param[in,out] block    current block, its scans are converted in place
+ */
+static void processConversion(struct boardMccDaqHats* pBoard, const struct configMccDaqHats* pConfig,
+                              struct scanBlockMccDaqHats& block)
+{
+    block.byConverted = 0;
+    block.byFiltered  = 0;
+    for (int iChannel = 0; iChannel < 8; ++iChannel)
+    {
+        struct channelMccDaqHats& ch(pBoard->aChannel[iChannel]);
+        const struct configMccDaqHats::stageConfigMccDaqHats& st(pConfig->aStage[iChannel]);
+        ch.conversion.configure(st.iEuMode, st.adEuCoef);
+        if (ch.conversion.mode() && pConfig->abyOffset[iChannel] < pConfig->byChannels)
+        {
+            ch.conversion.process(&block.pdData[pConfig->abyOffset[iChannel]], pConfig->byChannels, block.dwCount);
+            block.byConverted |= static_cast<epicsUInt8>(1u << iChannel);
+        }
+        // an inline IIR filter replaces the channel values for all outputs, it runs with every block
+        ch.iir.configure(st.iIirType, st.dIirFreq, st.dIirQ, st.iIirStages, pConfig->dRate); // resets on changes
+        if (block.uGap)
+            ch.iir.reset(); // no filtering across a reconfiguration gap
+        if (ch.iir.type() && st.iIirOut && pConfig->abyOffset[iChannel] < pConfig->byChannels)
+        {
+            double* pdChannel(&block.pdData[pConfig->abyOffset[iChannel]]);
+            ch.iir.process(pdChannel, pConfig->byChannels, pdChannel, pConfig->byChannels, block.dwCount);
+            block.byFiltered |= static_cast<epicsUInt8>(1u << iChannel);
+        }
+    }
+}
+
+/**
+ * @brief decimation stage of a channel
+ * @param[in,out] ch     processing state of channel
+ * @param[in]     st     stage configuration of channel
+ * @param[in]     block  current block
+ * @param[in]     pdIn   full rate values of channel (without gap marker) or nullptr
+ * @param[in]     bDec   the decimated outputs are processed
+ */
+static void processDecimator(struct channelMccDaqHats& ch, const struct configMccDaqHats::stageConfigMccDaqHats& st,
+                             const struct scanBlockMccDaqHats& block, const double* pdIn, bool bDec)
+{
+    ch.decimator.configure(st.iDecFactor, st.iDecType, ch.conversion.range()); // resets on changes
+    if (block.uGap || !(ch.iActive & USERS_DEC))
+        ch.decimator.reset(); // no filtering across a reconfiguration gap
+    if (bDec)
+        ch.decimator.process(pdIn, block.dwCount, ch.adDec);
+}
+
+/**
+ * @brief separate IIR filter waveform of a channel; the inline filter runs in \ref processConversion
+ * @param[in,out] ch     processing state of channel
+ * @param[in]     st     stage configuration of channel
+ * @param[in]     block  current block
+ * @param[in]     pdIn   full rate values of channel (without gap marker) or nullptr
+ * @param[in]     bIir   the filtered waveform is processed
+ */
+static void processIir(struct channelMccDaqHats& ch, const struct configMccDaqHats::stageConfigMccDaqHats& st,
+                       const struct scanBlockMccDaqHats& block, const double* pdIn, bool bIir)
+{
+    if (!st.iIirOut && !(ch.iActive & USERS_IIR))
+        ch.iir.reset(); // separate waveform restarts with next subscriber
+    if (bIir)
+    {
+        ch.adIir.resize(block.dwCount + block.uGap);
+        if (block.uGap)
+            ch.adIir[0] = static_cast<double>(epicsNAN);
+        ch.iir.process(pdIn, 1, &ch.adIir[block.uGap], 1, block.dwCount);
+    }
+}
+
+/**
+ * @brief level-crossing event detector of a channel
+ * @param[in,out] ch     processing state of channel
+ * @param[in]     st     stage configuration of channel
+ * @param[in]     dRate  sample rate in Hz
+ * @param[in]     block  current block
+ * @param[in]     pdIn   full rate values of channel (without gap marker) or nullptr
+ */
+static void processEvents(struct channelMccDaqHats& ch, const struct configMccDaqHats::stageConfigMccDaqHats& st, double dRate,
+                          const struct scanBlockMccDaqHats& block, const double* pdIn)
+{
+    // the event detector counts all events, so it runs without users too
+    ch.events.configure(st.iEvtMode, st.dEvtLevel, st.dEvtHyst); // resets on changes
+    if (block.uGap)
+        ch.events.restart(); // no crossing across a reconfiguration gap
+    if (ch.events.mode() && ch.events.process(pdIn, block.dwCount, ch.adEvt))
+    {
+        for (size_t j = 0; j < ch.adEvt.size(); j += 2)
+            ch.adEvt[j] = block.dStart + ((dRate > 0.) ? (ch.adEvt[j] / dRate) : 0.);
+        ch.dEvtTime = ch.adEvt[ch.adEvt.size() - 2];
+        ch.bEvtTime = true;
+    }
+}
+
+/**
+ * @brief zero-crossing frequency counter of a channel
+ * @param[in,out] ch        processing state of channel
+ * @param[in]     st        stage configuration of channel
+ * @param[in]     dRate     sample rate in Hz
+ * @param[in]     block     current block
+ * @param[in]     pdIn      full rate values of channel (without gap marker) or nullptr
+ * @param[in]     bCounter  the frequency counter outputs are processed
+ */
+static void processFrequency(struct channelMccDaqHats& ch, const struct configMccDaqHats::stageConfigMccDaqHats& st, double dRate,
+                             const struct scanBlockMccDaqHats& block, const double* pdIn, bool bCounter)
+{
+    if (ch.freqCounter.configure(st.dFreqGate, st.dFreqLevel, st.dFreqHyst, dRate) ||
+        block.uGap || !(ch.iActive & USERS_FREQ))
+        ch.freqCounter.reset(); // no period across a reconfiguration gap
+    if (bCounter)
+        ch.bCounterValid = ch.freqCounter.process(pdIn, block.dwCount, ch.counter);
+}
+
+/**
+ * @brief statistics stage of a channel
+ * @param[in,out] ch     processing state of channel
+ * @param[in]     st     stage configuration of channel
+ * @param[in]     block  current block
+ * @param[in]     pdIn   full rate values of channel (without gap marker) or nullptr
+ * @param[in]     bStat  the statistics are processed
+ */
+static void processStatistics(struct channelMccDaqHats& ch, const struct configMccDaqHats::stageConfigMccDaqHats& st,
+                              const struct scanBlockMccDaqHats& block, const double* pdIn, bool bStat)
+{
+    if (ch.statistics.configure(st.iStatMode, st.iStatWindow) || ch.iStatReset != st.iStatReset ||
+        (bStat && !(ch.iActive & USERS_STAT)))
+        ch.statistics.reset();
+    ch.iStatReset = st.iStatReset;
+    if (bStat)
+        ch.bStatValid = ch.statistics.process(pdIn, block.dwCount, ch.stat);
+}
+
+/**
+ * @brief spectrum stage of a channel
+ * @param[in,out] ch     processing state of channel
+ * @param[in]     st     stage configuration of channel
+ * @param[in]     dRate  sample rate in Hz
+ * @param[in]     block  current block
+ * @param[in]     pdIn   full rate values of channel (without gap marker) or nullptr
+ * @param[in]     bFft   the spectrum is processed
+ */
+static void processSpectrum(struct channelMccDaqHats& ch, const struct configMccDaqHats::stageConfigMccDaqHats& st, double dRate,
+                            const struct scanBlockMccDaqHats& block, const double* pdIn, bool bFft)
+{
+    if (ch.spectrum.configure(st.iFftMode, st.iFftSize, st.iFftWindow, st.iFftOverlap, st.iFftAvg) ||
+        ch.dFreqRate != dRate)
+    {
+        ch.dFreqRate = dRate;
+        ch.spectrum.frequencies(ch.dFreqRate, ch.adFreq);
+        ch.bFreqValid = true;
+    }
+    if (block.uGap || !(ch.iActive & USERS_FFT))
+        ch.spectrum.reset(); // no segment across a reconfiguration gap
+    if (bFft)
+        ch.bSpecValid = ch.spectrum.process(pdIn, block.dwCount, dRate, ch.adSpec);
+}
+
+/**
+ * @brief level-of-detail pyramid and envelope stage of a channel
+ * @param[in,out] ch      processing state of channel
+ * @param[in]     st      stage configuration of channel
+ * @param[in]     dRate   sample rate in Hz
+ * @param[in]     block   current block
+ * @param[in]     pdIn    full rate values of channel (without gap marker) or nullptr
+ * @param[in]     bUsers  the envelope outputs have users
+ */
+static void processEnvelope(struct channelMccDaqHats& ch, const struct configMccDaqHats::stageConfigMccDaqHats& st, double dRate,
+                            const struct scanBlockMccDaqHats& block, const double* pdIn, bool bUsers)
+{
+    ch.pyramid.configure(dRate, st.dLodTime); // resets on changes
+    ch.pyramid.process(pdIn, block.dwCount);
+    if (ch.pyramid.levels() && bUsers)
+    {
+        // render on request changes or with the update rate
+        const double adRequest[3] = { st.dLodAgo, st.dLodSpan, static_cast<double>(st.iLodWidth) };
+        epicsUInt64 qwTime(epicsMonotonicGet());
+        if (memcmp(adRequest, ch.adLodRequest, sizeof(adRequest)) ||
+            (st.dLodRate > 0. && static_cast<double>(qwTime - ch.qwLodLast) * 1e-9 * st.dLodRate >= 1.))
+        {
+            memcpy(ch.adLodRequest, adRequest, sizeof(adRequest));
+            ch.qwLodLast = qwTime;
+            ch.bLodValid = ch.pyramid.envelope(st.dLodAgo, st.dLodSpan, static_cast<size_t>(st.iLodWidth),
+                                               ch.adLodEnv, ch.adLodMean, &ch.dLodDt);
+        }
+    }
+    else
+        ch.adLodRequest[2] = 0.; // render again with next subscriber
+}
+
+/**
+ * @brief collect the full rate values of all channels of the current block
+ * @param[in]  pBoard   runtime state of this module
+ * @param[in]  pConfig  configuration snapshot of this block
+ * @param[in]  block    current block
+ * @param[out] apdIn    values of every channel (without gap marker) or nullptr
+ */
+static void channelInputs(const struct boardMccDaqHats* pBoard, const struct configMccDaqHats* pConfig,
+                          const struct scanBlockMccDaqHats& block, const double* apdIn[8])
+{
+    for (int iChannel = 0; iChannel < 8; ++iChannel)
+        apdIn[iChannel] = (pConfig->abyOffset[iChannel] < pConfig->byChannels && !pBoard->aChannel[iChannel].adData.empty()) ?
+                          &pBoard->aChannel[iChannel].adData[block.uGap] : nullptr;
+}
+
+/**
+ * @brief software oscilloscope over all channels of the current block
+ * @param[in,out] pBoard   runtime state of this module
+ * @param[in]     pConfig  configuration snapshot of this block
+ * @param[in]     block    current block
+ */
+static void processScope(struct boardMccDaqHats* pBoard, const struct configMccDaqHats* pConfig,
+                         const struct scanBlockMccDaqHats& block)
+{
+    const struct configMccDaqHats::scopeConfigMccDaqHats& sc(pConfig->scope);
+    const double* apdIn[8];
+    if (pBoard->scope.configure(sc.iMode, sc.iSource, sc.dLevel, sc.iSlope, sc.dHyst, sc.iPre, sc.iPost) || block.uGap)
+        pBoard->scope.reset(); // no capture across a reconfiguration gap
+    if (pBoard->iScopeArmSeen != sc.iArm)
+        pBoard->scope.arm();
+    pBoard->iScopeArmSeen = sc.iArm;
+    channelInputs(pBoard, pConfig, block, apdIn);
+    pBoard->bScopeValid = pBoard->scope.process(apdIn, block.dwCount);
+}
+
+/**
+ * @brief compile changed expressions of the virtual channels
+ * @param[in,out] pBoard   runtime state of this module
+ * @param[in]     pConfig  configuration snapshot of this block
+ * @return bit mask of channels, which are inputs of active virtual channels and need their full rate data
+ */
+static int prepareVirtual(struct boardMccDaqHats* pBoard, const struct configMccDaqHats* pConfig)
+{
+    int iVirtualInputs(0);
+    for (int iVirtual = 0; iVirtual < MCCDAQHAT_VIRTUAL_CHANNELS; ++iVirtual)
+    {
+        struct virtualMccDaqHats& v(pBoard->aVirtual[iVirtual]);
+        const struct configMccDaqHats::virtualConfigMccDaqHats& vc(pConfig->aVirtual[iVirtual]);
+        if (v.expression.text() != vc.sExpression && !v.expression.compile(vc.sExpression))
+            v.expression.clear(); // checked by writeOctet, should not happen
+        if (!v.expression.empty() && vc.pOutput && (!pConfig->bLazy || v.bUsers))
+            iVirtualInputs |= v.expression.channels();
+    }
+    return iVirtualInputs;
+}
+
+/**
+ * @brief virtual channels: the compiled expressions work on whole blocks, disabled inputs are NaN
+ * @param[in,out] pBoard   runtime state of this module
+ * @param[in]     pConfig  configuration snapshot of this block
+ * @param[in]     block    current block
+ */
+static void processVirtual(struct boardMccDaqHats* pBoard, const struct configMccDaqHats* pConfig,
+                           const struct scanBlockMccDaqHats& block)
+{
+    const double* apdIn[8];
+    channelInputs(pBoard, pConfig, block, apdIn);
+    for (int iVirtual = 0; iVirtual < MCCDAQHAT_VIRTUAL_CHANNELS; ++iVirtual)
+    {
+        struct virtualMccDaqHats& v(pBoard->aVirtual[iVirtual]);
+        v.adData.clear();
+        if (v.expression.empty() || !pConfig->aVirtual[iVirtual].pOutput || (pConfig->bLazy && !v.bUsers))
+            continue;
+        v.adData.resize(block.dwCount + block.uGap);
+        if (block.uGap)
+            v.adData[0] = static_cast<double>(epicsNAN);
+        v.expression.evaluate(apdIn, block.dwCount, &v.adData[block.uGap]);
+    }
+}
+
+/**
+ * @brief multi-channel block: collect interleaved scans, the layout is changed on publication
+ * @param[in,out] pBoard   runtime state of this module
+ * @param[in]     pConfig  configuration snapshot of this block
+ * @param[in]     block    current block
+ */
+static void collectScan(struct boardMccDaqHats* pBoard, const struct configMccDaqHats* pConfig,
+                        const struct scanBlockMccDaqHats& block)
+{
+    std::vector<double>& adBlock(pBoard->adBlock);
+    size_t uMax(pConfig->uPubMax * pConfig->byChannels);
+    if (!pConfig->iBlockMode || !pConfig->pBlock || (pConfig->bLazy && !pBoard->bBlockUsers))
+    {
+        adBlock.clear();
+        return;
+    }
+    if (pBoard->byBlockMask != pConfig->byMask)
+        adBlock.clear(); // other channels
+    pBoard->byBlockMask = pConfig->byMask;
+    if (block.uGap)
+        adBlock.insert(adBlock.end(), pConfig->byChannels, static_cast<double>(epicsNAN));
+    adBlock.insert(adBlock.end(), block.pdData, block.pdData + block.dwCount * pConfig->byChannels);
+    if (adBlock.size() > uMax) // whole scans only
+        adBlock.erase(adBlock.begin(), adBlock.end() - static_cast<std::ptrdiff_t>(uMax));
+}
+
 /* ========================================================================
  * mccdaqhats controller
  * ======================================================================== */
 std::map<std::string, mccdaqhatsCtrl*> mccdaqhatsCtrl::m_mapControllers;
+epicsMutexId mccdaqhatsCtrl::m_hControllerLock(nullptr);
 
 /**
  * @brief constructor of controller;
- *        this class is a singleton and created by "initialize", if one of the supported devices was detected
+ *        this class is created by "initialize" for every asyn port, if one of the supported devices was detected
  * @param[in] szAsynPortName  name of this controller
  * @param[in] dTimeout        communication timeout
  */
@@ -125,42 +1033,61 @@ mccdaqhatsCtrl::mccdaqhatsCtrl(const char* szAsynPortName, double dTimeout)
     : asynPortDriver(szAsynPortName,
                      1, // maximum address
 #if ASYN_VERSION < 4 || (ASYN_VERSION == 4 && ASYN_REVISION < 32)
-                     32 * MAX_NUMBER_HATS, // maximum parameters: 32 per HAT
+                     1024 * MAX_NUMBER_HATS, // maximum parameters: 1024 per HAT
 #endif
-                     asynInt32Mask | asynFloat64Mask | asynFloat64ArrayMask | asynDrvUserMask, // additional interfaces
-                     asynInt32Mask | asynFloat64Mask | asynFloat64ArrayMask, // additional callback interfaces
+                     asynInt32Mask | asynFloat64Mask | asynFloat64ArrayMask | asynGenericPointerMask | asynOctetMask | asynDrvUserMask, // additional interfaces
+                     asynInt32Mask | asynFloat64Mask | asynFloat64ArrayMask | asynGenericPointerMask | asynOctetMask, // additional callback interfaces
                      ASYN_CANBLOCK, // asynFlags
                      1, // autoConnect
                      0, // default priority
                      0) // default stackSize
     , m_dTimeout(dTimeout)
     , m_hThread(static_cast<epicsThreadId>(0))
+    , m_iBusLoadReason(-1)
+    , m_iBusLimitReason(-1)
+    , m_iBusPolicyReason(-1)
+    , m_aiBusWaitReason(mccdaqhatsBus::PRIO_COUNT, -1)
+    , m_bBusRecords(false)
+    , m_qwUsersNext(0)
 {
+    m_abyChannelMask.resize(MAX_NUMBER_HATS, 0); // fixed size: read by acquisition threads
+    m_abyRequestedMask.resize(MAX_NUMBER_HATS, 0);
+    m_awHatID.resize(MAX_NUMBER_HATS, 0);
+    m_apBoards.resize(MAX_NUMBER_HATS, nullptr);
+    epicsMutexMustLock(m_hControllerLock);
     m_mapControllers[szAsynPortName] = this;
+    epicsMutexUnlock(m_hControllerLock);
 }
 
 /// destructor
 mccdaqhatsCtrl::~mccdaqhatsCtrl()
 {
     auto hThread(m_hThread);
-    epicsUInt16 awTypes[MAX_NUMBER_HATS];
     m_hThread = static_cast<epicsThreadId>(0);
     if (hThread != m_hThread)
         epicsThreadMustJoin(hThread);
-    memset(awTypes, 0, sizeof(awTypes));
-    for (auto it = m_mapParameters.begin(); it != m_mapParameters.end(); ++it)
+    for (size_t i = 0; i < m_apBoards.size(); ++i)
     {
-        paramMccDaqHats* p(it->second);
-        if (p)
-        {
-            if (p->byAddress < MAX_NUMBER_HATS)
-                awTypes[p->byAddress] = p->wHatID;
-            delete p;
-        }
+        struct boardMccDaqHats* pBoard(m_apBoards[i]);
+        if (!pBoard || !pBoard->hThread)
+            continue;
+        epicsMutexMustLock(pBoard->hQueueLock);
+        pBoard->bExit = true;
+        epicsMutexUnlock(pBoard->hQueueLock);
+        epicsEventMustTrigger(pBoard->hQueueEvent);
+        epicsThreadMustJoin(pBoard->hThread);
+        pBoard->hThread = static_cast<epicsThreadId>(0);
     }
-    for (uint8_t i = 0; i < MAX_NUMBER_HATS; ++i)
+    epicsMutexMustLock(m_hControllerLock);
+    auto it(m_mapControllers.find(portName));
+    if (it != m_mapControllers.end())
+        m_mapControllers.erase(it);
+    epicsMutexUnlock(m_hControllerLock);
+    for (auto it = m_mapParameters.begin(); it != m_mapParameters.end(); ++it)
+        delete it->second;
+    for (uint8_t i = 0; i < m_awHatID.size() && i < MAX_NUMBER_HATS; ++i)
     {
-        switch (awTypes[i])
+        switch (m_awHatID[i])
         {
             case HAT_ID_MCC_118: mcc118_close(i); break;
             case HAT_ID_MCC_128: mcc128_close(i); break;
@@ -168,10 +1095,19 @@ mccdaqhatsCtrl::~mccdaqhatsCtrl()
             case HAT_ID_MCC_152: mcc152_close(i); break;
             case HAT_ID_MCC_172: mcc172_close(i); break;
         }
+        if (m_apBoards[i])
+        {
+            if (m_apBoards[i]->hQueueEvent)
+                epicsEventDestroy(m_apBoards[i]->hQueueEvent);
+            if (m_apBoards[i]->hQueueLock)
+                epicsMutexDestroy(m_apBoards[i]->hQueueLock);
+            delete reinterpret_cast<struct configMccDaqHats*>(m_apBoards[i]->pConfig);
+            for (size_t j = 0; j < m_apBoards[i]->apRetired.size(); ++j)
+                delete m_apBoards[i]->apRetired[j];
+            delete m_apBoards[i];
+            m_apBoards[i] = nullptr;
+        }
     }
-    auto it(m_mapControllers.find(portName));
-    if (it != m_mapControllers.end())
-        m_mapControllers.erase(it);
 }
 
 /**
@@ -183,133 +1119,557 @@ void mccdaqhatsCtrl::backgroundthread()
     epicsThreadSleep(0.1);
     while (m_hThread != static_cast<epicsThreadId>(0))
     {
-        epicsUInt16 awTypes[MAX_NUMBER_HATS];
         double adData[80000];
-        memset(awTypes, 0, sizeof(awTypes));
-        for (auto it = m_mapParameters.begin(); it != m_mapParameters.end(); ++it)
+        epicsUInt64 qwNow(epicsMonotonicGet());
+        if (m_iBusLoadReason >= 0)
         {
-            paramMccDaqHats* p(it->second);
-            if (p)
+            // the bus parameters are global, another port may have changed them
+            double dOld(0.), dLoad(100. * mccdaqhatsBus::getLoad()), dLimit(100. * mccdaqhatsBus::getLimit());
+            epicsInt32 iOld(0), iRefuse(mccdaqhatsBus::getRefuse() ? 1 : 0);
+            bool bChange(false);
+            lock();
+            if (getDoubleParam(m_iBusLoadReason, &dOld) != asynSuccess || fabs(dOld - dLoad) >= 0.05)
+            {
+                setDoubleParam(m_iBusLoadReason, dLoad);
+                bChange = true;
+            }
+            if (m_iBusLimitReason >= 0 && (getDoubleParam(m_iBusLimitReason, &dOld) != asynSuccess || dOld != dLimit))
+            {
+                setDoubleParam(m_iBusLimitReason, dLimit);
+                bChange = true;
+            }
+            if (m_iBusPolicyReason >= 0 && (getIntegerParam(m_iBusPolicyReason, &iOld) != asynSuccess || iOld != iRefuse))
+            {
+                setIntegerParam(m_iBusPolicyReason, iRefuse);
+                bChange = true;
+            }
+            for (int i = 0; i < mccdaqhatsBus::PRIO_COUNT; ++i)
             {
-                if (p->byAddress < MAX_NUMBER_HATS)
-                    awTypes[p->byAddress] = p->wHatID;
+                struct mccdaqhatsBus::statistics stat;
+                if (m_aiBusWaitReason[i] < 0 || !mccdaqhatsBus::getStatistics(static_cast<mccdaqhatsBus::Priority>(i), &stat))
+                    continue;
+                if (getDoubleParam(m_aiBusWaitReason[i], &dOld) != asynSuccess || dOld != 1e3 * stat.dWaitMax)
+                {
+                    setDoubleParam(m_aiBusWaitReason[i], 1e3 * stat.dWaitMax);
+                    bChange = true;
+                }
             }
+            if (bChange)
+                callParamCallbacks();
+            unlock();
         }
-        for (uint8_t i = 0; i < m_abyChannelMask.size() && i < MAX_NUMBER_HATS; ++i)
+        if (qwNow >= m_qwUsersNext)
+        {
+            // subscribers change rarely, walking all interrupt lists with every block would be too expensive
+            lock();
+            UpdateInterruptUsers();
+            unlock();
+            m_qwUsersNext = qwNow + 100000000ull; // 0.1 s
+        }
+        for (uint8_t i = 0; i < m_apBoards.size() && i < MAX_NUMBER_HATS; ++i)
         {
             uint16_t wStatus(0);
-            uint8_t byMask(m_abyChannelMask[i]), byChannelCount(0);
             uint32_t dwDataCount(0);
-            if (!byMask) continue;
-            for (uint8_t j = 0; j < 8; ++j)
-                if ((byMask >> j) & 1)
-                    ++byChannelCount;
-            switch (awTypes[i])
+            int iRead(RESULT_SUCCESS);
+            struct scanBlockMccDaqHats block;
+            int iState(GetScanState(i)), iNewState;
+            const struct configMccDaqHats* pConfig(AcquireConfig(m_apBoards[i]));
+            if (pConfig && m_awHatID[i] == HAT_ID_MCC_134)
+            {
+                PollBoard(m_apBoards[i], pConfig);
+                continue;
+            }
+            if (!pConfig || (iState != SCAN_ARMED && iState != SCAN_RUNNING)) continue;
+            mccdaqhatsBus::acquire(mccdaqhatsBus::PRIO_STREAM);
+            // the board thread could have changed state and configuration meanwhile: it changes the
+            // hardware only with the bus and sets "iReconfig" before, so without this flag both match
+            // the hardware while the bus is reserved, this block uses a single configuration snapshot without any lock
+            iState  = GetScanState(i);
+            pConfig = AcquireConfig(m_apBoards[i]);
+            if (epicsAtomicGetIntT(&m_apBoards[i]->iReconfig) || !pConfig->byMask || (iState != SCAN_ARMED && iState != SCAN_RUNNING))
+            {
+                mccdaqhatsBus::release(mccdaqhatsBus::PRIO_STREAM);
+                continue;
+            }
+            switch (m_awHatID[i])
             {
                 case HAT_ID_MCC_118: // 8-ch 12 bit single-ended analog input
-                {
-                    if (mcc118_a_in_scan_read(i, &wStatus, -1, -1., &adData[0], ARRAY_SIZE(adData), &dwDataCount) != RESULT_SUCCESS
-                        || !(wStatus & STATUS_RUNNING))
-                        dwDataCount = 0;
+                    iRead = mcc118_a_in_scan_read(i, &wStatus, -1, -1., &adData[0], ARRAY_SIZE(adData), &dwDataCount);
                     break;
-                }
                 case HAT_ID_MCC_128: // 4-ch differential / 8-ch single-ended 16 bit analog input
-                    if (mcc128_a_in_scan_read(i, &wStatus, -1, -1., &adData[0], ARRAY_SIZE(adData), &dwDataCount) != RESULT_SUCCESS
-                        || !(wStatus & STATUS_RUNNING))
-                        dwDataCount = 0;
+                    iRead = mcc128_a_in_scan_read(i, &wStatus, -1, -1., &adData[0], ARRAY_SIZE(adData), &dwDataCount);
                     break;
                 case HAT_ID_MCC_172: // 2-ch 24 bit differential analog input
-                    if (mcc172_a_in_scan_read(i, &wStatus, -1, -1., &adData[0], ARRAY_SIZE(adData), &dwDataCount) != RESULT_SUCCESS
-                        || !(wStatus & STATUS_RUNNING))
-                        dwDataCount = 0;
+                    iRead = mcc172_a_in_scan_read(i, &wStatus, -1, -1., &adData[0], ARRAY_SIZE(adData), &dwDataCount);
                     break;
             }
-            if (!dwDataCount) continue;
-            for (auto it = m_mapParameters.begin(); it != m_mapParameters.end(); ++it)
+            mccdaqhatsBus::release(mccdaqhatsBus::PRIO_STREAM);
+            if (iRead != RESULT_SUCCESS)
             {
-                paramMccDaqHats* p(it->second);
-                if (!p || p->byAddress != i) continue;
-                switch (p->iHatParam)
-                {
-                    case MCCDAQHAT_C0:
-                    case MCCDAQHAT_C1:
-                    case MCCDAQHAT_C2:
-                    case MCCDAQHAT_C3:
-                    case MCCDAQHAT_C4:
-                    case MCCDAQHAT_C5:
-                    case MCCDAQHAT_C6:
-                    case MCCDAQHAT_C7:
-                    {
-                        int iChannel(static_cast<int>(p->iHatParam - MCCDAQHAT_C0));
-                        size_t uOffset(0);
-                        asynParamType iType(asynParamNotDefined);
-                        for (int j = 0; j < 8 && j < iChannel; ++j)
-                            if ((byMask >> j) & 1)
-                                ++uOffset;
-                        getParamType(p->iHatParam, &iType);
-                        if (iType == asynParamFloat64Array)
-                        {
-                            std::vector<double> adChannel;
-                            adChannel.resize(dwDataCount, static_cast<double>(0.));
-                            if ((byMask >> iChannel) & 1)
-                            {
-                                for (size_t j = 0; j < dwDataCount; ++j)
-                                    adChannel[j] = adData[static_cast<size_t>(byChannelCount) * j + uOffset];
-                            }
-                            std::swap(p->adCache, adChannel);
-                            doCallbacksFloat64Array(&p->adCache[0], p->adCache.size(), p->iHatParam, 0);
-                        }
-                        break;
-                    }
-                    default:
-                        break;
-                } // switch (p->iHatParam)
-            } // for (auto it = m_mapParameters.begin(); it != m_mapParameters.end(); ++it)
-        } // for (uint8_t i = 0; i < m_abyChannelMask.size() && i < MAX_NUMBER_HATS; ++i)
+                // the status is unknown: keep scan state and bus load, report the first error of a series only
+                if (!m_apBoards[i]->dwReadErrors++)
+                    asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, "mccdaqhats::backgroundthread - cannot read scan data of address %u (%d)\n",
+                              static_cast<unsigned>(i), iRead);
+                continue;
+            }
+            if (m_apBoards[i]->dwReadErrors)
+            {
+                asynPrint(pasynUserSelf, ASYN_TRACE_WARNING, "mccdaqhats::backgroundthread - scan data of address %u readable again after %u errors\n",
+                          static_cast<unsigned>(i), static_cast<unsigned>(m_apBoards[i]->dwReadErrors));
+                m_apBoards[i]->dwReadErrors = 0;
+            }
+            if (!(wStatus & STATUS_RUNNING))
+                dwDataCount = 0;
+            // update state machine, only if nobody else changed it meanwhile
+            if (wStatus & (STATUS_HW_OVERRUN | STATUS_BUFFER_OVERRUN))
+                iNewState = SCAN_OVERRUN;
+            else if (!(wStatus & STATUS_RUNNING))
+                iNewState = SCAN_STOPPED;
+            else if (wStatus & STATUS_TRIGGERED)
+                iNewState = SCAN_RUNNING;
+            else
+                iNewState = iState;
+            if (iNewState != iState && SetScanState(i, iNewState, iState)
+                && iNewState != SCAN_RUNNING)
+                mccdaqhatsBus::setBoardLoad(i, m_awHatID[i], 0.); // scan stopped itself
+            if (!dwDataCount) continue;
+            block.pdData  = &adData[0];
+            block.dwCount = dwDataCount;
+            block.wStatus = wStatus;
+            epicsTimeGetCurrent(&block.tStamp);
+            // time of first sample of this block (POSIX seconds) for event times
+            block.dStart  = static_cast<double>(block.tStamp.secPastEpoch) + static_cast<double>(POSIX_TIME_AT_EPICS_EPOCH) +
+                            static_cast<double>(block.tStamp.nsec) * 1e-9;
+            if (pConfig->dRate > 0.)
+                block.dStart -= static_cast<double>(dwDataCount - 1) / pConfig->dRate;
+            // first block after a reconfiguration starts with a NaN sample as gap marker
+            block.uGap    = (epicsAtomicCmpAndSwapIntT(&m_apBoards[i]->iGapMarker, 1, 0) == 1) ? 1 : 0;
+            processConversion(m_apBoards[i], pConfig, block);
+            block.iVirtualInputs = prepareVirtual(m_apBoards[i], pConfig);
+            // process all channels without lock, disabled stages cost nothing
+            for (int iChannel = 0; iChannel < 8; ++iChannel)
+                ProcessChannel(m_apBoards[i], pConfig, iChannel, block);
+            processScope(m_apBoards[i], pConfig, block);
+            processVirtual(m_apBoards[i], pConfig, block);
+            collectScan(m_apBoards[i], pConfig, block);
+            PublishScan(m_apBoards[i], pConfig, block);
+        } // for (uint8_t i = 0; i < m_apBoards.size() && i < MAX_NUMBER_HATS; ++i)
         epicsThreadSleep(0.001);
     } // while (m_hThread != static_cast<epicsThreadId>(0))
 }
 
 /**
- * @brief mccdaqhatsCtrl::interrupt is called in background from hardware
+ * @brief run all stages of a channel on the current block; it is called by the acquisition thread without lock
+ * @param[in] pBoard    runtime state of this module
+ * @param[in] pConfig   configuration snapshot of this block
+ * @param[in] iChannel  channel number (0…7)
+ * @param[in] block     current block
  */
-void mccdaqhatsCtrl::interrupt()
+void mccdaqhatsCtrl::ProcessChannel(struct boardMccDaqHats* pBoard, const struct configMccDaqHats* pConfig, int iChannel,
+                                    const struct scanBlockMccDaqHats& block)
 {
-    for (auto it1 = m_mapControllers.begin(); it1 != m_mapControllers.end(); ++it1)
+    struct channelMccDaqHats& ch(pBoard->aChannel[iChannel]);
+    const struct configMccDaqHats::stageConfigMccDaqHats& st(pConfig->aStage[iChannel]);
+    size_t uOffset(pConfig->abyOffset[iChannel]);
+    // outputs without interrupt users are skipped, stages with history (sliding and cumulative
+    // statistics, history, pyramid, scope) keep running; the full rate channel data is needed
+    // for subscribers and enabled stages only
+    int iUsers(pConfig->bLazy ? ch.iUsers : USERS_ALL);
+    bool bDec(st.iDecFactor > 1 && (iUsers & USERS_DEC));
+    bool bStat(st.iStatMode && (st.iStatMode != mccdaqhatsStatistics::STAT_BLOCK || (iUsers & USERS_STAT)));
+    bool bFft(st.iFftMode && (iUsers & USERS_FFT));
+    bool bIir(ch.iir.type() && !st.iIirOut && st.pIir && (iUsers & USERS_IIR));
+    bool bCounter(st.dFreqGate > 0. && (iUsers & USERS_FREQ));
+    bool bFull((iUsers & USERS_C) || bDec || bStat || bFft || bIir || bCounter || st.iEvtMode || st.iHistLen > 0 ||
+               st.dLodTime > 0. || pConfig->scope.iMode || (st.pLast && st.iLastSrc && (iUsers & USERS_LAST)) ||
+               (block.iVirtualInputs & (1 << iChannel)));
+    const double* pdIn(nullptr);
+    ch.adDec.clear();
+    ch.adRoi.clear();
+    ch.adIir.clear();
+    ch.adEvt.clear();
+    ch.bStatValid    = false;
+    ch.bCounterValid = false;
+    ch.bSpecValid    = false;
+    ch.bLodValid     = false;
+    ch.bLast         = false;
+    if (uOffset >= pConfig->byChannels)
     {
-        mccdaqhatsCtrl* pCtrl((*it1).second);
-        bool bChange(false);
-        if (!pCtrl)
-            continue;
-        pCtrl->lock();
-        for (auto it2 = pCtrl->m_mapParameters.begin(); it2 != pCtrl->m_mapParameters.end(); ++it2)
-        {
-            struct paramMccDaqHats* pParam((*it2).second);
-            uint8_t byValue(0);
-            if (pParam->wHatID != HAT_ID_MCC_152 || pParam->iHatParam != MCCDAQHAT_DI)
-                continue;
-            mcc152_dio_input_read_port(pParam->byAddress, &byValue);
-            pCtrl->setIntegerParam(pParam->iAsynReason, byValue);
-            mcc152_dio_int_status_read_port(pParam->byAddress, &byValue);
-            bChange = true;
+        if (pConfig->apChannel[iChannel] && (iUsers & USERS_C))
+            ch.adData.assign(block.dwCount + block.uGap, static_cast<double>(0.));
+        else
+            ch.adData.clear();
+        return;
+    }
+    if (st.pRoi && st.iRoiLen > 0 && static_cast<uint32_t>(st.iRoiStart) < block.dwCount && (iUsers & USERS_ROI))
+    {
+        // copy the region of interest directly out of the interleaved block
+        size_t uStart(static_cast<size_t>(st.iRoiStart)), uLen(static_cast<size_t>(st.iRoiLen));
+        if (uLen > block.dwCount - uStart)
+            uLen = block.dwCount - uStart;
+        ch.adRoi.resize(uLen);
+        mccdaqhatsDsp::deinterleave(&block.pdData[uStart * pConfig->byChannels], pConfig->byChannels, uOffset, uLen, &ch.adRoi[0]);
+    }
+    if (bFull)
+    {
+        ch.adData.resize(block.dwCount + block.uGap);
+        if (block.uGap)
+            ch.adData[0] = static_cast<double>(epicsNAN);
+        mccdaqhatsDsp::deinterleave(block.pdData, pConfig->byChannels, uOffset, block.dwCount, &ch.adData[block.uGap]);
+        pdIn = &ch.adData[block.uGap];
+    }
+    else
+        ch.adData.clear();
+    if (st.pLast && (iUsers & USERS_LAST))
+    {
+        // latest sample directly out of the interleaved block or mean of block
+        if (st.iLastSrc && pdIn)
+            ch.dLast = mccdaqhatsDsp::sum(pdIn, block.dwCount) / static_cast<double>(block.dwCount);
+        else
+            ch.dLast = block.pdData[static_cast<size_t>(block.dwCount - 1) * pConfig->byChannels + uOffset];
+        ch.bLast = true;
+    }
+    // disabled stages are configured (and freed), but do not touch the data;
+    // skipped stages restart, when a subscriber appears
+    processDecimator(ch, st, block, pdIn, bDec);
+    processIir(ch, st, block, pdIn, bIir);
+    processEvents(ch, st, pConfig->dRate, block, pdIn);
+    processFrequency(ch, st, pConfig->dRate, block, pdIn, bCounter);
+    processStatistics(ch, st, block, pdIn, bStat);
+    processSpectrum(ch, st, pConfig->dRate, block, pdIn, bFft);
+    processEnvelope(ch, st, pConfig->dRate, block, pdIn, (iUsers & USERS_LOD) != 0);
+    ch.iActive = (iUsers & ~(USERS_DEC | USERS_STAT | USERS_FFT | USERS_IIR | USERS_FREQ)) |
+                 (bDec ? USERS_DEC : 0) | (bStat ? USERS_STAT : 0) | (bFft ? USERS_FFT : 0) |
+                 (bIir ? USERS_IIR : 0) | (bCounter ? USERS_FREQ : 0);
+}
+
+/**
+ * @brief publish all outputs of the current block, throttled outputs are aggregated in between;
+ *        it is called by the acquisition thread
+ * @param[in] pBoard   runtime state of this module
+ * @param[in] pConfig  configuration snapshot of this block
+ * @param[in] block    current block
+ */
+void mccdaqhatsCtrl::PublishScan(struct boardMccDaqHats* pBoard, const struct configMccDaqHats* pConfig,
+                                 const struct scanBlockMccDaqHats& block)
+{
+    epicsUInt64 qwNow(0);
+    bool bPublish(true);
+    lock();
+    qwNow = epicsMonotonicGet();
+    bPublish = !(pConfig->dPubRate > 0.) ||
+               static_cast<double>(qwNow - pBoard->qwPubLast) * 1e-9 * pConfig->dPubRate >= 1.;
+    if (bPublish)
+        pBoard->qwPubLast = qwNow;
+    for (int iChannel = 0; iChannel < 8; ++iChannel)
+        PublishChannel(pBoard, pConfig, iChannel, qwNow, bPublish);
+    for (int iVirtual = 0; iVirtual < MCCDAQHAT_VIRTUAL_CHANNELS; ++iVirtual)
+    {
+        struct virtualMccDaqHats& v(pBoard->aVirtual[iVirtual]);
+        paramMccDaqHats* p(pConfig->aVirtual[iVirtual].pOutput);
+        if (p && !v.adData.empty())
+            PublishArray(p, v.adData, v.adPend, bPublish, pConfig->uPubMax);
+        else
+            v.adPend.clear();
+        v.bUsers = HasInterruptUsers(p);
+    }
+    pBoard->bBlockUsers = HasInterruptUsers(pConfig->pBlock) || HasInterruptUsers(pConfig->pBlockShape);
+    if (bPublish && !pBoard->adBlock.empty())
+        PublishBlock(pBoard, pConfig);
+    if (bPublish && pConfig->pBlockSeq) // the last update of a publication (PVA group trigger)
+        setIntegerParam(pConfig->pBlockSeq->iAsynReason, ++pBoard->iBlockSeq);
+    if (HasInterruptUsers(pConfig->pBlockPtr))
+    {
+        // every block without copy: consumers get the buffer of this thread during the callback
+        struct mccdaqhatsBlock blk;
+        blk.dwVersion   = MCCDAQHATS_BLOCK_VERSION;
+        blk.dwFlags     = (block.uGap ? MCCDAQHATS_BLOCK_GAP : 0) |
+                          ((block.wStatus & STATUS_TRIGGERED) ? MCCDAQHATS_BLOCK_TRIGGERED : 0) |
+                          ((block.wStatus & (STATUS_HW_OVERRUN | STATUS_BUFFER_OVERRUN)) ? MCCDAQHATS_BLOCK_OVERRUN : 0) |
+                          (block.byConverted ? MCCDAQHATS_BLOCK_CONVERTED : 0) |
+                          (block.byFiltered ? MCCDAQHATS_BLOCK_FILTERED : 0);
+        blk.byAddress   = pBoard->byAddress;
+        blk.wHatID      = pBoard->wHatID;
+        blk.byMask      = pConfig->byMask;
+        blk.byChannels  = pConfig->byChannels;
+        blk.byConverted = block.byConverted;
+        blk.byFiltered  = block.byFiltered;
+        blk.qwSample    = pBoard->qwSamples;
+        blk.tStamp      = block.tStamp;
+        blk.dRate       = pConfig->dRate;
+        blk.uScans      = block.dwCount;
+        blk.pdData      = block.pdData;
+        doCallbacksGenericPointer(&blk, pConfig->pBlockPtr->iAsynReason, 0);
+    }
+    pBoard->qwSamples += block.dwCount;
+    if (pConfig->scope.pState)
+        setIntegerParam(pConfig->scope.pState->iAsynReason, pBoard->scope.state());
+    if (pConfig->scope.pCount)
+        setIntegerParam(pConfig->scope.pCount->iAsynReason, static_cast<epicsInt32>(pBoard->scope.count()));
+    callParamCallbacks();
+    unlock();
+}
+
+/**
+ * @brief publish the outputs of a channel; this is called with locked port
+ * @param[in] pBoard    runtime state of this module
+ * @param[in] pConfig   configuration snapshot of this block
+ * @param[in] iChannel  channel number (0…7)
+ * @param[in] qwNow     current time (monotonic ns)
+ * @param[in] bPublish  true: publish now, false: concatenate throttled outputs only
+ */
+void mccdaqhatsCtrl::PublishChannel(struct boardMccDaqHats* pBoard, const struct configMccDaqHats* pConfig, int iChannel,
+                                    epicsUInt64 qwNow, bool bPublish)
+{
+    struct channelMccDaqHats& ch(pBoard->aChannel[iChannel]);
+    const struct configMccDaqHats::stageConfigMccDaqHats& st(pConfig->aStage[iChannel]);
+    paramMccDaqHats* p(pConfig->apChannel[iChannel]);
+    // history is shared with readFloat64Array, so it is used with locked port only
+    ch.history.configure(st.iHistLen > 0 ? static_cast<size_t>(st.iHistLen) : 0);
+    if (ch.history.length() && !ch.adData.empty() && pConfig->abyOffset[iChannel] < pConfig->byChannels)
+    {
+        ch.history.write(&ch.adData[0], ch.adData.size());
+        if (st.pHist && st.dHistRate > 0. && static_cast<double>(qwNow - ch.qwHistLast) * 1e-9 * st.dHistRate >= 1.)
+        {
+            // publish directly out of the ring, it is contiguous
+            size_t uCount(0);
+            const double* pdHist(ch.history.data(&uCount));
+            ch.qwHistLast = qwNow;
+            if (pdHist)
+                doCallbacksFloat64Array(const_cast<epicsFloat64*>(pdHist), uCount, st.pHist->iAsynReason, 0);
         }
-        if (bChange)
-            pCtrl->callParamCallbacks();
-        pCtrl->unlock();
     }
+    if (p && (ch.iActive & USERS_C))
+        PublishArray(p, ch.adData, ch.adPendData, bPublish, pConfig->uPubMax);
+    else
+        ch.adPendData.clear();
+    if (st.pRoi)
+        PublishArray(st.pRoi, ch.adRoi, ch.adPendRoi, bPublish, pConfig->uPubMax);
+    if (st.pIir)
+        PublishArray(st.pIir, ch.adIir, ch.adPendIir, bPublish, pConfig->uPubMax);
+    if (st.pEvtList) // whole pairs only
+        PublishArray(st.pEvtList, ch.adEvt, ch.adPendEvt, bPublish, pConfig->uPubMax & ~static_cast<size_t>(1));
+    if (bPublish && ch.bEvtTime && st.pEvtTime)
+    {
+        setDoubleParam(st.pEvtTime->iAsynReason, ch.dEvtTime);
+        ch.bEvtTime = false;
+    }
+    if (bPublish && ch.events.mode() && st.pEvtCount)
+        setIntegerParam(st.pEvtCount->iAsynReason, static_cast<epicsInt32>(ch.events.count()));
+    if (ch.bCounterValid)
+    {
+        // the gate time defines the update rate
+        const double adCounter[3] = { ch.counter.dFreq, ch.counter.dPeriod, ch.counter.dJitter };
+        for (int j = 0; j < 3; ++j)
+            if (st.apFreq[j])
+                setDoubleParam(st.apFreq[j]->iAsynReason, adCounter[j]);
+    }
+    if (!ch.adDec.empty())
+    {
+        ch.dDecLast = ch.adDec.back();
+        ch.bDecLast = true;
+    }
+    if (st.pDecArray)
+        PublishArray(st.pDecArray, ch.adDec, ch.adPendDec, bPublish, pConfig->uPubMax);
+    ch.deadband.configure(st.dLastDb, st.iLastDbMode); // publishes next value on changes
+    if (bPublish && ch.bLast && ch.deadband.check(ch.dLast))
+        setDoubleParam(st.pLast->iAsynReason, ch.dLast);
+    if (bPublish && ch.bDecLast && st.pDecValue)
+    {
+        setDoubleParam(st.pDecValue->iAsynReason, ch.dDecLast);
+        ch.bDecLast = false;
+    }
+    if (ch.bSpecValid && (p = st.pFftSpec) != nullptr)
+    {
+        std::swap(p->adCache, ch.adSpec);
+        doCallbacksFloat64Array(&p->adCache[0], p->adCache.size(), p->iAsynReason, 0);
+    }
+    if (ch.bFreqValid && (p = st.pFftFreq) != nullptr)
+    {
+        std::swap(p->adCache, ch.adFreq);
+        if (!p->adCache.empty())
+            doCallbacksFloat64Array(&p->adCache[0], p->adCache.size(), p->iAsynReason, 0);
+        ch.bFreqValid = false;
+    }
+    if (ch.bLodValid)
+    {
+        if ((p = st.pLodEnv) != nullptr)
+        {
+            std::swap(p->adCache, ch.adLodEnv);
+            doCallbacksFloat64Array(&p->adCache[0], p->adCache.size(), p->iAsynReason, 0);
+        }
+        if ((p = st.pLodMean) != nullptr)
+        {
+            std::swap(p->adCache, ch.adLodMean);
+            doCallbacksFloat64Array(&p->adCache[0], p->adCache.size(), p->iAsynReason, 0);
+        }
+        if (st.pLodDt)
+            setDoubleParam(st.pLodDt->iAsynReason, ch.dLodDt);
+    }
+    if (ch.bStatValid && bPublish)
+    {
+        // block statistics cover all blocks since the last publication
+        const double adStat[5] = { ch.stat.dMean, ch.stat.dRms, ch.stat.dMin, ch.stat.dMax, ch.stat.dStd };
+        for (int j = 0; j < 5; ++j)
+            if (st.apStat[j])
+                setDoubleParam(st.apStat[j]->iAsynReason, adStat[j]);
+        ch.statistics.next();
+    }
+    if (pBoard->bScopeValid && (p = st.pScope) != nullptr && pConfig->abyOffset[iChannel] < pConfig->byChannels)
+    {
+        // copy into existing cache, the capture buffer is kept by the scope
+        const double* pdCapture(pBoard->scope.capture(iChannel));
+        p->adCache.assign(pdCapture, pdCapture + pBoard->scope.length());
+        doCallbacksFloat64Array(&p->adCache[0], p->adCache.size(), p->iAsynReason, 0);
+    }
+    // outputs with interrupt users for next block
+    ch.iUsers = (HasInterruptUsers(pConfig->apChannel[iChannel]) ? USERS_C : 0) |
+                (HasInterruptUsers(st.pRoi) ? USERS_ROI : 0) |
+                ((HasInterruptUsers(st.pDecArray) || HasInterruptUsers(st.pDecValue)) ? USERS_DEC : 0) |
+                (HasInterruptUsers(st.pFftSpec) ? USERS_FFT : 0) |
+                ((HasInterruptUsers(st.pLodEnv) || HasInterruptUsers(st.pLodMean) ||
+                  HasInterruptUsers(st.pLodDt)) ? USERS_LOD : 0) |
+                (HasInterruptUsers(st.pLast) ? USERS_LAST : 0) |
+                (HasInterruptUsers(st.pIir) ? USERS_IIR : 0);
+    for (int j = 0; j < 5; ++j)
+        if (HasInterruptUsers(st.apStat[j]))
+            ch.iUsers |= USERS_STAT;
+    for (int j = 0; j < 3; ++j)
+        if (HasInterruptUsers(st.apFreq[j]))
+            ch.iUsers |= USERS_FREQ;
+}
+
+/**
+ * @brief mccdaqhatsCtrl::boardthread executes queued start/stop commands of a single module;
+ *        slow library calls are done without holding the port lock, so other parameters
+ *        of this port stay accessible meanwhile
+ * @param[in] pBoard  runtime state of this module
+ */
+void mccdaqhatsCtrl::boardthread(struct boardMccDaqHats* pBoard)
+{
+    for (;;)
+    {
+        struct commandMccDaqHats cmd;
+        bool bCommand(false);
+        int iAsynBusy(-1);
+
+        epicsMutexMustLock(pBoard->hQueueLock);
+        if (pBoard->bExit)
+        {
+            epicsMutexUnlock(pBoard->hQueueLock);
+            break;
+        }
+        if (!pBoard->aQueue.empty())
+        {
+            cmd = pBoard->aQueue.front();
+            pBoard->aQueue.pop_front();
+            bCommand = true;
+        }
+        epicsMutexUnlock(pBoard->hQueueLock);
+        if (!bCommand)
+        {
+            epicsEventMustWait(pBoard->hQueueEvent);
+            continue;
+        }
+
+        // the acquisition thread skips this module, while its hardware and configuration change;
+        // the bus is taken for every library call only (it is the innermost lock)
+        epicsAtomicSetIntT(&pBoard->iReconfig, 1);
+        if (cmd.bRestart)
+            RestartScan(pBoard, cmd);
+        else if (cmd.bStart)
+            StartScan(pBoard, cmd);
+        else
+            StopScan(pBoard);
+        epicsAtomicSetIntT(&pBoard->iReconfig, 0);
+
+        // "START" and "STATE" are published already, now clear "BUSY" after the last command;
+        // "QueueScan" increments the counter with locked port, so read it again with locked port
+        epicsAtomicDecrIntT(&pBoard->iBusy);
+        lock();
+        auto it(m_mapDev2Asyn.find(GetMapHash(pBoard->byAddress, MCCDAQHAT_BUSY)));
+        if (it != m_mapDev2Asyn.end())
+            iAsynBusy = (*it).second;
+        if (iAsynBusy >= 0)
+        {
+            setIntegerParam(iAsynBusy, epicsAtomicGetIntT(&pBoard->iBusy) > 0 ? 1 : 0);
+            callParamCallbacks();
+        }
+        unlock();
+    }
+}
+
+/**
+ * @brief wrapper for real implementation "mccdaqhatsCtrl::boardthread"
+ * @param[in] pParameter  runtime state of a module
+ */
+void mccdaqhatsCtrl::boardthreadfunc(void* pParameter)
+{
+    struct boardMccDaqHats* pBoard(reinterpret_cast<struct boardMccDaqHats*>(pParameter));
+    if (pBoard && pBoard->pCtrl)
+        pBoard->pCtrl->boardthread(pBoard);
+}
+
+/**
+ * @brief mccdaqhatsCtrl::interrupt is called in background from hardware for every controller
+ */
+void mccdaqhatsCtrl::interrupt()
+{
+    bool bChange(false);
+    lock();
+    for (auto it = m_mapParameters.begin(); it != m_mapParameters.end(); ++it)
+    {
+        struct paramMccDaqHats* pParam((*it).second);
+        uint8_t byValue(0);
+        if (pParam->wHatID != HAT_ID_MCC_152 || pParam->iHatParam != MCCDAQHAT_DI)
+            continue;
+        mccdaqhatsBusGuard guard(mccdaqhatsBus::PRIO_INTERRUPT);
+        mcc152_dio_input_read_port(pParam->byAddress, &byValue);
+        setIntegerParam(pParam->iAsynReason, byValue);
+        mcc152_dio_int_status_read_port(pParam->byAddress, &byValue);
+        bChange = true;
+    }
+    if (bChange)
+        callParamCallbacks();
+    unlock();
+}
+
+/**
+ * @brief mccdaqhatsCtrl::interruptfunc is called in background from hardware;
+ *        the MCC library supports a single callback only, so dispatch it to every controller,
+ *        which handles the interrupts of its own modules
+ * @param[in] pParameter  unused
+ */
+void mccdaqhatsCtrl::interruptfunc(void* pParameter)
+{
+    (void)pParameter;
+    if (!m_hControllerLock)
+        return;
+    epicsMutexMustLock(m_hControllerLock);
+    for (auto it = m_mapControllers.begin(); it != m_mapControllers.end(); ++it)
+    {
+        mccdaqhatsCtrl* pCtrl((*it).second);
+        if (pCtrl)
+            pCtrl->interrupt();
+    }
+    epicsMutexUnlock(m_hControllerLock);
 }
 
 /**
  * @brief mccdaqhatsCtrl::initialize is an iocsh wrapper function called for "mccdaqhatsInitialize";
- *        it searches for supported hardware, creates a singleton, parameters for every device
+ *        it searches for supported hardware, creates a controller with parameters for every device;
+ *        multiple controllers could share the modules, every controller gets its own lock and thread
  * @param[in] (pArgs)            arguments to this wrapper
  * @param[in] szAsynPortName     [0]asyn port name of this motor controller
  * @param[in] dTimeout           [1]communication timeout in ms
+ * @param[in] szAddresses        [2](optional) list of module addresses, e.g. "0,1" or "2-4", empty=all free modules
  */
 void mccdaqhatsCtrl::initialize(const iocshArgBuf* pArgs)
 {
     const char* szAsynPort(pArgs[0].sval);
     double dTimeout(pArgs[1].dval);
+    const char* szAddresses(pArgs[2].sval);
+    epicsUInt32 dwAddresses(0);
     std::string sTmp;
     mccdaqhatsCtrl* pC(nullptr);
 
@@ -323,6 +1683,21 @@ void mccdaqhatsCtrl::initialize(const iocshArgBuf* pArgs)
         fprintf(stderr, "invalid time specified (0 < timeout <= 10s)\n");
         return;
     }
+    if (!ParseAddressList(szAddresses, &dwAddresses))
+    {
+        fprintf(stderr, "invalid address list \"%s\" (e.g. \"0,1\" or \"2-4\")\n", szAddresses);
+        return;
+    }
+    if (!m_hControllerLock)
+        m_hControllerLock = epicsMutexMustCreate();
+    epicsMutexMustLock(m_hControllerLock);
+    bool bExists(m_mapControllers.find(szAsynPort) != m_mapControllers.end());
+    epicsMutexUnlock(m_hControllerLock);
+    if (bExists)
+    {
+        fprintf(stderr, "asyn port %s already exists\n", szAsynPort);
+        return;
+    }
 
     std::vector<struct HatInfo> hi;
     hi.resize(hat_list(HAT_ID_ANY, nullptr));
@@ -337,12 +1712,22 @@ void mccdaqhatsCtrl::initialize(const iocshArgBuf* pArgs)
         memset(p, 0, sizeof(*p));
     }
     hat_list(HAT_ID_ANY, &hi[0]);
+    // resolve the owners of all modules before the port lock is taken: "interruptfunc" locks
+    // the controller list first and a port second, so the controller list must not be locked
+    // while the new port is locked
+    std::vector<std::string> asOwner(MAX_NUMBER_HATS);
+    for (uint8_t i = 0; i < MAX_NUMBER_HATS; ++i)
+    {
+        mccdaqhatsCtrl* pOwner(FindOwner(i));
+        if (pOwner)
+            asOwner[i] = pOwner->portName;
+    }
     printf("found %llu hats:\n", static_cast<unsigned long long>(hi.size()));
     for (auto it = hi.begin(); it != hi.end(); ++it)
     {
         struct HatInfo* pInfo(&(*it));
         char szPrefix[32], szSerial[1024];
-        struct MCCAsynParam { const char* szSuffix; asynParamType iAsynType; ParameterId iHatParam; bool bWriteable; const char* szDesc; const char* szEnum; } *pParamList;
+        struct MCCAsynParam { const char* szSuffix; asynParamType iAsynType; ParameterId iHatParam; bool bWriteable; const char* szDesc; const char* szEnum; } *pParamList(nullptr);
         // MCC 118 create parameters (8-ch 12 bit single-ended analog input)
                 //    MCC_A<n>C0…MCC_A<n>C7   (floatarray)
                 //    MCC_A<n>MASK (uint8 0xFF, 1…255 channel selection bit mask)
@@ -351,11 +1736,17 @@ void mccdaqhatsCtrl::initialize(const iocshArgBuf* pArgs)
                 //    MCC_A<n>SLOPE0…7 (float 1)
                 //    MCC_A<n>OFFSET0…7 (float 0)
                 //    MCC_A<n>START (enum 0, STOP=0, START=1)
+                //    MCC_A<n>STATE (enum 0, idle=0, armed=1, running=2, overrun=3, stopped=4)
+                //    MCC_A<n>BUSY  (enum 0, idle=0, busy=1)
+                //    MCC_A<n>GAP   (float 0, acquisition gap of last reconfiguration in ms)
         struct MCCAsynParam aMCC118Params[] =
             { { "C",      asynParamFloat64Array, MCCDAQHAT_C0,      false, "channel value(s)", nullptr },
               { "SLOPE",  asynParamFloat64,      MCCDAQHAT_SLOPE0,  false, "EEPROM correction factor", nullptr },
               { "OFFSET", asynParamFloat64,      MCCDAQHAT_OFFSET0, false, "EEPROM correction offset", nullptr },
               { "START",  asynParamInt32,        MCCDAQHAT_START,   true,  "acquisition state", "stop|start" },
+              { "STATE",  asynParamInt32,        MCCDAQHAT_STATE,   false, "acquisition state machine", "idle|armed|running|overrun|stopped" },
+              { "BUSY",   asynParamInt32,        MCCDAQHAT_BUSY,    false, "start/stop command pending", "idle|busy" },
+              { "GAP",    asynParamFloat64,      MCCDAQHAT_GAP,     false, "gap of last reconfiguration in ms", nullptr },
               { "MASK",   asynParamInt32,        MCCDAQHAT_MASK,    true,  "channel selection bit mask", nullptr },
               { "TRIG",   asynParamInt32,        MCCDAQHAT_TRIG,    true,  "trigger mode", "none|rising|falling|high|low" },
               { "RATE",   asynParamFloat64,      MCCDAQHAT_RATE,    true,  "ADC clock (<=0 ext. clock, freq. hint)", nullptr } };
@@ -369,6 +1760,9 @@ void mccdaqhatsCtrl::initialize(const iocshArgBuf* pArgs)
                 //    MCC_A<n>SLOPE0…3  (float 1)
                 //    MCC_A<n>OFFSET0…3 (float 0)
                 //    MCC_A<n>START     (enum 0, STOP=0, START=1)
+                //    MCC_A<n>STATE     (enum 0, idle=0, armed=1, running=2, overrun=3, stopped=4)
+                //    MCC_A<n>BUSY      (enum 0, idle=0, busy=1)
+                //    MCC_A<n>GAP       (float 0, acquisition gap of last reconfiguration in ms)
         struct MCCAsynParam aMCC128Params[] =
             { { "C",       asynParamFloat64Array, MCCDAQHAT_C0,      false, "channel value(s)", nullptr },
               { "SLOPE0",  asynParamFloat64,      MCCDAQHAT_SLOPE0,  false, "EEPROM correction factor", nullptr },
@@ -380,6 +1774,9 @@ void mccdaqhatsCtrl::initialize(const iocshArgBuf* pArgs)
               { "OFFSET2", asynParamFloat64,      MCCDAQHAT_OFFSET2, false, "EEPROM correction offset", nullptr },
               { "OFFSET3", asynParamFloat64,      MCCDAQHAT_OFFSET3, false, "EEPROM correction offset", nullptr },
               { "START",   asynParamInt32,        MCCDAQHAT_START,   true,  "acquisition state", "stop|start" },
+              { "STATE",   asynParamInt32,        MCCDAQHAT_STATE,   false, "acquisition state machine", "idle|armed|running|overrun|stopped" },
+              { "BUSY",    asynParamInt32,        MCCDAQHAT_BUSY,    false, "start/stop command pending", "idle|busy" },
+              { "GAP",     asynParamFloat64,      MCCDAQHAT_GAP,     false, "gap of last reconfiguration in ms", nullptr },
               { "MASK",    asynParamInt32,        MCCDAQHAT_MASK,    true,  "channel selection bit mask", nullptr },
               { "TRIG",    asynParamInt32,        MCCDAQHAT_TRIG,    true,  "trigger mode", "none|rising|falling|high|low" },
               { "RATE",    asynParamFloat64,      MCCDAQHAT_RATE,    true,  "ADC clock (<=0 ext. clock, freq. hint)", nullptr },
@@ -430,6 +1827,9 @@ void mccdaqhatsCtrl::initialize(const iocshArgBuf* pArgs)
                 //    MCC_A<n>SLOPE0…1 (float 1)
                 //    MCC_A<n>OFFSET0…1 (float 0)
                 //    MCC_A<n>START (enum 0, STOP=0, START=1)
+                //    MCC_A<n>STATE (enum 0, idle=0, armed=1, running=2, overrun=3, stopped=4)
+                //    MCC_A<n>BUSY  (enum 0, idle=0, busy=1)
+                //    MCC_A<n>GAP   (float 0, acquisition gap of last reconfiguration in ms)
                 //    MCC_A<n>IEPE0…1 (enum 0, OFF=0, ON=1)
         struct MCCAsynParam aMCC172Params[] =
             { { "C",      asynParamFloat64Array, MCCDAQHAT_C0,      false, "channel value", nullptr },
@@ -437,6 +1837,9 @@ void mccdaqhatsCtrl::initialize(const iocshArgBuf* pArgs)
               { "OFFSET", asynParamFloat64,      MCCDAQHAT_OFFSET0, false, "EEPROM correction offset", nullptr },
               { "IEPE",   asynParamInt32,        MCCDAQHAT_IEPE0,   true,  "IEPE power", "OFF|ON" },
               { "START",  asynParamInt32,        MCCDAQHAT_START,   true,  "acquisition state", "stop|start" },
+              { "STATE",  asynParamInt32,        MCCDAQHAT_STATE,   false, "acquisition state machine", "idle|armed|running|overrun|stopped" },
+              { "BUSY",   asynParamInt32,        MCCDAQHAT_BUSY,    false, "start/stop command pending", "idle|busy" },
+              { "GAP",    asynParamFloat64,      MCCDAQHAT_GAP,     false, "gap of last reconfiguration in ms", nullptr },
               { "MASK",   asynParamInt32,        MCCDAQHAT_MASK,    true,  "channel selection bit mask", nullptr },
               { "TRIG",   asynParamInt32,        MCCDAQHAT_TRIG,    true,  "trigger mode", "none|rising|falling|high|low" },
               { "CLKSRC", asynParamInt32,        MCCDAQHAT_CLKSRC,  true,  "clock source", "local|master|slave" },
@@ -447,6 +1850,16 @@ void mccdaqhatsCtrl::initialize(const iocshArgBuf* pArgs)
         memset(szSerial, 0, sizeof(szSerial));
         printf("  a[%u]: id=0x%04x v=0x%04x %.*s\n", pInfo->address, pInfo->id,
                pInfo->version, static_cast<int>(sizeof(pInfo->product_name)), pInfo->product_name);
+        if (pInfo->address >= MAX_NUMBER_HATS || !((dwAddresses >> pInfo->address) & 1))
+        {
+            printf("    not selected for %s\n", szAsynPort);
+            continue;
+        }
+        if (!asOwner[pInfo->address].empty())
+        {
+            printf("    already used by %s\n", asOwner[pInfo->address].c_str());
+            continue;
+        }
         snprintf(szPrefix, ARRAY_SIZE(szPrefix), "MCC_A%u", pInfo->address);
         szPrefix[ARRAY_SIZE(szPrefix) - 1] = '\0';
         switch (pInfo->id)
@@ -456,14 +1869,19 @@ void mccdaqhatsCtrl::initialize(const iocshArgBuf* pArgs)
                 goto handleMCC118;
             case HAT_ID_MCC_118: // 8-ch 12 bit single-ended analog input
 handleMCC118:
-                if (mcc118_open(pInfo->address) != RESULT_SUCCESS)
+                if (busCall(mcc118_open, pInfo->address) != RESULT_SUCCESS)
                 {
                     printf("    cannot open MCC 118\n");
-                    mcc118_close(pInfo->address);
+                    busCall(mcc118_close, pInfo->address);
                     break;
                 }
-                mcc118_firmware_version(pInfo->address, &wFW, &wBoot);
-                mcc118_serial(pInfo->address, &szSerial[0]);
+                busCall(mcc118_firmware_version, pInfo->address, &wFW, &wBoot);
+                busCall(mcc118_serial, pInfo->address, &szSerial[0]);
+                {
+                    // calibrate bandwidth model with the median of some single transactions
+                    double dValue;
+                    busCalibrate(HAT_ID_MCC_118, [&]() { return mcc118_a_in_read(pInfo->address, 0, OPTS_DEFAULT, &dValue); });
+                }
                 printf("    MCC 118: 8-ch single-ended analog input (12 bit)\n");
                 printf("    fw=0x%04x boot=0x%04x\n", wFW, wBoot);
                 iChannels  = 8;
@@ -472,14 +1890,19 @@ handleMCC118:
                 iNoSuffixList = 3;
                 break;
             case HAT_ID_MCC_128: // 4-ch differential / 8-ch single-ended 16 bit analog input
-                if (mcc128_open(pInfo->address) != RESULT_SUCCESS)
+                if (busCall(mcc128_open, pInfo->address) != RESULT_SUCCESS)
                 {
                     printf("    cannot open MCC 128\n");
-                    mcc128_close(pInfo->address);
+                    busCall(mcc128_close, pInfo->address);
                     break;
                 }
-                mcc128_firmware_version(pInfo->address, &wFW);
-                mcc128_serial(pInfo->address, &szSerial[0]);
+                busCall(mcc128_firmware_version, pInfo->address, &wFW);
+                busCall(mcc128_serial, pInfo->address, &szSerial[0]);
+                {
+                    // calibrate bandwidth model with the median of some single transactions
+                    double dValue;
+                    busCalibrate(HAT_ID_MCC_128, [&]() { return mcc128_a_in_read(pInfo->address, 0, OPTS_DEFAULT, &dValue); });
+                }
                 printf("    MCC 128: 4-ch differential / 8-ch single-ended analog input (16 bit)\n");
                 printf("    fw=0x%04x\n", wFW);
                 iChannels  = 8;
@@ -488,13 +1911,13 @@ handleMCC118:
                 iNoSuffixList = 1;
                 break;
             case HAT_ID_MCC_134: // 4-ch 24 bit thermocouple input
-                if (mcc134_open(pInfo->address) != RESULT_SUCCESS)
+                if (busCall(mcc134_open, pInfo->address) != RESULT_SUCCESS)
                 {
                     printf("    cannot open MCC 134\n");
-                    mcc134_close(pInfo->address);
+                    busCall(mcc134_close, pInfo->address);
                     break;
                 }
-                mcc134_serial(pInfo->address, &szSerial[0]);
+                busCall(mcc134_serial, pInfo->address, &szSerial[0]);
                 printf("    MCC 134: 4-ch thermocouple input (24 bit)\n");
                 iChannels  = 4;
                 pParamList = &aMCC134Params[0];
@@ -502,13 +1925,13 @@ handleMCC118:
                 iNoSuffixList = 4;
                 break;
             case HAT_ID_MCC_152: // 2-ch 12 bit analog output, 8-ch digital I/O
-                if (mcc152_open(pInfo->address) != RESULT_SUCCESS)
+                if (busCall(mcc152_open, pInfo->address) != RESULT_SUCCESS)
                 {
                     printf("    cannot open MCC 152\n");
-                    mcc152_close(pInfo->address);
+                    busCall(mcc152_close, pInfo->address);
                     break;
                 }
-                mcc152_serial(pInfo->address, &szSerial[0]);
+                busCall(mcc152_serial, pInfo->address, &szSerial[0]);
                 printf("    MCC 152: 2-ch analog output (12 bit), 8-ch digital I/O\n");
                 iChannels  = 0;
                 pParamList = &aMCC152Params[0];
@@ -516,14 +1939,19 @@ handleMCC118:
                 iNoSuffixList = 0;
                 break;
             case HAT_ID_MCC_172: // 2-ch 24 bit differential analog input
-                if (mcc172_open(pInfo->address) != RESULT_SUCCESS)
+                if (busCall(mcc172_open, pInfo->address) != RESULT_SUCCESS)
                 {
                     printf("    cannot open MCC 172\n");
-                    mcc172_close(pInfo->address);
+                    busCall(mcc172_close, pInfo->address);
                     break;
                 }
-                mcc172_firmware_version(pInfo->address, &wFW);
-                mcc172_serial(pInfo->address, &szSerial[0]);
+                busCall(mcc172_firmware_version, pInfo->address, &wFW);
+                busCall(mcc172_serial, pInfo->address, &szSerial[0]);
+                {
+                    // calibrate bandwidth model with the median of some single transactions
+                    uint8_t byValue;
+                    busCalibrate(HAT_ID_MCC_172, [&]() { return mcc172_iepe_config_read(pInfo->address, 0, &byValue); });
+                }
                 printf("    MCC 172: 2-ch differential analog input (24 bit)\n");
                 printf("    fw=0x%04x\n", wFW);
                 iChannels  = 2;
@@ -556,10 +1984,76 @@ handleMCC118:
             }
             pC->lock();
         }
-        hat_interrupt_callback_enable(&mccdaqhatsCtrl::interruptfunc, static_cast<void*>(pC));
-        if (pInfo->address >= pC->m_abyChannelMask.size())
-            pC->m_abyChannelMask.resize(static_cast<size_t>(pInfo->address) + 1, 0);
-        pC->m_abyChannelMask[pInfo->address] = static_cast<uint8_t>((1 << iChannels) - 1);
+        if (!pC || iListCount <= 0)
+            continue;
+        pC->m_awHatID[pInfo->address] = pInfo->id;
+        {
+            struct boardMccDaqHats* pBoard(new boardMccDaqHats());
+            pBoard->iScanState  = SCAN_IDLE;
+            pBoard->iBusy       = 0;
+            pBoard->byAddress   = pInfo->address;
+            pBoard->wHatID      = pInfo->id;
+            pBoard->pCtrl       = pC;
+            pBoard->hQueueLock  = nullptr;
+            pBoard->hQueueEvent = nullptr;
+            pBoard->hThread     = static_cast<epicsThreadId>(0);
+            pBoard->bExit       = false;
+            pBoard->pConfig     = nullptr;
+            pBoard->iConfigSeen = 0;
+            pBoard->iGapMarker  = 0;
+            pBoard->iReconfig   = 0;
+            memset(&pBoard->running, 0, sizeof(pBoard->running));
+            for (int i = 0; i < 8; ++i)
+                pBoard->aiStatReset[i] = pBoard->aChannel[i].iStatReset = 0;
+            pBoard->iScopeArm   = pBoard->iScopeArmSeen = 0;
+            for (int i = 0; i < 8; ++i)
+            {
+                pBoard->aChannel[i].iUsers      = USERS_ALL; // until the first block was published
+                pBoard->aChannel[i].iActive     = USERS_ALL;
+                pBoard->aChannel[i].dDecLast    = 0.;
+                pBoard->aChannel[i].bDecLast    = false;
+                pBoard->aChannel[i].dLast       = 0.;
+                pBoard->aChannel[i].bLast       = false;
+                pBoard->aChannel[i].dEvtTime    = 0.;
+                pBoard->aChannel[i].bEvtTime    = false;
+            }
+            pBoard->qwPubLast   = 0;
+            pBoard->qwPollNext  = 0;
+            pBoard->dwReadErrors = 0;
+            pBoard->byBlockMask = 0;
+            pBoard->qwSamples   = 0;
+            pBoard->iBlockSeq   = 0;
+            pBoard->bBlockUsers = true;
+            pBoard->bScopeValid = false;
+            for (int i = 0; i < MCCDAQHAT_VIRTUAL_CHANNELS; ++i)
+                pBoard->aVirtual[i].bUsers = true; // until the first block was published
+            pC->m_apBoards[pInfo->address] = pBoard;
+            switch (pInfo->id)
+            {
+                case HAT_ID_MCC_118:
+                case HAT_ID_MCC_128:
+                case HAT_ID_MCC_172:
+                {
+                    // start/stop is executed by an own thread for every streaming module
+                    epicsThreadOpts opt(EPICS_THREAD_OPTS_INIT);
+                    char szThread[64];
+                    opt.priority  = epicsThreadPriorityMedium;
+                    opt.stackSize = epicsThreadGetStackSize(epicsThreadStackMedium);
+                    opt.joinable  = 1;
+                    snprintf(szThread, ARRAY_SIZE(szThread), "%s:A%u", szAsynPort, static_cast<unsigned>(pInfo->address));
+                    pBoard->hQueueLock  = epicsMutexMustCreate();
+                    pBoard->hQueueEvent = epicsEventMustCreate(epicsEventEmpty);
+                    pBoard->hThread     = epicsThreadCreateOpt(szThread, &mccdaqhatsCtrl::boardthreadfunc, static_cast<void*>(pBoard), &opt);
+                    if (!pBoard->hThread)
+                        fprintf(stderr, "cannot create board thread for address %u\n", static_cast<unsigned>(pInfo->address));
+                    break;
+                }
+                default:
+                    break;
+            }
+        }
+        pC->m_abyChannelMask[pInfo->address]   = static_cast<uint8_t>((1 << iChannels) - 1);
+        pC->m_abyRequestedMask[pInfo->address] = pC->m_abyChannelMask[pInfo->address];
         for (int i = 0; i < iListCount; ++i)
         {
             std::string szName;
@@ -571,19 +2065,8 @@ handleMCC118:
             p.iHatParam    = pParamList[i].iHatParam;
             p.bWritable    = pParamList[i].bWriteable;
             p.sDescription = pParamList[i].szDesc;
-            p.asEnum.clear();
             p.adCache.clear();
-            while (szEnum && *szEnum)
-            {
-              size_t iLen(strlen(szEnum));
-              const char* pSep(strchr(szEnum, '|'));
-              if (pSep) iLen = pSep - szEnum;
-              p.asEnum.push_back(std::string(szEnum, iLen));
-              if (!pSep) break;
-              szEnum = pSep + 1;
-            }
-            if (p.asEnum.size() < 2)
-               p.asEnum.clear();
+            parseEnum(szEnum, p.asEnum);
             for (int j = 0; j < iChannels; ++j)
             {
                 szName = std::string(szPrefix) + std::string("_") + std::string(pParamList[i].szSuffix);
@@ -604,7 +2087,7 @@ handleMCC118:
                             case MCCDAQHAT_SLOPE0:
                             {
                                 double s(1.), o;
-                                if (mcc118_calibration_coefficient_read(pInfo->address, j, &s, &o) != RESULT_SUCCESS)
+                                if (busCall(mcc118_calibration_coefficient_read, pInfo->address, j, &s, &o) != RESULT_SUCCESS)
                                     s = 1.;
                                 pC->setDoubleParam(p.iAsynReason, s);
                                 break;
@@ -612,7 +2095,7 @@ handleMCC118:
                             case MCCDAQHAT_OFFSET0:
                             {
                                 double s, o(0.);
-                                if (mcc118_calibration_coefficient_read(pInfo->address, j, &s, &o) != RESULT_SUCCESS)
+                                if (busCall(mcc118_calibration_coefficient_read, pInfo->address, j, &s, &o) != RESULT_SUCCESS)
                                     o = 0.;
                                 pC->setDoubleParam(p.iAsynReason, o);
                                 break;
@@ -627,8 +2110,13 @@ handleMCC118:
                                 pC->setDoubleParam(p.iAsynReason, 100000); // max 100kHz
                                 break;
                             case MCCDAQHAT_START: // stopped
+                            case MCCDAQHAT_STATE: // idle
+                            case MCCDAQHAT_BUSY:  // no pending command
                                 pC->setIntegerParam(p.iAsynReason, 0);
                                 break;
+                            case MCCDAQHAT_GAP:   // no reconfiguration yet
+                                pC->setDoubleParam(p.iAsynReason, 0.);
+                                break;
                             default: break;
                         }
                         break;
@@ -641,7 +2129,7 @@ handleMCC118:
                             case MCCDAQHAT_SLOPE3:
                             {
                                 double s(1.), o;
-                                if (mcc128_calibration_coefficient_read(pInfo->address, static_cast<int>(pParamList[i].iHatParam - MCCDAQHAT_SLOPE0), &s, &o) != RESULT_SUCCESS)
+                                if (busCall(mcc128_calibration_coefficient_read, pInfo->address, static_cast<int>(pParamList[i].iHatParam - MCCDAQHAT_SLOPE0), &s, &o) != RESULT_SUCCESS)
                                     s = 1.;
                                 pC->setDoubleParam(p.iAsynReason, s);
                                 break;
@@ -652,7 +2140,7 @@ handleMCC118:
                             case MCCDAQHAT_OFFSET3:
                             {
                                 double s, o(0.);
-                                if (mcc128_calibration_coefficient_read(pInfo->address, static_cast<int>(pParamList[i].iHatParam - MCCDAQHAT_OFFSET0), &s, &o) != RESULT_SUCCESS)
+                                if (busCall(mcc128_calibration_coefficient_read, pInfo->address, static_cast<int>(pParamList[i].iHatParam - MCCDAQHAT_OFFSET0), &s, &o) != RESULT_SUCCESS)
                                     o = 0.;
                                 pC->setDoubleParam(p.iAsynReason, o);
                                 break;
@@ -673,8 +2161,13 @@ handleMCC118:
                                 pC->setIntegerParam(p.iAsynReason, 0); // single-ended
                                 break;
                             case MCCDAQHAT_START: // stopped
+                            case MCCDAQHAT_STATE: // idle
+                            case MCCDAQHAT_BUSY:  // no pending command
                                 pC->setIntegerParam(p.iAsynReason, 0);
                                 break;
+                            case MCCDAQHAT_GAP:   // no reconfiguration yet
+                                pC->setDoubleParam(p.iAsynReason, 0.);
+                                break;
                             default: break;
                         }
                         break;
@@ -684,7 +2177,7 @@ handleMCC118:
                             case MCCDAQHAT_SLOPE0:
                             {
                                 double s(1.), o;
-                                if (mcc134_calibration_coefficient_read(pInfo->address, j, &s, &o) != RESULT_SUCCESS)
+                                if (busCall(mcc134_calibration_coefficient_read, pInfo->address, j, &s, &o) != RESULT_SUCCESS)
                                     s = 1.;
                                 pC->setDoubleParam(p.iAsynReason, s);
                                 break;
@@ -692,20 +2185,20 @@ handleMCC118:
                             case MCCDAQHAT_OFFSET0:
                             {
                                 double s, o(0.);
-                                if (mcc134_calibration_coefficient_read(pInfo->address, j, &s, &o) != RESULT_SUCCESS)
+                                if (busCall(mcc134_calibration_coefficient_read, pInfo->address, j, &s, &o) != RESULT_SUCCESS)
                                     o = 0.;
                                 pC->setDoubleParam(p.iAsynReason, o);
                                 break;
                             }
                             case MCCDAQHAT_TCTYPE0: // disabled
-                                mcc134_tc_type_write(pInfo->address, static_cast<uint8_t>(p.iHatParam - MCCDAQHAT_TCTYPE0), 0);
+                                busCall(mcc134_tc_type_write, pInfo->address, static_cast<uint8_t>(p.iHatParam - MCCDAQHAT_TCTYPE0), 0);
                                 pC->setIntegerParam(p.iAsynReason, 0);
                                 break;
                             case MCCDAQHAT_MASK:
                                 pC->setIntegerParam(p.iAsynReason, pC->m_abyChannelMask[p.byAddress]);
                                 break;
                             case MCCDAQHAT_RATE: // update every second
-                                mcc134_update_interval_write(pInfo->address, 1);
+                                busCall(mcc134_update_interval_write, pInfo->address, 1);
                                 pC->setIntegerParam(p.iAsynReason, 1);
                                 break;
                             default: break;
@@ -722,7 +2215,7 @@ handleMCC118:
                             case MCCDAQHAT_##param:     \
                             {                           \
                                 uint8_t byValue(0);     \
-                                if (mcc152_dio_##func##_read_port(pInfo->address, &byValue) == RESULT_SUCCESS) \
+                                if (busCall(mcc152_dio_##func##_read_port, pInfo->address, &byValue) == RESULT_SUCCESS) \
                                     pC->setIntegerParam(p.iAsynReason, byValue); \
                                 break;                  \
                             }
@@ -730,7 +2223,7 @@ handleMCC118:
                             case MCCDAQHAT_##param:     \
                             {                           \
                                 uint8_t byValue(0);     \
-                                if (mcc152_dio_config_read_port(pInfo->address, DIO_##item, &byValue) == RESULT_SUCCESS) \
+                                if (busCall(mcc152_dio_config_read_port, pInfo->address, DIO_##item, &byValue) == RESULT_SUCCESS) \
                                     pC->setIntegerParam(p.iAsynReason, byValue); \
                                 break;                  \
                             }
@@ -749,9 +2242,9 @@ handleMCC118:
                         if (pParamList[i].iHatParam == MCCDAQHAT_DI)
                         {
                             uint8_t byValue(0);
-                            mcc152_dio_config_write_port(pInfo->address, DIO_INT_MASK, 0); // enable interrupts
-                            mcc152_dio_int_status_read_port(pInfo->address, &byValue);
-                            mcc152_dio_input_read_port(pInfo->address, &byValue); // clear previous interrupts
+                            busCall(mcc152_dio_config_write_port, pInfo->address, DIO_INT_MASK, 0); // enable interrupts
+                            busCall(mcc152_dio_int_status_read_port, pInfo->address, &byValue);
+                            busCall(mcc152_dio_input_read_port, pInfo->address, &byValue); // clear previous interrupts
                         }
                         break;
                     case HAT_ID_MCC_172: // 2-ch 24 bit differential analog input
@@ -760,7 +2253,7 @@ handleMCC118:
                             case MCCDAQHAT_SLOPE0:
                             {
                                 double s(1.), o;
-                                if (mcc172_calibration_coefficient_read(pInfo->address, j, &s, &o) != RESULT_SUCCESS)
+                                if (busCall(mcc172_calibration_coefficient_read, pInfo->address, j, &s, &o) != RESULT_SUCCESS)
                                     s = 1.;
                                 pC->setDoubleParam(p.iAsynReason, s);
                                 break;
@@ -768,7 +2261,7 @@ handleMCC118:
                             case MCCDAQHAT_OFFSET0:
                             {
                                 double s, o(0.);
-                                if (mcc172_calibration_coefficient_read(pInfo->address, j, &s, &o) != RESULT_SUCCESS)
+                                if (busCall(mcc172_calibration_coefficient_read, pInfo->address, j, &s, &o) != RESULT_SUCCESS)
                                     o = 0.;
                                 pC->setDoubleParam(p.iAsynReason, o);
                                 break;
@@ -776,7 +2269,7 @@ handleMCC118:
                             case MCCDAQHAT_IEPE0:
                             {
                                 uint8_t c(0);
-                                if (mcc172_iepe_config_read(pInfo->address, j, &c) != RESULT_SUCCESS)
+                                if (busCall(mcc172_iepe_config_read, pInfo->address, j, &c) != RESULT_SUCCESS)
                                     c = 0;
                                 pC->setIntegerParam(p.iAsynReason, c);
                                 break;
@@ -785,7 +2278,7 @@ handleMCC118:
                             {
                                 uint8_t bySrc(0), bySync(0);
                                 double dRate(static_cast<double>(epicsNAN));
-                                if (mcc172_a_in_clock_config_read(pInfo->address, &bySrc, &dRate, &bySync) != RESULT_SUCCESS)
+                                if (busCall(mcc172_a_in_clock_config_read, pInfo->address, &bySrc, &dRate, &bySync) != RESULT_SUCCESS)
                                     bySrc = 0;
                                 pC->setIntegerParam(p.iAsynReason, bySrc);
                             }
@@ -793,7 +2286,7 @@ handleMCC118:
                             {
                                 uint8_t bySrc(0), bySync(0);
                                 double dRate(static_cast<double>(epicsNAN));
-                                if (mcc172_a_in_clock_config_read(pInfo->address, &bySrc, &dRate, &bySync) != RESULT_SUCCESS)
+                                if (busCall(mcc172_a_in_clock_config_read, pInfo->address, &bySrc, &dRate, &bySync) != RESULT_SUCCESS)
                                     dRate = 0.;
                                 pC->setDoubleParam(p.iAsynReason, dRate);
                             }
@@ -801,8 +2294,13 @@ handleMCC118:
                                 pC->setIntegerParam(p.iAsynReason, pC->m_abyChannelMask[p.byAddress]);
                                 break;
                             case MCCDAQHAT_START: // stopped
+                            case MCCDAQHAT_STATE: // idle
+                            case MCCDAQHAT_BUSY:  // no pending command
                                 pC->setIntegerParam(p.iAsynReason, 0);
                                 break;
+                            case MCCDAQHAT_GAP:   // no reconfiguration yet
+                                pC->setDoubleParam(p.iAsynReason, 0.);
+                                break;
                             default: break;
                         }
                         break;
@@ -811,14 +2309,125 @@ handleMCC118:
                 } // switch (pInfo->id)
             } // for (int j = 0; j < iChannels; ++j)
         } // for (int i = 0; i < iListCount; ++i)
+        switch (pInfo->id)
+        {
+            case HAT_ID_MCC_118:
+            case HAT_ID_MCC_128:
+            case HAT_ID_MCC_134:
+            case HAT_ID_MCC_172:
+                // stream processing parameters of every channel, followed by the ones of the module;
+                // polled modules get the latest value with deadband only
+                for (size_t i = 0; i < ARRAY_SIZE(g_aStreamParams) + ARRAY_SIZE(g_aBoardStreamParams); ++i)
+                {
+                    bool bPerChannel(i < ARRAY_SIZE(g_aStreamParams));
+                    const struct streamParamMccDaqHats& def(bPerChannel ? g_aStreamParams[i] : g_aBoardStreamParams[i - ARRAY_SIZE(g_aStreamParams)]);
+                    struct paramMccDaqHats p;
+                    if (pInfo->id == HAT_ID_MCC_134 && (!bPerChannel || !isPolledStreamParam(def.iHatParam)))
+                        continue;
+                    p.iAsynReason  = -1;
+                    p.byAddress    = pInfo->address;
+                    p.wHatID       = pInfo->id;
+                    p.bWritable    = def.bWriteable;
+                    p.sDescription = def.szDesc;
+                    parseEnum(def.szEnum, p.asEnum);
+                    for (int j = 0; j < (bPerChannel ? iChannels : 1); ++j)
+                    {
+                        std::string szName(std::string(szPrefix) + std::string("_") + std::string(def.szSuffix));
+                        if (bPerChannel)
+                            szName += std::to_string(j);
+                        p.iHatParam = static_cast<ParameterId>(static_cast<int>(def.iHatParam) + j);
+                        pC->createParam(szName.c_str(), def.iAsynType, &p.iAsynReason);
+                        pC->m_mapParameters[p.iAsynReason] = new paramMccDaqHats(p);
+                        pC->m_mapDev2Asyn[GetMapHash(pInfo->address, p.iHatParam)] = p.iAsynReason;
+                        if (def.iHatParam == MCCDAQHAT_EU_COEF0)
+                        {
+                            // identity: offset 0, gain 1
+                            pC->m_mapParameters[p.iAsynReason]->adCache.push_back(0.);
+                            pC->m_mapParameters[p.iAsynReason]->adCache.push_back(1.);
+                        }
+                        switch (def.iAsynType)
+                        {
+                            case asynParamInt32:
+                                pC->setIntegerParam(p.iAsynReason, static_cast<epicsInt32>(def.dDefault));
+                                break;
+                            case asynParamFloat64:
+                                pC->setDoubleParam(p.iAsynReason, def.dDefault);
+                                break;
+                            case asynParamOctet:
+                                pC->setStringParam(p.iAsynReason, "");
+                                break;
+                            default:
+                                break;
+                        }
+                    }
+                }
+                break;
+            default:
+                break;
+        }
+        pC->PublishConfig(pInfo->address);
     } // for (auto it = hi.begin(); it != hi.end(); ++it)
     if (pC)
     {
+        static bool bInterruptEnabled(false);
         epicsThreadOpts opt(EPICS_THREAD_OPTS_INIT);
         opt.priority  = epicsThreadPriorityHigh;
         opt.stackSize = epicsThreadGetStackSize(epicsThreadStackBig);
         opt.joinable  = 1;
-        epicsThreadCreateOpt("mccdaqhats", &mccdaqhatsCtrl::backgroundthreadfunc, static_cast<void*>(pC), &opt);
+        if (!bInterruptEnabled)
+        {
+            // a single callback for all controllers, it is dispatched by "interruptfunc"
+            hat_interrupt_callback_enable(&mccdaqhatsCtrl::interruptfunc, nullptr);
+            bInterruptEnabled = true;
+            pC->m_bBusRecords = true; // the first controller writes the records of the bus parameters
+        }
+        {
+            // every controller publishes the shared bus parameters, they show the same global state
+            struct { const char* szName; asynParamType iAsynType; ParameterId iHatParam; bool bWriteable; const char* szDesc; } aBusParams[] =
+                { { "MCC_BUS_LOAD",   asynParamFloat64, MCCDAQHAT_BUS_LOAD,   false, "predicted load of running scans in %" },
+                  { "MCC_BUS_LIMIT",  asynParamFloat64, MCCDAQHAT_BUS_LIMIT,  true,  "allowed load for scan start in %" },
+                  { "MCC_BUS_POLICY", asynParamInt32,   MCCDAQHAT_BUS_POLICY, true,  "action on overload" },
+                  { "MCC_BUS_WAIT_STREAM", asynParamFloat64, MCCDAQHAT_BUS_WAIT_STREAM, false, "max. bus wait of scan data in ms" },
+                  { "MCC_BUS_WAIT_INTR",   asynParamFloat64, MCCDAQHAT_BUS_WAIT_INTR,   false, "max. bus wait of interrupts in ms" },
+                  { "MCC_BUS_WAIT_CONFIG", asynParamFloat64, MCCDAQHAT_BUS_WAIT_CONFIG, false, "max. bus wait of config in ms" } };
+            for (size_t i = 0; i < ARRAY_SIZE(aBusParams); ++i)
+            {
+                struct paramMccDaqHats p;
+                p.iAsynReason  = -1;
+                p.byAddress    = 0;
+                p.wHatID       = 0;
+                p.iHatParam    = aBusParams[i].iHatParam;
+                p.bWritable    = aBusParams[i].bWriteable;
+                p.sDescription = aBusParams[i].szDesc;
+                if (p.iHatParam == MCCDAQHAT_BUS_POLICY)
+                {
+                    p.asEnum.push_back("warn");
+                    p.asEnum.push_back("refuse");
+                }
+                pC->createParam(aBusParams[i].szName, aBusParams[i].iAsynType, &p.iAsynReason);
+                pC->m_mapParameters[p.iAsynReason] = new paramMccDaqHats(p);
+                switch (p.iHatParam)
+                {
+                    case MCCDAQHAT_BUS_LOAD:
+                        pC->m_iBusLoadReason = p.iAsynReason;
+                        pC->setDoubleParam(p.iAsynReason, 100. * mccdaqhatsBus::getLoad());
+                        break;
+                    case MCCDAQHAT_BUS_LIMIT:
+                        pC->m_iBusLimitReason = p.iAsynReason;
+                        pC->setDoubleParam(p.iAsynReason, 100. * mccdaqhatsBus::getLimit());
+                        break;
+                    case MCCDAQHAT_BUS_POLICY:
+                        pC->m_iBusPolicyReason = p.iAsynReason;
+                        pC->setIntegerParam(p.iAsynReason, mccdaqhatsBus::getRefuse() ? 1 : 0);
+                        break;
+                    default: // maximum wait of a priority class, updated by the acquisition thread
+                        pC->m_aiBusWaitReason[p.iHatParam - MCCDAQHAT_BUS_WAIT_STREAM] = p.iAsynReason;
+                        pC->setDoubleParam(p.iAsynReason, 0.);
+                        break;
+                }
+            }
+        }
+        epicsThreadCreateOpt(szAsynPort, &mccdaqhatsCtrl::backgroundthreadfunc, static_cast<void*>(pC), &opt);
         while (pC->m_hThread == static_cast<epicsThreadId>(0))
             epicsThreadSleep(0.1);
         pC->callParamCallbacks();
@@ -835,6 +2444,8 @@ void mccdaqhatsCtrl::report(FILE* fp, int iLevel)
 {
     fprintf(fp, "mccdaqhats controller driver, %s timeout=%g\n\n",
             portName, m_dTimeout);
+    if (iLevel > 0)
+        mccdaqhatsBus::report(fp);
     if (iLevel > 3)
     {
         int iNumParams(0);
@@ -900,24 +2511,21 @@ asynStatus mccdaqhatsCtrl::readInt32(asynUser* pasynUser, epicsInt32* piValue)
     iResult = asynPortDriver::readInt32(pasynUser, piValue); // default handler: read cache
     if (pParam)
     {
-        if (pParam->byAddress >= m_abyChannelMask.size())
-            m_abyChannelMask.resize(static_cast<size_t>(pParam->byAddress) + 1, 0);
         switch (pParam->wHatID)
         {
             case HAT_ID_MCC_118: // 8-ch 12 bit single-ended analog input
                 switch (pParam->iHatParam)
                 {
                     case MCCDAQHAT_START: // enum 0, STOP=0, START=1
-                    {
-                        uint16_t wStatus(0);
-                        uint32_t dwSamplesPerChannel(0);
-                        *piValue = (mcc118_a_in_scan_status(pParam->byAddress, &wStatus, &dwSamplesPerChannel) == RESULT_SUCCESS
-                                    && (wStatus & STATUS_RUNNING) != 0) ? 1 : 0;
+                        *piValue = IsScanActive(pParam->byAddress) ? 1 : 0;
+                        iResult = setIntegerParam(pasynUser->reason, *piValue);
+                        break;
+                    case MCCDAQHAT_STATE: // enum 0, idle=0, armed=1, running=2, overrun=3, stopped=4
+                        *piValue = GetScanState(pParam->byAddress);
                         iResult = setIntegerParam(pasynUser->reason, *piValue);
                         break;
-                    }
                     case MCCDAQHAT_MASK: // uint8 0xFF, 1…255 channel selection bit mask
-                        *piValue = m_abyChannelMask[pParam->byAddress];
+                        *piValue = m_abyRequestedMask[pParam->byAddress]; // could be still queued
                         iResult = setIntegerParam(pasynUser->reason, *piValue);
                         break;
                     default:
@@ -928,16 +2536,15 @@ asynStatus mccdaqhatsCtrl::readInt32(asynUser* pasynUser, epicsInt32* piValue)
                 switch (pParam->iHatParam)
                 {
                     case MCCDAQHAT_START: // enum 0, STOP=0, START=1
-                    {
-                        uint16_t wStatus(0);
-                        uint32_t dwSamplesPerChannel(0);
-                        *piValue = (mcc128_a_in_scan_status(pParam->byAddress, &wStatus, &dwSamplesPerChannel) == RESULT_SUCCESS
-                                    && (wStatus & STATUS_RUNNING) != 0) ? 1 : 0;
+                        *piValue = IsScanActive(pParam->byAddress) ? 1 : 0;
+                        iResult = setIntegerParam(pasynUser->reason, *piValue);
+                        break;
+                    case MCCDAQHAT_STATE: // enum 0, idle=0, armed=1, running=2, overrun=3, stopped=4
+                        *piValue = GetScanState(pParam->byAddress);
                         iResult = setIntegerParam(pasynUser->reason, *piValue);
                         break;
-                    }
                     case MCCDAQHAT_MASK: // uint8 0xFF, 1…255 channel selection bit mask
-                        *piValue = m_abyChannelMask[pParam->byAddress];
+                        *piValue = m_abyRequestedMask[pParam->byAddress]; // could be still queued
                         iResult = setIntegerParam(pasynUser->reason, *piValue);
                         break;
                     default:
@@ -954,7 +2561,7 @@ asynStatus mccdaqhatsCtrl::readInt32(asynUser* pasynUser, epicsInt32* piValue)
                     {
                         uint8_t byChannel(static_cast<uint8_t>(pParam->iHatParam - MCCDAQHAT_C0));
                         double dValue(static_cast<double>(epicsNAN));
-                        if (mcc134_a_in_read(pParam->byAddress, byChannel, OPTS_DEFAULT, &dValue) == RESULT_SUCCESS
+                        if (busCall(mcc134_a_in_read, pParam->byAddress, byChannel, OPTS_DEFAULT, &dValue) == RESULT_SUCCESS
                             && isfinite(dValue))
                         {
                             if (dValue >= std::numeric_limits<epicsInt32>::max())
@@ -979,7 +2586,7 @@ asynStatus mccdaqhatsCtrl::readInt32(asynUser* pasynUser, epicsInt32* piValue)
                     {
                         uint8_t byChannel(static_cast<uint8_t>(pParam->iHatParam - MCCDAQHAT_CJC0));
                         double dValue(static_cast<double>(epicsNAN));
-                        if (mcc134_cjc_read(pParam->byAddress, byChannel, &dValue) == RESULT_SUCCESS
+                        if (busCall(mcc134_cjc_read, pParam->byAddress, byChannel, &dValue) == RESULT_SUCCESS
                             && isfinite(dValue))
                         {
                             if (dValue >= std::numeric_limits<epicsInt32>::max())
@@ -1000,7 +2607,7 @@ asynStatus mccdaqhatsCtrl::readInt32(asynUser* pasynUser, epicsInt32* piValue)
                     case MCCDAQHAT_RATE: // uint8 update interval, 1…255
                     {
                         uint8_t byInterval(0);
-                        if (mcc134_update_interval_read(pParam->byAddress, &byInterval) == RESULT_SUCCESS)
+                        if (busCall(mcc134_update_interval_read, pParam->byAddress, &byInterval) == RESULT_SUCCESS)
                         {
                             *piValue = byInterval;
                             iResult = setIntegerParam(pasynUser->reason, *piValue);
@@ -1023,7 +2630,7 @@ asynStatus mccdaqhatsCtrl::readInt32(asynUser* pasynUser, epicsInt32* piValue)
                     case MCCDAQHAT_##param:     \
                     {                           \
                         uint8_t byValue(0);     \
-                        if (mcc152_dio_##func##_read_port(pParam->byAddress, &byValue) == RESULT_SUCCESS) \
+                        if (busCall(mcc152_dio_##func##_read_port, pParam->byAddress, &byValue) == RESULT_SUCCESS) \
                         {                       \
                             *piValue = byValue; \
                             iResult = setIntegerParam(pasynUser->reason, *piValue); \
@@ -1039,7 +2646,7 @@ asynStatus mccdaqhatsCtrl::readInt32(asynUser* pasynUser, epicsInt32* piValue)
                     case MCCDAQHAT_##param:     \
                     {                           \
                         uint8_t byValue(0);     \
-                        if (mcc152_dio_config_read_port(pParam->byAddress, DIO_##item, &byValue) == RESULT_SUCCESS) \
+                        if (busCall(mcc152_dio_config_read_port, pParam->byAddress, DIO_##item, &byValue) == RESULT_SUCCESS) \
                         {                       \
                             *piValue = byValue; \
                             iResult = setIntegerParam(pasynUser->reason, *piValue); \
@@ -1069,23 +2676,22 @@ asynStatus mccdaqhatsCtrl::readInt32(asynUser* pasynUser, epicsInt32* piValue)
                 switch (pParam->iHatParam)
                 {
                     case MCCDAQHAT_START: // enum 0, STOP=0, START=1
-                    {
-                        uint16_t wStatus(0);
-                        uint32_t dwSamplesPerChannel(0);
-                        *piValue = (mcc172_a_in_scan_status(pParam->byAddress, &wStatus, &dwSamplesPerChannel) == RESULT_SUCCESS
-                                    && (wStatus & STATUS_RUNNING) != 0) ? 1 : 0;
+                        *piValue = IsScanActive(pParam->byAddress) ? 1 : 0;
+                        iResult = setIntegerParam(pasynUser->reason, *piValue);
+                        break;
+                    case MCCDAQHAT_STATE: // enum 0, idle=0, armed=1, running=2, overrun=3, stopped=4
+                        *piValue = GetScanState(pParam->byAddress);
                         iResult = setIntegerParam(pasynUser->reason, *piValue);
                         break;
-                    }
                     case MCCDAQHAT_MASK: // uint8 0x03, 1…3 channel selection bit mask
-                        *piValue = m_abyChannelMask[pParam->byAddress];
+                        *piValue = m_abyRequestedMask[pParam->byAddress]; // could be still queued
                         iResult = setIntegerParam(pasynUser->reason, *piValue);
                         break;
                     case MCCDAQHAT_IEPE0: // uint8 , 0=OFF, 1=ON
                     case MCCDAQHAT_IEPE1:
                     {
                         uint8_t c(0);
-                        if (mcc172_iepe_config_read(pParam->byAddress,
+                        if (busCall(mcc172_iepe_config_read, pParam->byAddress,
                                 static_cast<uint8_t>(pParam->iHatParam - MCCDAQHAT_IEPE0), &c) != RESULT_SUCCESS)
                         {
                             asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::readInt32 - MCC134: cannot read IEPE config\n");
@@ -1099,6 +2705,13 @@ asynStatus mccdaqhatsCtrl::readInt32(asynUser* pasynUser, epicsInt32* piValue)
                         break;
                 }
                 break;
+            case 0: // shared SPI bus
+                if (pParam->iHatParam == MCCDAQHAT_BUS_POLICY)
+                {
+                    *piValue = mccdaqhatsBus::getRefuse() ? 1 : 0;
+                    iResult = setIntegerParam(pasynUser->reason, *piValue);
+                }
+                break;
             default: // unsupported device
                 break;
         }
@@ -1118,717 +2731,1594 @@ asynStatus mccdaqhatsCtrl::writeInt32(asynUser* pasynUser, epicsInt32 iValue)
 {
     asynStatus iResult(asynSuccess);
     struct paramMccDaqHats* pParam(nullptr);
+    bool bPublish(false);
     if (pasynUser->reason >= 0 && m_mapParameters.count(pasynUser->reason))
         pParam = m_mapParameters[pasynUser->reason];
     if (!pParam) // default handler for other asyn parameters
         goto handleWrite;
-    if (pParam->byAddress >= m_abyChannelMask.size())
-        m_abyChannelMask.resize(static_cast<size_t>(pParam->byAddress) + 1, 0);
-    switch (pParam->wHatID)
+    if (findStreamParam(pParam->iHatParam, nullptr))
     {
-        case HAT_ID_MCC_118: // 8-ch 12 bit single-ended analog input
+        // stream processing: applied by the acquisition thread at the next block
+        iResult = checkStreamParam(pasynUser, pParam, static_cast<double>(iValue));
+        if (iResult == asynSuccess && iValue && pParam->byAddress < m_apBoards.size() && m_apBoards[pParam->byAddress])
         {
-            uint16_t wStatus(0);
-            uint32_t dwSamplesPerChannel(0);
-            bool bStarted(mcc118_a_in_scan_status(pParam->byAddress, &wStatus, &dwSamplesPerChannel) == RESULT_SUCCESS
-                          && (wStatus & STATUS_RUNNING) != 0);
-            switch (pParam->iHatParam)
+            // triggers only: count them for the acquisition thread
+            if (pParam->iHatParam >= MCCDAQHAT_STAT_RESET0 && pParam->iHatParam <= MCCDAQHAT_STAT_RESET7)
             {
-                case MCCDAQHAT_START: // enum 0, STOP=0, START=1
-                    if (!iValue)
-                    {
-                        // no data acquisition
-                        if (mcc118_a_in_scan_stop(pParam->byAddress) != RESULT_SUCCESS && bStarted)
+                ++m_apBoards[pParam->byAddress]->aiStatReset[pParam->iHatParam - MCCDAQHAT_STAT_RESET0];
+                iValue = 0;
+            }
+            else if (pParam->iHatParam == MCCDAQHAT_SCOPE_ARM)
+            {
+                ++m_apBoards[pParam->byAddress]->iScopeArm;
+                iValue = 0;
+            }
+        }
+        if (iResult == asynSuccess && pParam->iHatParam >= MCCDAQHAT_EU_MODE0 && pParam->iHatParam <= MCCDAQHAT_EU_MODE7)
+        {
+            // the coefficients have to match the new conversion type
+            auto it(m_mapDev2Asyn.find(GetMapHash(pParam->byAddress, MCCDAQHAT_EU_COEF0 + (pParam->iHatParam - MCCDAQHAT_EU_MODE0))));
+            const char* szError(nullptr);
+            if (it != m_mapDev2Asyn.end() && m_mapParameters.count((*it).second))
+                szError = mccdaqhatsConversion::check(iValue, m_mapParameters[(*it).second]->adCache);
+            if (szError)
+            {
+                asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - %s\n", szError);
+                iResult = asynError;
+            }
+        }
+        if (iResult == asynSuccess &&
+            ((pParam->iHatParam >= MCCDAQHAT_DEC_FACTOR0 && pParam->iHatParam <= MCCDAQHAT_DEC_FACTOR7) ||
+             (pParam->iHatParam >= MCCDAQHAT_DEC_TYPE0 && pParam->iHatParam <= MCCDAQHAT_DEC_TYPE7)))
+        {
+            // the FIR filter needs 8*factor+1 coefficients, it is limited to keep its stop band
+            int iChannel(0);
+            findStreamParam(pParam->iHatParam, &iChannel);
+            bool bFactor(pParam->iHatParam <= MCCDAQHAT_DEC_FACTOR7);
+            epicsInt32 iFactor(bFactor ? iValue : GetDevParamInt(pParam->byAddress, MCCDAQHAT_DEC_FACTOR0 + iChannel, 1));
+            epicsInt32 iType(bFactor ? GetDevParamInt(pParam->byAddress, MCCDAQHAT_DEC_TYPE0 + iChannel, 0) : iValue);
+            if (iType == mccdaqhatsDecimator::FILTER_FIR && iFactor > mccdaqhatsDecimator::MAX_FIR_FACTOR)
+            {
+                asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - FIR decimation factor is limited to %d\n",
+                          mccdaqhatsDecimator::MAX_FIR_FACTOR);
+                iResult = asynError;
+            }
+        }
+        bPublish = true;
+        goto handleWrite;
+    }
+    {
+        switch (pParam->wHatID)
+        {
+            case HAT_ID_MCC_118: // 8-ch 12 bit single-ended analog input
+            {
+                bool bStarted(IsScanActive(pParam->byAddress) || IsScanBusy(pParam->byAddress));
+                switch (pParam->iHatParam)
+                {
+                    case MCCDAQHAT_START: // enum 0, STOP=0, START=1
+                        iResult = QueueScan(pasynUser, pParam->byAddress, iValue != 0);
+                        break;
+                    case MCCDAQHAT_MASK: // uint8 0xFF, 1…255 channel selection bit mask
+                        if (iValue > 0 && iValue < 256 && bStarted) // restart with new configuration
+                            iResult = QueueScan(pasynUser, pParam->byAddress, true, MCCDAQHAT_MASK, static_cast<double>(iValue));
+                        else if (iValue > 0 && iValue < 256)
+                        {
+                            m_abyChannelMask[pParam->byAddress]   = static_cast<uint8_t>(iValue);
+                            m_abyRequestedMask[pParam->byAddress] = static_cast<uint8_t>(iValue);
+                            PublishConfig(pParam->byAddress);
+                        }
+                        else
                         {
-                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - cannot stop MCC118\n");
+                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - invalid channel mask\n");
                             iResult = asynError;
                         }
-                        mcc118_a_in_scan_cleanup(pParam->byAddress);
-                    }
-                    else if (!bStarted && m_abyChannelMask[pParam->byAddress])
-                    {
-                        // prepare data acquisition
-                        int iAsynRate(m_mapDev2Asyn[GetMapHash(pParam->byAddress, MCCDAQHAT_RATE)]);
-                        double dRate(static_cast<double>(epicsNAN)), dTmp(dRate);
-                        uint8_t byMask(m_abyChannelMask[pParam->byAddress]), byChannels(0);
-                        epicsInt32 iTrig(GetDevParamInt(pParam->byAddress, MCCDAQHAT_TRIG, static_cast<epicsInt32>(-1)));
-                        uint32_t dwOptions(OPTS_CONTINUOUS);
-
-                        if (iTrig < 0 || !byMask)
+                        break;
+                    case MCCDAQHAT_RATE: // float 100000, <=0: external clock with frequency hint
+                        return writeFloat64(pasynUser, static_cast<epicsFloat64>(iValue));
+                    case MCCDAQHAT_TRIG: // enum 0, none=0, rising=1, falling=2, high=3, low=4
+                        if (iValue < 0 || iValue > 4) iResult = asynError;
+                        else if (bStarted) // restart with new configuration
+                            iResult = QueueScan(pasynUser, pParam->byAddress, true, MCCDAQHAT_TRIG, static_cast<double>(iValue));
+                        break;
+                    default:
+                        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC118 read only parameter\n");
+                        iResult = asynError; // not writeable
+                        break;
+                }
+                break;
+            } // case HAT_ID_MCC_118
+            case HAT_ID_MCC_128: // 4-ch differential / 8-ch single-ended 16 bit analog input
+            {
+                bool bStarted(IsScanActive(pParam->byAddress) || IsScanBusy(pParam->byAddress));
+                switch (pParam->iHatParam)
+                {
+                    case MCCDAQHAT_START: // enum 0, STOP=0, START=1
+                        iResult = QueueScan(pasynUser, pParam->byAddress, iValue != 0);
+                        break;
+                    case MCCDAQHAT_MASK: // uint8 0xFF, 1…255 channel selection bit mask
+                        if (iValue > 0 && iValue < 256 && bStarted) // restart with new configuration
+                            iResult = QueueScan(pasynUser, pParam->byAddress, true, MCCDAQHAT_MASK, static_cast<double>(iValue));
+                        else if (iValue > 0 && iValue < 256)
                         {
-                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - start MCC118: invalid channel mask or trigger configured\n");
-                            return asynError;
+                            m_abyChannelMask[pParam->byAddress]   = static_cast<uint8_t>(iValue);
+                            m_abyRequestedMask[pParam->byAddress] = static_cast<uint8_t>(iValue);
+                            PublishConfig(pParam->byAddress);
                         }
-                        if (getDoubleParam(iAsynRate, &dRate) != asynSuccess)
-                            dRate = static_cast<double>(epicsNAN);
-                        for (int i = 0; i < 8; ++i, byMask >>= 1) if (byMask & 1) ++byChannels;
-                        if (!isfinite(dRate) || fabs(dRate) < 1. || floor(byChannels * fabs(dRate)) > 100000.)
+                        else
                         {
-                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - start MCC118: invalid rate configured\n");
-                            return asynError;
+                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - invalid channel mask\n");
+                            iResult = asynError;
                         }
-                        if (mcc118_a_in_scan_actual_rate(byChannels, fabs(dRate), &dTmp) != RESULT_SUCCESS)
+                        break;
+                    case MCCDAQHAT_RATE: // float 100000, <=0: external clock with frequency hint
+                        return writeFloat64(pasynUser, static_cast<epicsFloat64>(iValue));
+                    case MCCDAQHAT_TRIG: // enum 0, none=0, rising=1, falling=2, high=3, low=4
+                        if (iValue < 0 || iValue > 4)
                         {
-                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - start MCC118: invalid rate configured\n");
-                            return asynError;
+                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC128 invalid trigger mode\n");
+                            iResult = asynError;
                         }
-                        mcc118_a_in_scan_stop(pParam->byAddress);
-                        mcc118_a_in_scan_cleanup(pParam->byAddress);
-                        if (dRate < 0.)
+                        else if (bStarted) // restart with new configuration
+                            iResult = QueueScan(pasynUser, pParam->byAddress, true, MCCDAQHAT_TRIG, static_cast<double>(iValue));
+                        break;
+                    case MCCDAQHAT_RANGE: // enum 0, ±10V=0, ±5V=1, ±2V=2, ±1V=3
+                        if (iValue < 0 || iValue > 3)
                         {
-                            dTmp = -dTmp;
-                            dwOptions |= OPTS_EXTCLOCK;
+                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC128 invalid analog range\n");
+                            iResult = asynError;
                         }
-                        if (iTrig > 0)
+                        else if (bStarted) // restart with new configuration
+                            iResult = QueueScan(pasynUser, pParam->byAddress, true, MCCDAQHAT_RANGE, static_cast<double>(iValue));
+                        break;
+                    case MCCDAQHAT_MODE: // enum 0, 0=single-ended, 1=differential
+                        if (iValue < 0 || iValue > 1)
                         {
-                            mcc118_trigger_mode(pParam->byAddress, static_cast<uint8_t>(iTrig - 1));
-                            dwOptions |= OPTS_EXTTRIGGER;
+                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC128 invalid input mode\n");
+                            iResult = asynError;
                         }
-                        if (fabs(dRate - dTmp) > 0.)
+                        else if (bStarted) // restart with new configuration
+                            iResult = QueueScan(pasynUser, pParam->byAddress, true, MCCDAQHAT_MODE, static_cast<double>(iValue));
+                        break;
+                    default:
+                        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC128 read only parameter\n");
+                        iResult = asynError; // not writeable
+                        break;
+                }
+                break;
+            } // case HAT_ID_MCC_128
+            case HAT_ID_MCC_134: // 4-ch 24 bit thermocouple input
+            {
+                switch (pParam->iHatParam)
+                {
+                    case MCCDAQHAT_RATE: // uint8, 1…255
+                        if (iValue < 1 || iValue > 255)
                         {
-                            setDoubleParam(iAsynRate, dRate = dTmp);
-                            callParamCallbacks();
+                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC134: invalid update interval\n");
+                            return asynError;
                         }
-                        // start data acquisition
-                        if (mcc118_a_in_scan_start(pParam->byAddress, m_abyChannelMask[pParam->byAddress], 0, fabs(dRate), dwOptions) != RESULT_SUCCESS)
+                        if (busCall(mcc134_update_interval_write, pParam->byAddress, static_cast<uint8_t>(iValue)) != RESULT_SUCCESS)
                         {
-                            mcc118_a_in_scan_stop(pParam->byAddress);
-                            mcc118_a_in_scan_cleanup(pParam->byAddress);
-                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - cannot start MCC118\n");
+                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC134: cannot set update interval\n");
                             iResult = asynError;
                         }
-                    }
-                    break;
-                case MCCDAQHAT_MASK: // uint8 0xFF, 1…255 channel selection bit mask
-                    if (bStarted)
-                    {
-                        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC118 is active\n");
-                        return asynError;
-                    }
-                    if (iValue > 0 && iValue < 256)
-                        m_abyChannelMask[pParam->byAddress] = static_cast<uint8_t>(iValue);
-                    else
-                    {
-                        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - invalid channel mask\n");
-                        iResult = asynError;
-                    }
-                    break;
-                case MCCDAQHAT_RATE: // float 100000, <=0: external clock with frequency hint
-                    return writeFloat64(pasynUser, static_cast<epicsFloat64>(iValue));
-                case MCCDAQHAT_TRIG: // enum 0, none=0, rising=1, falling=2, high=3, low=4
-                    if (bStarted)
-                    {
-                        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC118 is active\n");
-                        return asynError;
-                    }
-                    if (iValue < 0 || iValue > 4) iResult = asynError;
-                    break;
-                default:
-                    asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC118 read only parameter\n");
-                    iResult = asynError; // not writeable
-                    break;
-            }
-            break;
-        } // case HAT_ID_MCC_118
-        case HAT_ID_MCC_128: // 4-ch differential / 8-ch single-ended 16 bit analog input
-        {
-            uint16_t wStatus(0);
-            uint32_t dwSamplesPerChannel(0);
-            bool bStarted(mcc128_a_in_scan_status(pParam->byAddress, &wStatus, &dwSamplesPerChannel) == RESULT_SUCCESS
-                          && (wStatus & STATUS_RUNNING) != 0);
-            switch (pParam->iHatParam)
-            {
-                case MCCDAQHAT_START: // enum 0, STOP=0, START=1
-                    if (!iValue)
-                    {
-                        // no data acquisition
-                        if (mcc128_a_in_scan_stop(pParam->byAddress) != RESULT_SUCCESS && bStarted)
+                        break;
+                    case MCCDAQHAT_TCTYPE0: // uint8, 0…8
+                    case MCCDAQHAT_TCTYPE1:
+                    case MCCDAQHAT_TCTYPE2:
+                    case MCCDAQHAT_TCTYPE3:
+                        if (iValue < 0 || iValue > 8)
+                        {
+                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC134: invalid thermo couple type\n");
+                            return asynError;
+                        }
+                        if (busCall(mcc134_tc_type_write, pParam->byAddress, static_cast<uint8_t>(pParam->iHatParam - MCCDAQHAT_TCTYPE0),
+                                                 static_cast<uint8_t>(iValue)) != RESULT_SUCCESS)
                         {
-                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - cannot stop MCC128\n");
+                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC134: cannot write thermo couple type\n");
                             iResult = asynError;
                         }
-                        mcc128_a_in_scan_cleanup(pParam->byAddress);
-                    }
-                    else if (!bStarted && m_abyChannelMask[pParam->byAddress])
+                        break;
+                    default:
+                        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC134 read only parameter\n");
+                        iResult = asynError; // not writeable
+                        break;
+                }
+                break;
+            } // case HAT_ID_MCC_134
+            case HAT_ID_MCC_152: // 2-ch 12 bit analog output, 8-ch digital I/O
+                switch (pParam->iHatParam)
+                {
+                    case MCCDAQHAT_DO:
                     {
-                        // prepare data acquisition
-                        int iAsynRate(m_mapDev2Asyn[GetMapHash(pParam->byAddress, MCCDAQHAT_RATE)]);
-                        double dRate(static_cast<double>(epicsNAN)), dTmp(dRate);
-                        uint8_t byMask(m_abyChannelMask[pParam->byAddress]), byChannels(0);
-                        epicsInt32 iTrig(GetDevParamInt(pParam->byAddress, MCCDAQHAT_TRIG, static_cast<epicsInt32>(-1)));
-                        epicsInt32 iRange(GetDevParamInt(pParam->byAddress, MCCDAQHAT_RANGE, static_cast<epicsInt32>(-1)));
-                        epicsInt32 iMode(GetDevParamInt(pParam->byAddress, MCCDAQHAT_MODE, static_cast<epicsInt32>(-1)));
-                        uint32_t dwOptions(OPTS_CONTINUOUS);
-
-                        if (iTrig < 0 || iRange < 0 || iMode < 0 || !byMask)
+                        if (iValue < 0 || iValue > 255)
                         {
-                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - start MCC128: invalid channel mask, trigger, range or mode configured\n");
+                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC152: invalid output value\n");
                             return asynError;
                         }
-                        if (iMode && byMask > 0x0F) // 4-channels in differential mode
+                        if (busCall(mcc152_dio_output_write_port, pParam->byAddress, static_cast<uint8_t>(iValue)) != RESULT_SUCCESS)
                         {
-                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - start MCC128: invalid channel mask for differential mode\n");
+                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC152: cannot write digital outputs\n");
                             return asynError;
                         }
-                        if (getDoubleParam(iAsynRate, &dRate) != asynSuccess)
-                            dRate = static_cast<double>(epicsNAN);
-                        for (int i = 0; i < 8; ++i, byMask >>= 1) if (byMask & 1) ++byChannels;
-                        if (!isfinite(dRate) || fabs(dRate) < 1. || floor(byChannels * fabs(dRate)) > 100000.)
+                        break;
+                    }
+#define HANDLE_MCC152_CONF(param,item,errmsg)       \
+                    case MCCDAQHAT_##param:             \
+                    {                                   \
+                        if (iValue < 0 || iValue > 255) \
+                        {                               \
+                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC152: invalid output value\n"); \
+                            return asynError;           \
+                        }                               \
+                        if (busCall(mcc152_dio_config_write_port, pParam->byAddress, DIO_##item, static_cast<uint8_t>(iValue)) != RESULT_SUCCESS) \
+                        {                               \
+                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::readInt32 - MCC152: cannot read " errmsg "\n"); \
+                            return asynError;           \
+                        }                               \
+                        break;                          \
+                    }
+                    HANDLE_MCC152_CONF(DIR,DIRECTION,"direction")
+                    HANDLE_MCC152_CONF(IN_PULL_EN,PULL_ENABLE,"pull-up direction")
+                    HANDLE_MCC152_CONF(IN_PULL_CFG,PULL_CONFIG,"pull-up configuration")
+                    HANDLE_MCC152_CONF(IN_INV,INPUT_INVERT,"data invertion")
+                    HANDLE_MCC152_CONF(IN_LATCH,INPUT_LATCH,"latch configuration")
+                    HANDLE_MCC152_CONF(OUT_TYPE,OUTPUT_TYPE,"output configuration")
+#undef HANDLE_MCC152_CONF
+                    default:
+                        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC152 read only parameter\n");
+                        iResult = asynError; // not writeable
+                        break;
+                }
+                break;
+            case HAT_ID_MCC_172: // 2-ch 24 bit differential analog input
+            {
+                bool bStarted(IsScanActive(pParam->byAddress) || IsScanBusy(pParam->byAddress));
+                switch (pParam->iHatParam)
+                {
+                    case MCCDAQHAT_START: // enum 0, STOP=0, START=1
+                        iResult = QueueScan(pasynUser, pParam->byAddress, iValue != 0);
+                        break;
+                    case MCCDAQHAT_MASK: // uint8 0xFF, 1…3 channel selection bit mask
+                        if (iValue > 0 && iValue < 4 && bStarted) // restart with new configuration
+                            iResult = QueueScan(pasynUser, pParam->byAddress, true, MCCDAQHAT_MASK, static_cast<double>(iValue));
+                        else if (iValue > 0 && iValue < 4)
                         {
-                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - start MCC128: invalid rate configured\n");
-                            return asynError;
+                            m_abyChannelMask[pParam->byAddress]   = static_cast<uint8_t>(iValue);
+                            m_abyRequestedMask[pParam->byAddress] = static_cast<uint8_t>(iValue);
+                            PublishConfig(pParam->byAddress);
+                        }
+                        else
+                        {
+                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC172 channel mask\n");
+                            iResult = asynError;
+                        }
+                        break;
+                    case MCCDAQHAT_RATE: // float 100000, <=0: external clock with frequency hint
+                        return writeFloat64(pasynUser, static_cast<epicsFloat64>(iValue));
+                    case MCCDAQHAT_TRIG: // enum 0, none=0, rising=1, falling=2, high=3, low=4
+                        if (iValue < 0 || iValue > 4)
+                        {
+                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC172 invalid trigger mode\n");
+                            iResult = asynError;
                         }
-                        if (mcc128_a_in_scan_actual_rate(byChannels, fabs(dRate), &dTmp) != RESULT_SUCCESS)
+                        else if (bStarted) // restart with new configuration
+                            iResult = QueueScan(pasynUser, pParam->byAddress, true, MCCDAQHAT_TRIG, static_cast<double>(iValue));
+                        break;
+                    case MCCDAQHAT_CLKSRC: // enum 0, local=0, master=1, slave=2
+                        if (bStarted)
                         {
-                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - start MCC128: invalid rate configured\n");
+                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC172 is active or busy\n");
                             return asynError;
                         }
-                        mcc128_a_in_scan_stop(pParam->byAddress);
-                        mcc128_a_in_scan_cleanup(pParam->byAddress);
-                        if (dRate < 0.)
+                        if (iValue < 0 || iValue > 2)
                         {
-                            dTmp = -dTmp;
-                            dwOptions |= OPTS_EXTCLOCK;
+                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC172 invalid clock source\n");
+                            return asynError;
                         }
-                        if (iTrig > 0)
+                        if (iValue != 1) // disable clock output, real trigger will be configured later
+                            busCall(mcc172_trigger_config, pParam->byAddress, static_cast<uint8_t>(iValue), TRIG_RISING_EDGE);
+                        break;
+                    case MCCDAQHAT_IEPE0: // uint8 , 0=OFF, 1=ON
+                    case MCCDAQHAT_IEPE1:
+                        if (iValue < 0 || iValue > 1)
                         {
-                            mcc128_trigger_mode(pParam->byAddress, static_cast<uint8_t>(iTrig - 1));
-                            dwOptions |= OPTS_EXTTRIGGER;
+                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC172 invalid IEPE config\n");
+                            return asynError;
                         }
-                        mcc128_a_in_range_write(pParam->byAddress, static_cast<uint8_t>(iRange));
-                        mcc128_a_in_mode_write(pParam->byAddress, static_cast<uint8_t>(iMode ? 1 : 0));
-                        if (fabs(dRate - dTmp) > 0.)
+                        if (busCall(mcc172_iepe_config_write, pParam->byAddress,
+                                                     static_cast<uint8_t>(pParam->iHatParam - MCCDAQHAT_IEPE0),
+                                                     static_cast<uint8_t>(iValue)) != RESULT_SUCCESS)
                         {
-                            setDoubleParam(iAsynRate, dRate = dTmp);
-                            callParamCallbacks();
+                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC172 cannot write IEPE config\n");
+                            return asynError;
                         }
-                        // start data acquisition
-                        if (mcc128_a_in_scan_start(pParam->byAddress, m_abyChannelMask[pParam->byAddress], 0, fabs(dRate), dwOptions) != RESULT_SUCCESS)
+                        break;
+                    default:
+                        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC172 read only parameter\n");
+                        iResult = asynError; // not writeable
+                        break;
+                }
+                break;
+            } // case HAT_ID_MCC_172
+            case 0: // shared SPI bus
+                switch (pParam->iHatParam)
+                {
+                    case MCCDAQHAT_BUS_LIMIT:
+                        return writeFloat64(pasynUser, static_cast<epicsFloat64>(iValue));
+                    case MCCDAQHAT_BUS_POLICY: // enum 0, warn=0, refuse=1
+                        if (iValue < 0 || iValue > 1)
                         {
-                            mcc128_a_in_scan_stop(pParam->byAddress);
-                            mcc128_a_in_scan_cleanup(pParam->byAddress);
-                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - start MCC128: cannot start\n");
-                            iResult = asynError;
+                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - invalid bus policy\n");
+                            return asynError;
                         }
-                    }
-                    break;
-                case MCCDAQHAT_MASK: // uint8 0xFF, 1…255 channel selection bit mask
-                    if (bStarted)
-                    {
-                        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC128 is active\n");
-                        return asynError;
-                    }
-                    if (iValue > 0 && iValue < 256)
-                        m_abyChannelMask[pParam->byAddress] = static_cast<uint8_t>(iValue);
-                    else
-                    {
-                        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - invalid channel mask\n");
-                        iResult = asynError;
-                    }
-                    break;
-                case MCCDAQHAT_RATE: // float 100000, <=0: external clock with frequency hint
-                    return writeFloat64(pasynUser, static_cast<epicsFloat64>(iValue));
-                case MCCDAQHAT_TRIG: // enum 0, none=0, rising=1, falling=2, high=3, low=4
-                    if (bStarted)
-                    {
-                        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC128 is active\n");
-                        return asynError;
-                    }
-                    if (iValue < 0 || iValue > 4)
-                    {
-                        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC128 invalid trigger mode\n");
-                        iResult = asynError;
-                    }
-                    break;
-                case MCCDAQHAT_RANGE: // enum 0, ±10V=0, ±5V=1, ±2V=2, ±1V=3
-                    if (bStarted)
-                    {
-                        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC128 is active\n");
-                        return asynError;
-                    }
-                    if (iValue < 0 || iValue > 3)
-                    {
-                        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC128 invalid analog range\n");
-                        iResult = asynError;
-                    }
-                    break;
-                case MCCDAQHAT_MODE: // enum 0, 0=single-ended, 1=differential
-                    if (bStarted)
-                    {
-                        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC128 is active\n");
-                        return asynError;
-                    }
-                    if (iValue < 0 || iValue > 1)
-                    {
-                        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC128 invalid input mode\n");
-                        iResult = asynError;
-                    }
-                    break;
-                default:
-                    asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC128 read only parameter\n");
-                    iResult = asynError; // not writeable
-                    break;
-            }
-            break;
-        } // case HAT_ID_MCC_128
-        case HAT_ID_MCC_134: // 4-ch 24 bit thermocouple input
+                        mccdaqhatsBus::setRefuse(iValue != 0);
+                        break;
+                    default:
+                        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - bus read only parameter\n");
+                        iResult = asynError; // not writeable
+                        break;
+                }
+                break;
+            default: // unsupported device
+                iResult = asynError; // not writeable
+                break;
+        }
+    }
+
+handleWrite:
+    if (iResult == asynSuccess)
+        iResult = asynPortDriver::writeInt32(pasynUser, iValue);
+    if (iResult == asynSuccess && bPublish)
+        PublishConfig(pParam->byAddress);
+    return iResult;
+}
+
+/**
+ * @brief Called when asyn clients call pasynFloat64->read().
+ *        For some parameters, it reads the hardware and in other cases,
+ *        this will call the base class, which simply returns the stored value.
+ * @param[in]  pasynUser  pasynUser structure that encodes the reason and address.
+ * @param[out] pdValue    address of the value to read.
+ * @return asyn result code
+ */
+asynStatus mccdaqhatsCtrl::readFloat64(asynUser* pasynUser, epicsFloat64* pdValue)
+{
+    asynStatus iResult(asynError);
+    struct paramMccDaqHats* pParam(nullptr);
+    if (pasynUser->reason >= 0 && m_mapParameters.count(pasynUser->reason))
+        pParam = m_mapParameters[pasynUser->reason];
+    iResult = asynPortDriver::readFloat64(pasynUser, pdValue); // default handler: read cache
+    if (pParam)
+    {
+        switch (pParam->wHatID)
         {
-            switch (pParam->iHatParam)
-            {
-                case MCCDAQHAT_RATE: // uint8, 1…255
-                    if (iValue < 1 || iValue > 255)
-                    {
-                        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC134: invalid update interval\n");
-                        return asynError;
-                    }
-                    if (mcc134_update_interval_write(pParam->byAddress, static_cast<uint8_t>(iValue)) != RESULT_SUCCESS)
-                    {
-                        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC134: cannot set update interval\n");
-                        iResult = asynError;
-                    }
-                    break;
-                case MCCDAQHAT_TCTYPE0: // uint8, 0…8
-                case MCCDAQHAT_TCTYPE1:
-                case MCCDAQHAT_TCTYPE2:
-                case MCCDAQHAT_TCTYPE3:
-                    if (iValue < 0 || iValue > 8)
+            case HAT_ID_MCC_118: // 8-ch 12 bit single-ended analog input
+                break; // nothing to do here
+            case HAT_ID_MCC_128: // 4-ch differential / 8-ch single-ended 16 bit analog input
+                break; // nothing to do here
+            case HAT_ID_MCC_134: // 4-ch 24 bit thermocouple input
+                switch (pParam->iHatParam)
+                {
+                    case MCCDAQHAT_C0:
+                    case MCCDAQHAT_C1:
+                    case MCCDAQHAT_C2:
+                    case MCCDAQHAT_C3:
                     {
-                        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC134: invalid thermo couple type\n");
-                        return asynError;
+                        uint8_t byChannel(static_cast<uint8_t>(pParam->iHatParam - MCCDAQHAT_C0));
+                        if (busCall(mcc134_a_in_read, pParam->byAddress, byChannel, OPTS_DEFAULT, pdValue) != RESULT_SUCCESS)
+                        {
+                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::readFloat64 - MCC134: cannot read channel value\n");
+                            iResult = asynError;
+                        }
+                        iResult = setDoubleParam(pasynUser->reason, *pdValue);
+                        break;
                     }
-                    if (mcc134_tc_type_write(pParam->byAddress, static_cast<uint8_t>(pParam->iHatParam - MCCDAQHAT_TCTYPE0),
-                                             static_cast<uint8_t>(iValue)) != RESULT_SUCCESS)
+                    case MCCDAQHAT_CJC0: // float, cold junction compensation
+                    case MCCDAQHAT_CJC1:
+                    case MCCDAQHAT_CJC2:
+                    case MCCDAQHAT_CJC3:
                     {
-                        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC134: cannot write thermo couple type\n");
-                        iResult = asynError;
+                        uint8_t byChannel(static_cast<uint8_t>(pParam->iHatParam - MCCDAQHAT_CJC0));
+                        if (busCall(mcc134_cjc_read, pParam->byAddress, byChannel, pdValue) != RESULT_SUCCESS)
+                        {
+                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::readFloat64 - MCC134: cannot read cold junction channel value\n");
+                            iResult = asynError;
+                        }
+                        iResult = setDoubleParam(pasynUser->reason, *pdValue);
+                        break;
                     }
-                    break;
-                default:
-                    asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC134 read only parameter\n");
-                    iResult = asynError; // not writeable
-                    break;
-            }
-            break;
-        } // case HAT_ID_MCC_134
-        case HAT_ID_MCC_152: // 2-ch 12 bit analog output, 8-ch digital I/O
-            switch (pParam->iHatParam)
-            {
-                case MCCDAQHAT_DO:
+                    default:
+                        break;
+                }
+                break;
+            case HAT_ID_MCC_152: // 2-ch 12 bit analog output, 8-ch digital I/O
+                break; // nothing to do here
+            case HAT_ID_MCC_172: // 2-ch 24 bit differential analog input
+                break; // nothing to do here
+            case 0: // shared SPI bus
+                if (pParam->iHatParam == MCCDAQHAT_BUS_LOAD || pParam->iHatParam == MCCDAQHAT_BUS_LIMIT)
                 {
-                    if (iValue < 0 || iValue > 255)
-                    {
-                        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC152: invalid output value\n");
-                        return asynError;
-                    }
-                    if (mcc152_dio_output_write_port(pParam->byAddress, static_cast<uint8_t>(iValue)) != RESULT_SUCCESS)
+                    *pdValue = 100. * (pParam->iHatParam == MCCDAQHAT_BUS_LOAD ? mccdaqhatsBus::getLoad() : mccdaqhatsBus::getLimit());
+                    iResult = setDoubleParam(pasynUser->reason, *pdValue);
+                }
+                else if (pParam->iHatParam >= MCCDAQHAT_BUS_WAIT_STREAM && pParam->iHatParam <= MCCDAQHAT_BUS_WAIT_CONFIG)
+                {
+                    struct mccdaqhatsBus::statistics stat;
+                    if (mccdaqhatsBus::getStatistics(static_cast<mccdaqhatsBus::Priority>(pParam->iHatParam - MCCDAQHAT_BUS_WAIT_STREAM), &stat))
                     {
-                        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC152: cannot write digital outputs\n");
-                        return asynError;
+                        *pdValue = 1e3 * stat.dWaitMax;
+                        iResult = setDoubleParam(pasynUser->reason, *pdValue);
                     }
-                    break;
-                }
-#define HANDLE_MCC152_CONF(param,item,errmsg)       \
-                case MCCDAQHAT_##param:             \
-                {                                   \
-                    if (iValue < 0 || iValue > 255) \
-                    {                               \
-                        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC152: invalid output value\n"); \
-                        return asynError;           \
-                    }                               \
-                    if (mcc152_dio_config_write_port(pParam->byAddress, DIO_##item, static_cast<uint8_t>(iValue)) != RESULT_SUCCESS) \
-                    {                               \
-                        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::readInt32 - MCC152: cannot read " errmsg "\n"); \
-                        return asynError;           \
-                    }                               \
-                    break;                          \
                 }
-                HANDLE_MCC152_CONF(DIR,DIRECTION,"direction")
-                HANDLE_MCC152_CONF(IN_PULL_EN,PULL_ENABLE,"pull-up direction")
-                HANDLE_MCC152_CONF(IN_PULL_CFG,PULL_CONFIG,"pull-up configuration")
-                HANDLE_MCC152_CONF(IN_INV,INPUT_INVERT,"data invertion")
-                HANDLE_MCC152_CONF(IN_LATCH,INPUT_LATCH,"latch configuration")
-                HANDLE_MCC152_CONF(OUT_TYPE,OUTPUT_TYPE,"output configuration")
-#undef HANDLE_MCC152_CONF
-                default:
-                    asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC152 read only parameter\n");
-                    iResult = asynError; // not writeable
-                    break;
-            }
-            break;
-        case HAT_ID_MCC_172: // 2-ch 24 bit differential analog input
+                break;
+            default: // unsupported device
+                break;
+        }
+    }
+    return iResult;
+}
+
+/**
+ * @brief Called when asyn clients call pasynFloat64->write().
+ *        For some parameters, it writes to the hardware and in other cases,
+ *        this will call the base class, which simply stores the value.
+ * @param[in] pasynUser  pasynUser structure that encodes the reason and address.
+ * @param[in] dValue     value to write.
+ * @return asyn result code
+ */
+asynStatus mccdaqhatsCtrl::writeFloat64(asynUser* pasynUser, epicsFloat64 dValue)
+{
+    asynStatus iResult(asynSuccess);
+    struct paramMccDaqHats* pParam(nullptr);
+    bool bPublish(false);
+    if (pasynUser->reason >= 0 && m_mapParameters.count(pasynUser->reason))
+        pParam = m_mapParameters[pasynUser->reason];
+    if (!pParam) // default handler for other asyn parameters
+        goto handleWrite;
+    if (findStreamParam(pParam->iHatParam, nullptr))
+    {
+        // stream processing: applied by the acquisition thread at the next block
+        iResult = checkStreamParam(pasynUser, pParam, dValue);
+        bPublish = true;
+        goto handleWrite;
+    }
+    {
+        switch (pParam->wHatID)
         {
-            uint16_t wStatus(0);
-            uint32_t dwSamplesPerChannel(0);
-            bool bStarted(mcc172_a_in_scan_status(pParam->byAddress, &wStatus, &dwSamplesPerChannel) == RESULT_SUCCESS
-                          && (wStatus & STATUS_RUNNING) != 0);
-            switch (pParam->iHatParam)
+            case HAT_ID_MCC_118: // 8-ch 12 bit single-ended analog input
             {
-                case MCCDAQHAT_START: // enum 0, STOP=0, START=1
-                    if (!iValue)
-                    {
-                        // no data acquisition
-                        if (mcc172_a_in_scan_stop(pParam->byAddress) != RESULT_SUCCESS && bStarted)
+                bool bStarted(IsScanActive(pParam->byAddress) || IsScanBusy(pParam->byAddress));
+                switch (pParam->iHatParam)
+                {
+                    case MCCDAQHAT_RATE: // float 100000, <=0: external clock with frequency hint
+                        if (!isfinite(dValue) || fabs(dValue) > 100000.)
                         {
-                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - cannot stop MCC172\n");
+                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeFloat64 - MCC118 invalid clock rate\n");
                             iResult = asynError;
                         }
-                        mcc172_a_in_scan_cleanup(pParam->byAddress);
-                    }
-                    else if (!bStarted && m_abyChannelMask[pParam->byAddress])
-                    {
-                        // prepare data acquisition
-                        int iAsynRate(m_mapDev2Asyn[GetMapHash(pParam->byAddress, MCCDAQHAT_RATE)]);
-                        double dRate(static_cast<double>(epicsNAN)), dTmp(dRate);
-                        uint8_t byMask(m_abyChannelMask[pParam->byAddress]), byTmp(0);
-                        epicsInt32 iTrig(GetDevParamInt(pParam->byAddress, MCCDAQHAT_TRIG, static_cast<epicsInt32>(-1)));
-                        epicsInt32 iClkSrc(GetDevParamInt(pParam->byAddress, MCCDAQHAT_CLKSRC, static_cast<epicsInt32>(-1)));
-                        uint32_t dwOptions(OPTS_CONTINUOUS);
-
-                        if (iTrig < 0 || iClkSrc < 0 || !byMask)
-                        {
-                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - start MCC172: invalid channel mask, trigger, clock source configured\n");
-                            return asynError;
-                        }
-                        if (getDoubleParam(iAsynRate, &dRate) != asynSuccess)
-                            dRate = static_cast<double>(epicsNAN);
-                        if (!isfinite(dRate) || fabs(dRate) < 1. || floor(fabs(dRate)) > 51200.)
-                        {
-                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - start MCC172: invalid rate configured\n");
-                            return asynError;
-                        }
-                        mcc172_a_in_scan_stop(pParam->byAddress);
-                        mcc172_a_in_scan_cleanup(pParam->byAddress);
-                        if (iTrig > 0)
-                            dwOptions |= OPTS_EXTTRIGGER;
-                        if (mcc172_a_in_clock_config_write(pParam->byAddress, static_cast<uint8_t>(iClkSrc), dRate) != RESULT_SUCCESS)
+                        else if (bStarted) // restart with new configuration
+                            iResult = QueueScan(pasynUser, pParam->byAddress, true, MCCDAQHAT_RATE, dValue);
+                        break;
+                    default:
+                        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeFloat64 - MCC118 read only parameter\n");
+                        iResult = asynError; // not writeable
+                        break;
+                }
+                break;
+            } // case HAT_ID_MCC_118
+            case HAT_ID_MCC_128: // 4-ch differential / 8-ch single-ended 16 bit analog input
+            {
+                bool bStarted(IsScanActive(pParam->byAddress) || IsScanBusy(pParam->byAddress));
+                switch (pParam->iHatParam)
+                {
+                    case MCCDAQHAT_RATE: // float 100000, <=0: external clock with frequency hint
+                        if (!isfinite(dValue) || fabs(dValue) > 100000.)
                         {
-                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - start MCC172: invalid clock source or rate configured\n");
-                            return asynError;
+                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeFloat64 - MCC128 invalid clock rate\n");
+                            iResult = asynError;
                         }
-                        if (mcc172_a_in_clock_config_read(pParam->byAddress, &byTmp, &dTmp, &byTmp) != RESULT_SUCCESS)
+                        else if (bStarted) // restart with new configuration
+                            iResult = QueueScan(pasynUser, pParam->byAddress, true, MCCDAQHAT_RATE, dValue);
+                        break;
+                    default:
+                        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeFloat64 - MCC128 read only parameter\n");
+                        iResult = asynError; // not writeable
+                        break;
+                }
+                break;
+            } // case HAT_ID_MCC_128
+            case HAT_ID_MCC_134: // 4-ch 24 bit thermocouple input
+                switch (pParam->iHatParam)
+                {
+                    case MCCDAQHAT_RATE: // uint8 1, update interval in seconds, 1…255
+                        if (isfinite(dValue) && dValue >= 1. && dValue < 256)
+                            return writeInt32(pasynUser, static_cast<epicsInt32>(dValue));
+                        else
                         {
-                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - start MCC172: cannot read actual rate\n");
-                            return asynError;
+                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeFloat64 - MCC134 invalid update interval\n");
+                            iResult = asynError;
                         }
-                        if (fabs(dTmp - dRate) > 0.)
+                        break;
+                    default:
+                        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeFloat64 - MCC134 read only parameter\n");
+                        iResult = asynError; // not writeable
+                        break;
+                }
+                break;
+            case HAT_ID_MCC_152: // 2-ch 12 bit analog output, 8-ch digital I/O
+                switch (pParam->iHatParam)
+                {
+                    case MCCDAQHAT_C0:
+                    case MCCDAQHAT_C1:
+                        if (!isfinite(dValue) || dValue < 0. || dValue > 5.)
                         {
-                            setDoubleParam(iAsynRate, dRate = dTmp);
-                            callParamCallbacks();
+                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeFloat64 - MCC152 invalid output value\n");
+                            iResult = asynError; // not writeable
                         }
-                        if (mcc172_trigger_config(pParam->byAddress, static_cast<uint8_t>(iClkSrc), static_cast<uint8_t>(iTrig - 1)) != RESULT_SUCCESS)
+                        else if (busCall(mcc152_a_out_write, pParam->byAddress, static_cast<uint8_t>(pParam->iHatParam - MCCDAQHAT_C0), OPTS_DEFAULT, dValue) != RESULT_SUCCESS)
                         {
-                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - start MCC172: invalid clock source or trigger mode\n");
-                            return asynError;
+                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeFloat64 - MCC152 cannot write output value\n");
+                            iResult = asynError; // not writeable
                         }
-                        // start data acquisition
-                        if (mcc172_a_in_scan_start(pParam->byAddress, m_abyChannelMask[pParam->byAddress], 0, dwOptions) != RESULT_SUCCESS)
+                        break;
+                    default:
+                        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeFloat64 - MCC134 read only parameter\n");
+                        iResult = asynError; // not writeable
+                        break;
+                }
+                break;
+            case HAT_ID_MCC_172: // 2-ch 24 bit differential analog input
+                if (pParam->iHatParam == MCCDAQHAT_RATE // restart with new configuration
+                    && (IsScanActive(pParam->byAddress) || IsScanBusy(pParam->byAddress)))
+                    iResult = QueueScan(pasynUser, pParam->byAddress, true, MCCDAQHAT_RATE, dValue);
+                break;
+            case 0: // shared SPI bus
+                switch (pParam->iHatParam)
+                {
+                    case MCCDAQHAT_BUS_LIMIT: // float 90, allowed load in %
+                        if (!isfinite(dValue) || dValue <= 0. || dValue > 1000.)
                         {
-                            mcc172_a_in_scan_stop(pParam->byAddress);
-                            mcc172_a_in_scan_cleanup(pParam->byAddress);
+                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeFloat64 - invalid bus limit\n");
                             iResult = asynError;
                         }
-                    }
-                    break;
-                case MCCDAQHAT_MASK: // uint8 0xFF, 1…3 channel selection bit mask
-                    if (bStarted)
-                    {
-                        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC172 is active\n");
-                        return asynError;
-                    }
-                    if (iValue > 0 && iValue < 4)
-                        m_abyChannelMask[pParam->byAddress] = static_cast<uint8_t>(iValue);
-                    else
-                    {
-                        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC172 channel mask\n");
-                        iResult = asynError;
-                    }
-                    break;
-                case MCCDAQHAT_RATE: // float 100000, <=0: external clock with frequency hint
-                    return writeFloat64(pasynUser, static_cast<epicsFloat64>(iValue));
-                case MCCDAQHAT_TRIG: // enum 0, none=0, rising=1, falling=2, high=3, low=4
-                    if (bStarted)
-                    {
-                        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC172 is active\n");
-                        return asynError;
-                    }
-                    if (iValue < 0 || iValue > 4)
-                    {
-                        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC172 invalid trigger mode\n");
-                        iResult = asynError;
-                    }
-                    break;
-                case MCCDAQHAT_CLKSRC: // enum 0, local=0, master=1, slave=2
-                    if (bStarted)
-                    {
-                        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC172 is active\n");
-                        return asynError;
-                    }
-                    if (iValue < 0 || iValue > 2)
-                    {
-                        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC172 invalid clock source\n");
-                        return asynError;
-                    }
-                    if (iValue != 1) // disable clock output, real trigger will be configured later
-                        mcc172_trigger_config(pParam->byAddress, static_cast<uint8_t>(iValue), TRIG_RISING_EDGE);
-                    break;
-                case MCCDAQHAT_IEPE0: // uint8 , 0=OFF, 1=ON
-                case MCCDAQHAT_IEPE1:
-                    if (iValue < 0 || iValue > 1)
-                    {
-                        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC172 invalid IEPE config\n");
-                        return asynError;
-                    }
-                    if (mcc172_iepe_config_write(pParam->byAddress,
-                                                 static_cast<uint8_t>(pParam->iHatParam - MCCDAQHAT_IEPE0),
-                                                 static_cast<uint8_t>(iValue)) != RESULT_SUCCESS)
-                    {
-                        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC172 cannot write IEPE config\n");
-                        return asynError;
-                    }
-                    break;
-                default:
-                    asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeInt32 - MCC172 read only parameter\n");
-                    iResult = asynError; // not writeable
-                    break;
-            }
-            break;
-        } // case HAT_ID_MCC_172
-        default: // unsupported device
-            iResult = asynError; // not writeable
-            break;
+                        else
+                            mccdaqhatsBus::setLimit(0.01 * dValue);
+                        break;
+                    default:
+                        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeFloat64 - bus read only parameter\n");
+                        iResult = asynError; // not writeable
+                        break;
+                }
+                break;
+            default: // unsupported device
+                iResult = asynError; // not writeable
+                break;
+        }
+    }
+handleWrite:
+    if (iResult == asynSuccess)
+        iResult = asynPortDriver::writeFloat64(pasynUser, dValue);
+    if (iResult == asynSuccess && bPublish)
+        PublishConfig(pParam->byAddress);
+    return iResult;
+}
+
+/**
+ * @brief Called when asyn clients call pasynFloat64Array->read().
+ *        For some parameters, it reads the hardware and in other cases,
+ *        this will call the base class, which simply returns an error.
+ * @param[in]  pasynUser    pasynUser structure that encodes the reason and address.
+ * @param[out] pdValue      address of buffer for read values.
+ * @param[in]  uElements    number of elements to read.
+ * @param[out] puIn         elements actually read.
+ * @return asyn result code
+ */
+asynStatus mccdaqhatsCtrl::readFloat64Array(asynUser *pasynUser, epicsFloat64* pdValue, size_t uElements, size_t* puIn)
+{
+    asynStatus iResult(asynError);
+    struct paramMccDaqHats* pParam(nullptr);
+    if (pasynUser->reason >= 0 && m_mapParameters.count(pasynUser->reason))
+        pParam = m_mapParameters[pasynUser->reason];
+    if (!pParam) // default handler for other asyn parameters
+        iResult = asynPortDriver::readFloat64Array(pasynUser, pdValue, uElements, puIn);
+    else if (pParam->iHatParam >= MCCDAQHAT_HIST_C0 && pParam->iHatParam <= MCCDAQHAT_HIST_C7)
+    {
+        // linearize the latest samples of the history on request only
+        size_t uCount(0);
+        const double* pdHist(nullptr);
+        if (pParam->byAddress < m_apBoards.size() && m_apBoards[pParam->byAddress])
+            pdHist = m_apBoards[pParam->byAddress]->aChannel[pParam->iHatParam - MCCDAQHAT_HIST_C0].history.data(&uCount);
+        if (pdHist)
+        {
+            if (uElements > uCount)
+                uElements = uCount;
+            memcpy(pdValue, &pdHist[uCount - uElements], uElements * sizeof(*pdValue));
+            *puIn = uElements;
+            iResult = asynSuccess;
+        }
+    }
+    else if (!pParam->adCache.empty())
+    {
+        if (uElements > pParam->adCache.size())
+            uElements = pParam->adCache.size();
+        memmove(pdValue, &pParam->adCache[0], uElements * sizeof(*pdValue));
+        *puIn = uElements;
+        iResult = asynSuccess;
+    }
+    return iResult;
+}
+
+/**
+ * @brief Called when asyn clients call pasynFloat64Array->write().
+ *        Only the conversion coefficients are writeable, they are checked against the
+ *        current conversion type and applied by the acquisition thread at the next block.
+ * @param[in] pasynUser  pasynUser structure that encodes the reason and address.
+ * @param[in] pdValue    values to write.
+ * @param[in] uElements  number of values.
+ * @return asyn result code
+ */
+asynStatus mccdaqhatsCtrl::writeFloat64Array(asynUser* pasynUser, epicsFloat64* pdValue, size_t uElements)
+{
+    struct paramMccDaqHats* pParam(nullptr);
+    std::vector<double> adCoef;
+    const char* szError(nullptr);
+    if (pasynUser->reason >= 0 && m_mapParameters.count(pasynUser->reason))
+        pParam = m_mapParameters[pasynUser->reason];
+    if (!pParam) // default handler for other asyn parameters
+        return asynPortDriver::writeFloat64Array(pasynUser, pdValue, uElements);
+    if (pParam->iHatParam < MCCDAQHAT_EU_COEF0 || pParam->iHatParam > MCCDAQHAT_EU_COEF7)
+    {
+        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeFloat64Array - read only parameter\n");
+        return asynError;
+    }
+    if (pdValue && uElements)
+        adCoef.assign(pdValue, pdValue + uElements);
+    szError = mccdaqhatsConversion::check(GetDevParamInt(pParam->byAddress, MCCDAQHAT_EU_MODE0 + (pParam->iHatParam - MCCDAQHAT_EU_COEF0), 0), adCoef);
+    if (!szError && adCoef.size() > 1024)
+        szError = "too many coefficients";
+    if (szError)
+    {
+        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeFloat64Array - %s\n", szError);
+        return asynError;
+    }
+    std::swap(pParam->adCache, adCoef);
+    PublishConfig(pParam->byAddress);
+    if (!pParam->adCache.empty())
+        doCallbacksFloat64Array(&pParam->adCache[0], pParam->adCache.size(), pParam->iAsynReason, 0);
+    return asynSuccess;
+}
+
+/**
+ * @brief mccdaqhatsCtrl::writeOctet is an asyn interface function;
+ *        only the expressions of virtual channels are writeable, they are compiled for a check
+ * @param[in]  pasynUser  pasynUser structure that encodes the reason and address.
+ * @param[in]  szValue    new expression
+ * @param[in]  uMaxChars  number of characters
+ * @param[out] puActual   number of used characters
+ * @return asyn result code
+ */
+asynStatus mccdaqhatsCtrl::writeOctet(asynUser* pasynUser, const char* szValue, size_t uMaxChars, size_t* puActual)
+{
+    struct paramMccDaqHats* pParam(nullptr);
+    mccdaqhatsExpression expression;
+    std::string sValue, sError;
+    if (pasynUser->reason >= 0 && m_mapParameters.count(pasynUser->reason))
+        pParam = m_mapParameters[pasynUser->reason];
+    if (!pParam) // default handler for other asyn parameters
+        return asynPortDriver::writeOctet(pasynUser, szValue, uMaxChars, puActual);
+    if (pParam->iHatParam < MCCDAQHAT_VIRT_EXPR0 || pParam->iHatParam > MCCDAQHAT_VIRT_EXPR3)
+    {
+        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeOctet - read only parameter\n");
+        return asynError;
+    }
+    if (szValue)
+        sValue.assign(szValue, strnlen(szValue, uMaxChars));
+    if (!expression.compile(sValue, &sError))
+    {
+        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeOctet - %s: %s\n", sError.c_str(), sValue.c_str());
+        return asynError;
+    }
+    if (puActual)
+        *puActual = uMaxChars;
+    setStringParam(pParam->iAsynReason, sValue);
+    PublishConfig(pParam->byAddress);
+    callParamCallbacks();
+    return asynSuccess;
+}
+
+/**
+ * @brief read the channels of a polled module (MCC134) at its update interval and publish
+ *        the latest values with deadband; it is called by the acquisition thread
+ * @param[in] pBoard   runtime state of this module
+ * @param[in] pConfig  current configuration snapshot of this module
+ */
+void mccdaqhatsCtrl::PollBoard(struct boardMccDaqHats* pBoard, const struct configMccDaqHats* pConfig)
+{
+    epicsUInt64 qwNow(epicsMonotonicGet());
+    int aiTcType[4] = { 0, 0, 0, 0 };
+    epicsInt32 iInterval(1);
+    bool bChange(false);
+    if (qwNow < pBoard->qwPollNext)
+        return;
+    lock();
+    for (int i = 0; i < 4; ++i)
+        if (pConfig->aStage[i].pLast && (!pConfig->bLazy || HasInterruptUsers(pConfig->aStage[i].pLast)))
+            aiTcType[i] = GetDevParamInt(pBoard->byAddress, MCCDAQHAT_TCTYPE0 + i, 0);
+    // the module updates its values with this interval only
+    iInterval = GetDevParamInt(pBoard->byAddress, MCCDAQHAT_RATE, 1);
+    pBoard->qwPollNext = qwNow + static_cast<epicsUInt64>(iInterval > 0 ? iInterval : 1) * 1000000000ull;
+    unlock();
+
+    for (int i = 0; i < 4; ++i)
+    {
+        struct channelMccDaqHats& ch(pBoard->aChannel[i]);
+        ch.bLast = false;
+        if (!aiTcType[i])
+            continue; // disabled channel
+        ch.dLast = static_cast<double>(epicsNAN);
+        ch.bLast = (busCall(mcc134_a_in_read, pBoard->byAddress, static_cast<uint8_t>(i), OPTS_DEFAULT, &ch.dLast) == RESULT_SUCCESS);
+    }
+
+    lock();
+    for (int i = 0; i < 4; ++i)
+    {
+        struct channelMccDaqHats& ch(pBoard->aChannel[i]);
+        const struct configMccDaqHats::stageConfigMccDaqHats& st(pConfig->aStage[i]);
+        if (!st.pLast)
+            continue;
+        ch.deadband.configure(st.dLastDb, st.iLastDbMode);
+        if (ch.bLast && ch.deadband.check(ch.dLast))
+        {
+            setDoubleParam(st.pLast->iAsynReason, ch.dLast);
+            bChange = true;
+        }
+    }
+    if (bChange)
+        callParamCallbacks();
+    unlock();
+}
+
+/**
+ * @brief publish the collected scans of all channels as single waveform together with its shape;
+ *        this is called with locked port
+ * @param[in] pBoard   runtime state of this module
+ * @param[in] pConfig  current configuration snapshot of this module
+ */
+void mccdaqhatsCtrl::PublishBlock(struct boardMccDaqHats* pBoard, const struct configMccDaqHats* pConfig)
+{
+    struct paramMccDaqHats* p(pConfig->pBlock);
+    size_t uChannels(pConfig->byChannels), uScans(uChannels ? pBoard->adBlock.size() / uChannels : 0);
+    if (uChannels && pConfig->iBlockMode == 2)
+    {
+        // channel-major: all samples of the 1st channel, followed by the 2nd channel, ...
+        p->adCache.resize(pBoard->adBlock.size());
+        for (size_t j = 0; j < uChannels; ++j)
+            mccdaqhatsDsp::deinterleave(&pBoard->adBlock[0], uChannels, j, uScans, &p->adCache[j * uScans]);
+        pBoard->adBlock.clear();
+    }
+    else
+    {
+        std::swap(p->adCache, pBoard->adBlock);
+        pBoard->adBlock.clear();
+    }
+    if ((p = pConfig->pBlockShape) != nullptr)
+    {
+        p->adCache.resize(2);
+        p->adCache[0] = static_cast<double>(uChannels);
+        p->adCache[1] = static_cast<double>(uScans);
+        for (int j = 0; j < 8; ++j)
+            if (pConfig->abyOffset[j] < pConfig->byChannels)
+                p->adCache.push_back(static_cast<double>(j));
+        doCallbacksFloat64Array(&p->adCache[0], p->adCache.size(), p->iAsynReason, 0);
+    }
+    p = pConfig->pBlock;
+    if (!p->adCache.empty())
+        doCallbacksFloat64Array(&p->adCache[0], p->adCache.size(), p->iAsynReason, 0);
+}
+
+/**
+ * @brief publish new waveform data of a block, or concatenate it for a throttled publication;
+ *        this is called with locked port
+ * @param[in]     pParam     waveform parameter
+ * @param[in,out] adNew      data of current block (swapped with the cache)
+ * @param[in,out] adPending  concatenated data of throttled blocks
+ * @param[in]     bNow       true: publish now, false: concatenate only
+ * @param[in]     uMax       maximum length of concatenated data, older samples are dropped
+ */
+void mccdaqhatsCtrl::PublishArray(struct paramMccDaqHats* pParam, std::vector<double>& adNew, std::vector<double>& adPending,
+                                  bool bNow, size_t uMax)
+{
+    if (!adPending.empty() || !bNow)
+    {
+        adPending.insert(adPending.end(), adNew.begin(), adNew.end());
+        if (adPending.size() > uMax)
+            adPending.erase(adPending.begin(), adPending.end() - static_cast<std::ptrdiff_t>(uMax));
+        adNew.clear();
+        if (!bNow || adPending.empty())
+            return;
+        std::swap(pParam->adCache, adPending);
+        adPending.clear();
+    }
+    else if (!adNew.empty())
+        std::swap(pParam->adCache, adNew);
+    else
+        return;
+    doCallbacksFloat64Array(&pParam->adCache[0], pParam->adCache.size(), pParam->iAsynReason, 0);
+}
+
+/**
+ * @brief mark the asyn reasons of an interrupt list, which have users
+ * @param[in]     pInterruptPvt  interrupt list of an interface
+ * @param[in,out] abUsers        flags for every asyn reason
+ * @return true on success, false if the list is not accessible
+ */
+template<typename T> static bool markInterruptUsers(void* pInterruptPvt, std::vector<bool>& abUsers)
+{
+    ELLLIST* pList(nullptr);
+    if (!pInterruptPvt || pasynManager->interruptStart(pInterruptPvt, &pList) != asynSuccess)
+        return false;
+    for (interruptNode* pNode = reinterpret_cast<interruptNode*>(ellFirst(pList)); pNode;
+         pNode = reinterpret_cast<interruptNode*>(ellNext(&pNode->node)))
+    {
+        // every interface has its own interrupt structure
+        const T* pInterrupt(reinterpret_cast<const T*>(pNode->drvPvt));
+        if (pInterrupt && pInterrupt->pasynUser && pInterrupt->pasynUser->reason >= 0 &&
+            static_cast<size_t>(pInterrupt->pasynUser->reason) < abUsers.size())
+            abUsers[static_cast<size_t>(pInterrupt->pasynUser->reason)] = true;
     }
+    pasynManager->interruptEnd(pInterruptPvt);
+    return true;
+}
+
+/**
+ * @brief collect the asyn reasons with interrupt users (e.g. records with SCAN="I/O Intr")
+ *        of all interrupt lists; this is called with locked port by the acquisition thread
+ *        every 0.1 seconds
+ */
+void mccdaqhatsCtrl::UpdateInterruptUsers()
+{
+    int iParams(0);
+    getNumParams(&iParams);
+    m_abInterruptUsers.assign(static_cast<size_t>(iParams > 0 ? iParams : 0), false);
+    if (!markInterruptUsers<asynInt32Interrupt>(asynStdInterfaces.int32InterruptPvt, m_abInterruptUsers) ||
+        !markInterruptUsers<asynFloat64Interrupt>(asynStdInterfaces.float64InterruptPvt, m_abInterruptUsers) ||
+        !markInterruptUsers<asynFloat64ArrayInterrupt>(asynStdInterfaces.float64ArrayInterruptPvt, m_abInterruptUsers) ||
+        !markInterruptUsers<asynGenericPointerInterrupt>(asynStdInterfaces.genericPointerInterruptPvt, m_abInterruptUsers))
+        m_abInterruptUsers.assign(m_abInterruptUsers.size(), true); // unknown: assume users
+}
+
+/**
+ * @brief check, if a parameter had interrupt users at the last \ref UpdateInterruptUsers
+ * @param[in] pParam  parameter or nullptr
+ * @return true, if there is at least one interrupt user
+ */
+bool mccdaqhatsCtrl::HasInterruptUsers(const struct paramMccDaqHats* pParam) const
+{
+    if (!pParam || pParam->iAsynReason < 0)
+        return false;
+    return static_cast<size_t>(pParam->iAsynReason) >= m_abInterruptUsers.size() ||
+           m_abInterruptUsers[static_cast<size_t>(pParam->iAsynReason)];
+}
+
+/**
+ * @brief get index for "m_mapDev2Asyn" mapping
+ * @param[in] byAddress device address (0…MAX_NUMBER_HATS-1)
+ * @param[in] iParam    parameter index (enum \ref ParameterId)
+ * @return index for "m_mapDev2Asyn" mapping
+ */
+int mccdaqhatsCtrl::GetMapHash(uint8_t byAddress, int iParam)
+{
+    return static_cast<int>(MAX_NUMBER_HATS * iParam + byAddress);
+}
+
+/**
+ * @brief parse a list of module addresses, e.g. "0,1", "0 2 3" or "2-4"
+ * @param[in]  szList        list of addresses, empty or nullptr for all addresses
+ * @param[out] pdwAddresses  bit mask of selected addresses (bit0=address 0)
+ * @return true on success, false on syntax error
+ */
+bool mccdaqhatsCtrl::ParseAddressList(const char* szList, epicsUInt32* pdwAddresses)
+{
+    *pdwAddresses = 0;
+    if (!szList || !*szList)
+    {
+        *pdwAddresses = (1U << MAX_NUMBER_HATS) - 1;
+        return true;
+    }
+    while (*szList)
+    {
+        char* pEnd(nullptr);
+        long lFirst, lLast;
+        if (*szList == ' ' || *szList == ',' || *szList == ';')
+        {
+            ++szList;
+            continue;
+        }
+        lFirst = lLast = strtol(szList, &pEnd, 0);
+        if (pEnd == szList)
+            return false;
+        szList = pEnd;
+        if (*szList == '-')
+        {
+            ++szList;
+            lLast = strtol(szList, &pEnd, 0);
+            if (pEnd == szList)
+                return false;
+            szList = pEnd;
+        }
+        if (lFirst < 0 || lLast >= MAX_NUMBER_HATS || lFirst > lLast)
+            return false;
+        for (long i = lFirst; i <= lLast; ++i)
+            *pdwAddresses |= 1U << i;
+    }
+    return *pdwAddresses != 0;
+}
+
+/**
+ * @brief admission control on scan start: check the predicted load of all running scans,
+ *        refuse or warn, if the allowed load would be exceeded
+ * @param[in] pasynUser  pasynUser structure for messages
+ * @param[in] byAddress  device address (0…MAX_NUMBER_HATS-1)
+ * @param[in] wHatID     HAT type
+ * @param[in] byMask     channel selection bit mask
+ * @param[in] dRate      sample rate per channel
+ * @return asyn result code, asynError for refused scan
+ */
+asynStatus mccdaqhatsCtrl::AdmitScan(asynUser* pasynUser, uint8_t byAddress, uint16_t wHatID, uint8_t byMask, double dRate)
+{
+    double dTotal(0.);
+    int iChannels(0);
+    for (int i = 0; i < 8; ++i)
+        if ((byMask >> i) & 1)
+            ++iChannels;
+    if (mccdaqhatsBus::admit(byAddress, wHatID, iChannels * dRate, &dTotal))
+        return asynSuccess;
+    if (mccdaqhatsBus::getRefuse())
+    {
+        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::AdmitScan - start A%u refused: predicted load %.1f%% > %.1f%%\n",
+                  byAddress, 100. * dTotal, 100. * mccdaqhatsBus::getLimit());
+        return asynError;
+    }
+    asynPrint(pasynUser, ASYN_TRACE_WARNING, "mccdaqhats::AdmitScan - start A%u: predicted load %.1f%% > %.1f%%, overruns possible\n",
+              byAddress, 100. * dTotal, 100. * mccdaqhatsBus::getLimit());
+    return asynSuccess;
+}
+
+/**
+ * @brief get acquisition state of a module without bus access
+ * @param[in] byAddress  device address (0…MAX_NUMBER_HATS-1)
+ * @return acquisition state (enum \ref ScanState)
+ */
+int mccdaqhatsCtrl::GetScanState(uint8_t byAddress)
+{
+    if (byAddress >= m_apBoards.size() || !m_apBoards[byAddress])
+        return SCAN_IDLE;
+    return epicsAtomicGetIntT(&m_apBoards[byAddress]->iScanState);
+}
+
+/**
+ * @brief check, if the acquisition of a module is started (armed or running)
+ * @param[in] byAddress  device address (0…MAX_NUMBER_HATS-1)
+ * @return true, if started
+ */
+bool mccdaqhatsCtrl::IsScanActive(uint8_t byAddress)
+{
+    int iState(GetScanState(byAddress));
+    return iState == SCAN_ARMED || iState == SCAN_RUNNING;
+}
+
+/**
+ * @brief change acquisition state of a module and publish it with "START" and "STATE"
+ * @param[in] byAddress  device address (0…MAX_NUMBER_HATS-1)
+ * @param[in] iState     new acquisition state (enum \ref ScanState)
+ * @param[in] iExpected  change only from this state, -1 for any state
+ * @return true, if the state was changed
+ */
+bool mccdaqhatsCtrl::SetScanState(uint8_t byAddress, int iState, int iExpected)
+{
+    int iAsynStart(-1), iAsynState(-1);
+    if (byAddress >= m_apBoards.size() || !m_apBoards[byAddress])
+        return false;
+    if (iExpected < 0)
+        epicsAtomicSetIntT(&m_apBoards[byAddress]->iScanState, iState);
+    else if (epicsAtomicCmpAndSwapIntT(&m_apBoards[byAddress]->iScanState, iExpected, iState) != iExpected)
+        return false;
+    lock();
+    if (m_mapDev2Asyn.count(GetMapHash(byAddress, MCCDAQHAT_START)))
+        iAsynStart = m_mapDev2Asyn[GetMapHash(byAddress, MCCDAQHAT_START)];
+    if (m_mapDev2Asyn.count(GetMapHash(byAddress, MCCDAQHAT_STATE)))
+        iAsynState = m_mapDev2Asyn[GetMapHash(byAddress, MCCDAQHAT_STATE)];
+    if (iAsynStart >= 0)
+        setIntegerParam(iAsynStart, (iState == SCAN_ARMED || iState == SCAN_RUNNING) ? 1 : 0);
+    if (iAsynState >= 0)
+        setIntegerParam(iAsynState, iState);
+    callParamCallbacks();
+    unlock();
+    return true;
+}
 
-handleWrite:
-    if (iResult == asynSuccess)
-        iResult = asynPortDriver::writeInt32(pasynUser, iValue);
-    return iResult;
+/**
+ * @brief check, if start/stop commands of a module are queued or executing
+ * @param[in] byAddress  device address (0…MAX_NUMBER_HATS-1)
+ * @return true, if busy
+ */
+bool mccdaqhatsCtrl::IsScanBusy(uint8_t byAddress)
+{
+    if (byAddress >= m_apBoards.size() || !m_apBoards[byAddress])
+        return false;
+    return epicsAtomicGetIntT(&m_apBoards[byAddress]->iBusy) > 0;
 }
 
 /**
- * @brief Called when asyn clients call pasynFloat64->read().
- *        For some parameters, it reads the hardware and in other cases,
- *        this will call the base class, which simply returns the stored value.
- * @param[in]  pasynUser  pasynUser structure that encodes the reason and address.
- * @param[out] pdValue    address of the value to read.
+ * @brief queue a start/stop command for the board thread of a module;
+ *        this is called with locked port: the configuration is checked and captured here,
+ *        the result is published later with "START", "STATE" and "BUSY"
+ * @param[in] pasynUser  pasynUser structure for messages
+ * @param[in] byAddress  device address (0…MAX_NUMBER_HATS-1)
+ * @param[in] bStart     true=start acquisition, false=stop acquisition
+ * @param[in] iParam     -1 or changed parameter (enum \ref ParameterId) for a restart with new configuration
+ * @param[in] dValue     new value of changed parameter, which is not stored yet
  * @return asyn result code
  */
-asynStatus mccdaqhatsCtrl::readFloat64(asynUser* pasynUser, epicsFloat64* pdValue)
+asynStatus mccdaqhatsCtrl::QueueScan(asynUser* pasynUser, uint8_t byAddress, bool bStart, int iParam, double dValue)
 {
-    asynStatus iResult(asynError);
-    struct paramMccDaqHats* pParam(nullptr);
-    if (pasynUser->reason >= 0 && m_mapParameters.count(pasynUser->reason))
-        pParam = m_mapParameters[pasynUser->reason];
-    iResult = asynPortDriver::readFloat64(pasynUser, pdValue); // default handler: read cache
-    if (pParam)
+    struct boardMccDaqHats* pBoard(byAddress < m_apBoards.size() ? m_apBoards[byAddress] : nullptr);
+    struct commandMccDaqHats cmd;
+    uint8_t byChannels(0);
+
+    if (!pBoard || !pBoard->hThread)
     {
-        if (pParam->byAddress >= m_abyChannelMask.size())
-            m_abyChannelMask.resize(static_cast<size_t>(pParam->byAddress) + 1, 0);
-        switch (pParam->wHatID)
+        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::QueueScan - A%u has no board thread\n", byAddress);
+        return asynError;
+    }
+    cmd.bStart   = bStart || iParam >= 0;
+    cmd.bRestart = iParam >= 0;
+    cmd.byMask  = m_abyRequestedMask[byAddress]; // includes queued changes
+    cmd.iTrig   = GetDevParamInt(byAddress, MCCDAQHAT_TRIG, static_cast<epicsInt32>(-1));
+    cmd.iRange  = GetDevParamInt(byAddress, MCCDAQHAT_RANGE, static_cast<epicsInt32>(-1));
+    cmd.iMode   = GetDevParamInt(byAddress, MCCDAQHAT_MODE, static_cast<epicsInt32>(-1));
+    cmd.iClkSrc = GetDevParamInt(byAddress, MCCDAQHAT_CLKSRC, static_cast<epicsInt32>(-1));
+    cmd.dRate   = GetDevParamDouble(byAddress, MCCDAQHAT_RATE, static_cast<double>(epicsNAN));
+    switch (iParam)
+    {
+        case MCCDAQHAT_MASK:  cmd.byMask  = static_cast<epicsUInt8>(dValue); break;
+        case MCCDAQHAT_TRIG:  cmd.iTrig   = static_cast<epicsInt32>(dValue); break;
+        case MCCDAQHAT_RANGE: cmd.iRange  = static_cast<epicsInt32>(dValue); break;
+        case MCCDAQHAT_MODE:  cmd.iMode   = static_cast<epicsInt32>(dValue); break;
+        case MCCDAQHAT_RATE:  cmd.dRate   = dValue; break;
+        default: break;
+    }
+    for (int i = 0; i < 8; ++i)
+        if ((cmd.byMask >> i) & 1)
+            ++byChannels;
+    if (cmd.bStart)
+    {
+        // check cached configuration, hardware is configured by the board thread
+        switch (pBoard->wHatID)
         {
             case HAT_ID_MCC_118: // 8-ch 12 bit single-ended analog input
-                break; // nothing to do here
+                if (cmd.iTrig < 0 || !cmd.byMask)
+                {
+                    asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::QueueScan - start MCC118: invalid channel mask or trigger configured\n");
+                    return asynError;
+                }
+                if (!isfinite(cmd.dRate) || fabs(cmd.dRate) < 1. || floor(byChannels * fabs(cmd.dRate)) > 100000.)
+                {
+                    asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::QueueScan - start MCC118: invalid rate configured\n");
+                    return asynError;
+                }
+                break;
             case HAT_ID_MCC_128: // 4-ch differential / 8-ch single-ended 16 bit analog input
-                break; // nothing to do here
-            case HAT_ID_MCC_134: // 4-ch 24 bit thermocouple input
-                switch (pParam->iHatParam)
+                if (cmd.iTrig < 0 || cmd.iRange < 0 || cmd.iMode < 0 || !cmd.byMask)
                 {
-                    case MCCDAQHAT_C0:
-                    case MCCDAQHAT_C1:
-                    case MCCDAQHAT_C2:
-                    case MCCDAQHAT_C3:
-                    {
-                        uint8_t byChannel(static_cast<uint8_t>(pParam->iHatParam - MCCDAQHAT_C0));
-                        if (mcc134_a_in_read(pParam->byAddress, byChannel, OPTS_DEFAULT, pdValue) != RESULT_SUCCESS)
-                        {
-                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::readFloat64 - MCC134: cannot read channel value\n");
-                            iResult = asynError;
-                        }
-                        iResult = setDoubleParam(pasynUser->reason, *pdValue);
-                        break;
-                    }
-                    case MCCDAQHAT_CJC0: // float, cold junction compensation
-                    case MCCDAQHAT_CJC1:
-                    case MCCDAQHAT_CJC2:
-                    case MCCDAQHAT_CJC3:
-                    {
-                        uint8_t byChannel(static_cast<uint8_t>(pParam->iHatParam - MCCDAQHAT_CJC0));
-                        if (mcc134_cjc_read(pParam->byAddress, byChannel, pdValue) != RESULT_SUCCESS)
-                        {
-                            asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::readFloat64 - MCC134: cannot read cold junction channel value\n");
-                            iResult = asynError;
-                        }
-                        iResult = setDoubleParam(pasynUser->reason, *pdValue);
-                        break;
-                    }
-                    default:
-                        break;
+                    asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::QueueScan - start MCC128: invalid channel mask, trigger, range or mode configured\n");
+                    return asynError;
+                }
+                if (cmd.iMode && cmd.byMask > 0x0F) // 4-channels in differential mode
+                {
+                    asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::QueueScan - start MCC128: invalid channel mask for differential mode\n");
+                    return asynError;
+                }
+                if (!isfinite(cmd.dRate) || fabs(cmd.dRate) < 1. || floor(byChannels * fabs(cmd.dRate)) > 100000.)
+                {
+                    asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::QueueScan - start MCC128: invalid rate configured\n");
+                    return asynError;
                 }
                 break;
-            case HAT_ID_MCC_152: // 2-ch 12 bit analog output, 8-ch digital I/O
-                break; // nothing to do here
             case HAT_ID_MCC_172: // 2-ch 24 bit differential analog input
-                break; // nothing to do here
-            default: // unsupported device
+                if (cmd.iTrig < 0 || cmd.iClkSrc < 0 || !cmd.byMask)
+                {
+                    asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::QueueScan - start MCC172: invalid channel mask, trigger, clock source configured\n");
+                    return asynError;
+                }
+                if (!isfinite(cmd.dRate) || fabs(cmd.dRate) < 1. || floor(fabs(cmd.dRate)) > 51200.)
+                {
+                    asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::QueueScan - start MCC172: invalid rate configured\n");
+                    return asynError;
+                }
                 break;
+            default:
+                return asynError;
         }
     }
-    return iResult;
+
+    // queue command and publish "BUSY" (port is locked)
+    epicsAtomicIncrIntT(&pBoard->iBusy);
+    epicsMutexMustLock(pBoard->hQueueLock);
+    pBoard->aQueue.push_back(cmd);
+    epicsMutexUnlock(pBoard->hQueueLock);
+    epicsEventMustTrigger(pBoard->hQueueEvent);
+    if (m_mapDev2Asyn.count(GetMapHash(byAddress, MCCDAQHAT_BUSY)))
+        setIntegerParam(m_mapDev2Asyn[GetMapHash(byAddress, MCCDAQHAT_BUSY)], 1);
+    m_abyRequestedMask[byAddress] = cmd.byMask; // later commands build on this one
+    return asynSuccess;
 }
 
 /**
- * @brief Called when asyn clients call pasynFloat64->write().
- *        For some parameters, it writes to the hardware and in other cases,
- *        this will call the base class, which simply stores the value.
- * @param[in] pasynUser  pasynUser structure that encodes the reason and address.
- * @param[in] dValue     value to write.
+ * @brief publish a failed start: the module does not scan anymore, release its bus load
+ *        and publish "START"=0 and "STATE"; this is called by the board thread with unlocked port
+ * @param[in] pBoard  runtime state of this module
+ * @param[in] iState  new acquisition state: SCAN_IDLE (nothing was running) or SCAN_STOPPED (a running scan was stopped)
+ * @return asynError
+ */
+asynStatus mccdaqhatsCtrl::AbortScan(struct boardMccDaqHats* pBoard, int iState)
+{
+    mccdaqhatsBus::setBoardLoad(pBoard->byAddress, pBoard->wHatID, 0.);
+    SetScanState(pBoard->byAddress, iState);
+    return asynError;
+}
+
+/**
+ * @brief start data acquisition of a module; this is called by the board thread
+ *        with unlocked port, the SPI bus is taken for every library call only;
+ *        sample rate and bus load are checked before the hardware is touched
+ * @param[in] pBoard    runtime state of this module
+ * @param[in] cmd       configuration captured by "QueueScan"
+ * @param[in] bRestart  true: stop the running scan and restart it with the new configuration,
+ *                      a refused restart keeps the running scan
  * @return asyn result code
  */
-asynStatus mccdaqhatsCtrl::writeFloat64(asynUser* pasynUser, epicsFloat64 dValue)
+asynStatus mccdaqhatsCtrl::StartScan(struct boardMccDaqHats* pBoard, const struct commandMccDaqHats& cmd, bool bRestart)
 {
-    asynStatus iResult(asynSuccess);
-    struct paramMccDaqHats* pParam(nullptr);
-    if (pasynUser->reason >= 0 && m_mapParameters.count(pasynUser->reason))
-        pParam = m_mapParameters[pasynUser->reason];
-    if (!pParam) // default handler for other asyn parameters
-        goto handleWrite;
-    if (pParam->byAddress >= m_abyChannelMask.size())
-        m_abyChannelMask.resize(static_cast<size_t>(pParam->byAddress) + 1, 0);
-    switch (pParam->wHatID)
+    uint8_t byAddress(pBoard->byAddress), byChannels(0), byTmp(0);
+    double dRate(cmd.dRate), dTmp(static_cast<double>(epicsNAN));
+    uint32_t dwOptions(OPTS_CONTINUOUS);
+    int iResult(RESULT_SUCCESS);
+    int iFailState(bRestart ? SCAN_STOPPED : SCAN_IDLE);
+
+    if (!bRestart && IsScanActive(byAddress))
+        return asynSuccess; // already started
+    for (int i = 0; i < 8; ++i)
+        if ((cmd.byMask >> i) & 1)
+            ++byChannels;
+
+    // check sample rate and bus load
+    switch (pBoard->wHatID)
     {
         case HAT_ID_MCC_118: // 8-ch 12 bit single-ended analog input
-        {
-            uint16_t wStatus(0);
-            uint32_t dwSamplesPerChannel(0);
-            bool bStarted(mcc118_a_in_scan_status(pParam->byAddress, &wStatus, &dwSamplesPerChannel) == RESULT_SUCCESS
-                          && (wStatus & STATUS_RUNNING) != 0);
-            switch (pParam->iHatParam)
+            iResult = mcc118_a_in_scan_actual_rate(byChannels, fabs(dRate), &dTmp);
+            break;
+        case HAT_ID_MCC_128: // 4-ch differential / 8-ch single-ended 16 bit analog input
+            iResult = mcc128_a_in_scan_actual_rate(byChannels, fabs(dRate), &dTmp);
+            break;
+        case HAT_ID_MCC_172: // 2-ch 24 bit differential analog input
+            dTmp = fabs(dRate); // the actual rate is known after the clock configuration
+            break;
+        default:
+            return bRestart ? asynError : AbortScan(pBoard, SCAN_IDLE);
+    }
+    if (iResult != RESULT_SUCCESS)
+    {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, "mccdaqhats::StartScan - start A%u: invalid rate configured\n", byAddress);
+        return bRestart ? asynError : AbortScan(pBoard, SCAN_IDLE);
+    }
+    if (AdmitScan(pasynUserSelf, byAddress, pBoard->wHatID, cmd.byMask, fabs(dTmp)) != asynSuccess)
+        return bRestart ? asynError : AbortScan(pBoard, SCAN_IDLE);
+
+    // prepare data acquisition, this stops a running scan
+    switch (pBoard->wHatID)
+    {
+        case HAT_ID_MCC_118: // 8-ch 12 bit single-ended analog input
+            busCall(mcc118_a_in_scan_stop, byAddress);
+            busCall(mcc118_a_in_scan_cleanup, byAddress);
+            if (dRate < 0.)
             {
-                case MCCDAQHAT_RATE: // float 100000, <=0: external clock with frequency hint
-                    if (bStarted || !isfinite(dValue) || fabs(dValue) > 100000.)
-                    {
-                        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeFloat64 - MCC118 is active or invalid clock rate\n");
-                        iResult = asynError;
-                    }
-                    break;
-                default:
-                    asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeFloat64 - MCC118 read only parameter\n");
-                    iResult = asynError; // not writeable
-                    break;
+                dTmp = -dTmp;
+                dwOptions |= OPTS_EXTCLOCK;
+            }
+            if (cmd.iTrig > 0)
+            {
+                busCall(mcc118_trigger_mode, byAddress, static_cast<uint8_t>(cmd.iTrig - 1));
+                dwOptions |= OPTS_EXTTRIGGER;
             }
             break;
-        } // case HAT_ID_MCC_118
         case HAT_ID_MCC_128: // 4-ch differential / 8-ch single-ended 16 bit analog input
-        {
-            uint16_t wStatus(0);
-            uint32_t dwSamplesPerChannel(0);
-            bool bStarted(mcc128_a_in_scan_status(pParam->byAddress, &wStatus, &dwSamplesPerChannel) == RESULT_SUCCESS
-                          && (wStatus & STATUS_RUNNING) != 0);
-            switch (pParam->iHatParam)
+            busCall(mcc128_a_in_scan_stop, byAddress);
+            busCall(mcc128_a_in_scan_cleanup, byAddress);
+            if (dRate < 0.)
             {
-                case MCCDAQHAT_RATE: // float 100000, <=0: external clock with frequency hint
-                    if (bStarted || !isfinite(dValue) || fabs(dValue) > 100000.)
-                    {
-                        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeFloat64 - MCC128 is active or invalid clock rate\n");
-                        iResult = asynError;
-                    }
-                    break;
-                default:
-                    asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeFloat64 - MCC128 read only parameter\n");
-                    iResult = asynError; // not writeable
-                    break;
+                dTmp = -dTmp;
+                dwOptions |= OPTS_EXTCLOCK;
+            }
+            if (cmd.iTrig > 0)
+            {
+                busCall(mcc128_trigger_mode, byAddress, static_cast<uint8_t>(cmd.iTrig - 1));
+                dwOptions |= OPTS_EXTTRIGGER;
             }
+            busCall(mcc128_a_in_range_write, byAddress, static_cast<uint8_t>(cmd.iRange));
+            busCall(mcc128_a_in_mode_write, byAddress, static_cast<uint8_t>(cmd.iMode ? 1 : 0));
             break;
-        } // case HAT_ID_MCC_128
-        case HAT_ID_MCC_134: // 4-ch 24 bit thermocouple input
-            switch (pParam->iHatParam)
+        case HAT_ID_MCC_172: // 2-ch 24 bit differential analog input
+            busCall(mcc172_a_in_scan_stop, byAddress);
+            busCall(mcc172_a_in_scan_cleanup, byAddress);
+            if (cmd.iTrig > 0)
+                dwOptions |= OPTS_EXTTRIGGER;
+            if (busCall(mcc172_a_in_clock_config_write, byAddress, static_cast<uint8_t>(cmd.iClkSrc), dRate) != RESULT_SUCCESS)
             {
-                case MCCDAQHAT_RATE: // uint8 1, update interval in seconds, 1…255
-                    if (isfinite(dValue) && dValue >= 1. && dValue < 256)
-                        return writeInt32(pasynUser, static_cast<epicsInt32>(dValue));
-                    else
-                    {
-                        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeFloat64 - MCC134 invalid update interval\n");
-                        iResult = asynError;
-                    }
-                    break;
-                default:
-                    asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeFloat64 - MCC134 read only parameter\n");
-                    iResult = asynError; // not writeable
-                    break;
+                asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, "mccdaqhats::StartScan - start MCC172: invalid clock source or rate configured\n");
+                return AbortScan(pBoard, iFailState);
+            }
+            if (busCall(mcc172_a_in_clock_config_read, byAddress, &byTmp, &dTmp, &byTmp) != RESULT_SUCCESS)
+            {
+                asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, "mccdaqhats::StartScan - start MCC172: cannot read actual rate\n");
+                return AbortScan(pBoard, iFailState);
+            }
+            if (busCall(mcc172_trigger_config, byAddress, static_cast<uint8_t>(cmd.iClkSrc), static_cast<uint8_t>(cmd.iTrig - 1)) != RESULT_SUCCESS)
+            {
+                asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, "mccdaqhats::StartScan - start MCC172: invalid clock source or trigger mode\n");
+                return AbortScan(pBoard, iFailState);
+            }
+            break;
+    }
+
+    // the new configuration is used from the next block
+    lock();
+    m_abyChannelMask[byAddress] = cmd.byMask;
+    if (fabs(dRate - dTmp) > 0.)
+    {
+        // publish actual rate
+        auto it(m_mapDev2Asyn.find(GetMapHash(byAddress, MCCDAQHAT_RATE)));
+        if (it != m_mapDev2Asyn.end())
+        {
+            setDoubleParam((*it).second, dTmp);
+            callParamCallbacks();
+        }
+        dRate = dTmp;
+    }
+    PublishConfig(byAddress); // channel mask and sample rate for the processing stages
+    unlock();
+
+    // start data acquisition
+    switch (pBoard->wHatID)
+    {
+        case HAT_ID_MCC_118:
+            iResult = busCall(mcc118_a_in_scan_start, byAddress, cmd.byMask, 0, fabs(dRate), dwOptions);
+            if (iResult != RESULT_SUCCESS)
+            {
+                busCall(mcc118_a_in_scan_stop, byAddress);
+                busCall(mcc118_a_in_scan_cleanup, byAddress);
             }
             break;
-        case HAT_ID_MCC_152: // 2-ch 12 bit analog output, 8-ch digital I/O
-            switch (pParam->iHatParam)
+        case HAT_ID_MCC_128:
+            iResult = busCall(mcc128_a_in_scan_start, byAddress, cmd.byMask, 0, fabs(dRate), dwOptions);
+            if (iResult != RESULT_SUCCESS)
             {
-                case MCCDAQHAT_C0:
-                case MCCDAQHAT_C1:
-                    if (!isfinite(dValue) || dValue < 0. || dValue > 5.)
-                    {
-                        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeFloat64 - MCC152 invalid output value\n");
-                        iResult = asynError; // not writeable
-                    }
-                    else if (mcc152_a_out_write(pParam->byAddress, static_cast<uint8_t>(pParam->iHatParam - MCCDAQHAT_C0), OPTS_DEFAULT, dValue) != RESULT_SUCCESS)
-                    {
-                        asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeFloat64 - MCC152 cannot write output value\n");
-                        iResult = asynError; // not writeable
-                    }
-                    break;
-                default:
-                    asynPrint(pasynUser, ASYN_TRACE_ERROR, "mccdaqhats::writeFloat64 - MCC134 read only parameter\n");
-                    iResult = asynError; // not writeable
-                    break;
+                busCall(mcc128_a_in_scan_stop, byAddress);
+                busCall(mcc128_a_in_scan_cleanup, byAddress);
             }
             break;
-        case HAT_ID_MCC_172: // 2-ch 24 bit differential analog input
-            break; // nothing to do here
-        default: // unsupported device
-            iResult = asynError; // not writeable
+        case HAT_ID_MCC_172:
+            iResult = busCall(mcc172_a_in_scan_start, byAddress, cmd.byMask, 0, dwOptions);
+            if (iResult != RESULT_SUCCESS)
+            {
+                busCall(mcc172_a_in_scan_stop, byAddress);
+                busCall(mcc172_a_in_scan_cleanup, byAddress);
+            }
             break;
     }
-handleWrite:
-    if (iResult == asynSuccess)
-        iResult = asynPortDriver::writeFloat64(pasynUser, dValue);
-    return iResult;
+    if (iResult != RESULT_SUCCESS)
+    {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, "mccdaqhats::StartScan - cannot start A%u\n", byAddress);
+        return AbortScan(pBoard, iFailState);
+    }
+    pBoard->running       = cmd;
+    pBoard->running.dRate = dRate;
+    SetScanState(byAddress, cmd.iTrig > 0 ? SCAN_ARMED : SCAN_RUNNING);
+    return asynSuccess;
 }
 
 /**
- * @brief Called when asyn clients call pasynFloat64Array->read().
- *        For some parameters, it reads the hardware and in other cases,
- *        this will call the base class, which simply returns an error.
- * @param[in]  pasynUser    pasynUser structure that encodes the reason and address.
- * @param[out] pdValue      address of buffer for read values.
- * @param[in]  uElements    number of elements to read.
- * @param[out] puIn         elements actually read.
+ * @brief stop data acquisition of a module; this is called by the board thread
+ *        with unlocked port, the SPI bus is taken for every library call only
+ * @param[in] pBoard  runtime state of this module
  * @return asyn result code
  */
-asynStatus mccdaqhatsCtrl::readFloat64Array(asynUser *pasynUser, epicsFloat64* pdValue, size_t uElements, size_t* puIn)
+asynStatus mccdaqhatsCtrl::StopScan(struct boardMccDaqHats* pBoard)
 {
-    asynStatus iResult(asynError);
-    struct paramMccDaqHats* pParam(nullptr);
-    if (pasynUser->reason >= 0 && m_mapParameters.count(pasynUser->reason))
-        pParam = m_mapParameters[pasynUser->reason];
-    if (!pParam) // default handler for other asyn parameters
-        iResult = asynPortDriver::readFloat64Array(pasynUser, pdValue, uElements, puIn);
-    else if (!pParam->adCache.empty())
+    asynStatus iResult(asynSuccess);
+    uint8_t byAddress(pBoard->byAddress);
+    bool bStarted(IsScanActive(byAddress));
+    int iStop(RESULT_SUCCESS);
+
+    switch (pBoard->wHatID)
     {
-        if (uElements > pParam->adCache.size())
-            uElements = pParam->adCache.size();
-        memmove(pdValue, &pParam->adCache[0], uElements * sizeof(*pdValue));
-        *puIn = uElements;
-        iResult = asynSuccess;
+        case HAT_ID_MCC_118:
+            iStop = busCall(mcc118_a_in_scan_stop, byAddress);
+            busCall(mcc118_a_in_scan_cleanup, byAddress);
+            break;
+        case HAT_ID_MCC_128:
+            iStop = busCall(mcc128_a_in_scan_stop, byAddress);
+            busCall(mcc128_a_in_scan_cleanup, byAddress);
+            break;
+        case HAT_ID_MCC_172:
+            iStop = busCall(mcc172_a_in_scan_stop, byAddress);
+            busCall(mcc172_a_in_scan_cleanup, byAddress);
+            break;
+        default:
+            return asynError;
+    }
+    if (iStop != RESULT_SUCCESS && bStarted)
+    {
+        asynPrint(pasynUserSelf, ASYN_TRACE_ERROR, "mccdaqhats::StopScan - cannot stop A%u\n", byAddress);
+        iResult = asynError;
     }
+    mccdaqhatsBus::setBoardLoad(byAddress, pBoard->wHatID, 0.);
+    SetScanState(byAddress, SCAN_IDLE);
     return iResult;
 }
 
 /**
- * @brief get index for "m_mapDev2Asyn" mapping
- * @param[in] byAddress device address (0…MAX_NUMBER_HATS-1)
- * @param[in] iParam    parameter index (enum \ref ParameterId)
- * @return index for "m_mapDev2Asyn" mapping
+ * @brief apply a new configuration to a module: a running acquisition is stopped and restarted
+ *        in one sequence, while the acquisition thread skips this module;
+ *        the gap is published with "GAP" and the next block gets a gap marker
+ * @param[in] pBoard  runtime state of this module
+ * @param[in] cmd     configuration captured by "QueueScan"
  */
-int mccdaqhatsCtrl::GetMapHash(uint8_t byAddress, int iParam)
+void mccdaqhatsCtrl::RestartScan(struct boardMccDaqHats* pBoard, const struct commandMccDaqHats& cmd)
 {
-    return static_cast<int>(MAX_NUMBER_HATS * iParam + byAddress);
+    uint8_t byAddress(pBoard->byAddress);
+    epicsUInt64 qwStart(epicsMonotonicGet());
+    double dGap(0.);
+
+    if (!IsScanActive(byAddress))
+    {
+        // the scan was stopped meanwhile: the new channel mask is used from the next start
+        lock();
+        m_abyChannelMask[byAddress] = cmd.byMask;
+        PublishConfig(byAddress);
+        unlock();
+        return;
+    }
+    if (StartScan(pBoard, cmd, true) != asynSuccess)
+    {
+        if (IsScanActive(byAddress))
+        {
+            // refused: the scan keeps its configuration, publish it again;
+            // a later command was captured with the refused settings and applies them itself
+            bool bLater;
+            lock();
+            epicsMutexMustLock(pBoard->hQueueLock);
+            bLater = !pBoard->aQueue.empty();
+            epicsMutexUnlock(pBoard->hQueueLock);
+            if (!bLater)
+            {
+                const struct { int iParam; bool bInt; double dValue; } aRunning[] =
+                    { { MCCDAQHAT_MASK,  true,  static_cast<double>(pBoard->running.byMask) },
+                      { MCCDAQHAT_TRIG,  true,  static_cast<double>(pBoard->running.iTrig) },
+                      { MCCDAQHAT_RANGE, true,  static_cast<double>(pBoard->running.iRange) },
+                      { MCCDAQHAT_MODE,  true,  static_cast<double>(pBoard->running.iMode) },
+                      { MCCDAQHAT_RATE,  false, pBoard->running.dRate } };
+                m_abyRequestedMask[byAddress] = m_abyChannelMask[byAddress];
+                for (size_t i = 0; i < ARRAY_SIZE(aRunning); ++i)
+                {
+                    auto it(m_mapDev2Asyn.find(GetMapHash(byAddress, aRunning[i].iParam)));
+                    if (it == m_mapDev2Asyn.end())
+                        continue; // not supported by this module
+                    if (aRunning[i].bInt)
+                        setIntegerParam((*it).second, static_cast<epicsInt32>(aRunning[i].dValue));
+                    else
+                        setDoubleParam((*it).second, aRunning[i].dValue);
+                }
+                callParamCallbacks();
+            }
+            unlock();
+        }
+        return;
+    }
+    dGap = 1.e-6 * static_cast<double>(epicsMonotonicGet() - qwStart); // ns -> ms
+    epicsAtomicSetIntT(&pBoard->iGapMarker, 1);
+    lock();
+    auto it(m_mapDev2Asyn.find(GetMapHash(byAddress, MCCDAQHAT_GAP)));
+    if (it != m_mapDev2Asyn.end())
+    {
+        setDoubleParam((*it).second, dGap);
+        callParamCallbacks();
+    }
+    unlock();
+    asynPrint(pasynUserSelf, ASYN_TRACE_FLOW, "mccdaqhats::RestartScan - A%u reconfigured with %.3fms gap\n", byAddress, dGap);
+}
+
+/**
+ * @brief create a new configuration snapshot of a module and publish it for the acquisition thread;
+ *        this is called with locked port after every change of the channel configuration
+ * @param[in] byAddress  device address (0…MAX_NUMBER_HATS-1)
+ */
+void mccdaqhatsCtrl::PublishConfig(uint8_t byAddress)
+{
+    struct boardMccDaqHats* pBoard(byAddress < m_apBoards.size() ? m_apBoards[byAddress] : nullptr);
+    struct configMccDaqHats* pOld(nullptr);
+    struct configMccDaqHats* pNew(nullptr);
+    struct paramMccDaqHats* p(nullptr);
+    int iSeen(0);
+    if (!pBoard)
+        return;
+    pOld = reinterpret_cast<struct configMccDaqHats*>(epicsAtomicGetPtrT(&pBoard->pConfig));
+    pNew = new configMccDaqHats();
+    pNew->iGeneration = pOld ? (pOld->iGeneration + 1) : 1;
+    pNew->byMask      = m_abyChannelMask[byAddress];
+    pNew->byChannels  = 0;
+    pNew->dRate       = fabs(GetDevParamDouble(byAddress, MCCDAQHAT_RATE, 0.));
+    if (!isfinite(pNew->dRate))
+        pNew->dRate = 0.;
+    auto findParam = [this, byAddress](int iParam) -> struct paramMccDaqHats*
+    {
+        auto it(m_mapDev2Asyn.find(GetMapHash(byAddress, iParam)));
+        if (it == m_mapDev2Asyn.end() || !m_mapParameters.count((*it).second))
+            return nullptr;
+        return m_mapParameters[(*it).second];
+    };
+    for (int i = 0; i < 8; ++i)
+    {
+        struct configMccDaqHats::stageConfigMccDaqHats& st(pNew->aStage[i]);
+        pNew->abyOffset[i] = 0xFF;
+        pNew->apChannel[i] = findParam(MCCDAQHAT_C0 + i);
+        if ((pNew->byMask >> i) & 1)
+            pNew->abyOffset[i] = pNew->byChannels++;
+        st.iDecFactor  = GetDevParamInt(byAddress, MCCDAQHAT_DEC_FACTOR0 + i, 1);
+        st.iDecType    = GetDevParamInt(byAddress, MCCDAQHAT_DEC_TYPE0 + i, 0);
+        st.pDecArray   = findParam(MCCDAQHAT_DEC_C0 + i);
+        st.pDecValue   = findParam(MCCDAQHAT_DEC_VAL0 + i);
+        st.iStatMode   = GetDevParamInt(byAddress, MCCDAQHAT_STAT_MODE0 + i, 0);
+        st.iStatWindow = GetDevParamInt(byAddress, MCCDAQHAT_STAT_N0 + i, 1000);
+        st.iStatReset  = pBoard->aiStatReset[i];
+        st.apStat[0]   = findParam(MCCDAQHAT_STAT_MEAN0 + i);
+        st.apStat[1]   = findParam(MCCDAQHAT_STAT_RMS0 + i);
+        st.apStat[2]   = findParam(MCCDAQHAT_STAT_MIN0 + i);
+        st.apStat[3]   = findParam(MCCDAQHAT_STAT_MAX0 + i);
+        st.apStat[4]   = findParam(MCCDAQHAT_STAT_STD0 + i);
+        st.iFftMode    = GetDevParamInt(byAddress, MCCDAQHAT_FFT_MODE0 + i, 0);
+        st.iFftSize    = GetDevParamInt(byAddress, MCCDAQHAT_FFT_SIZE0 + i, 1024);
+        st.iFftWindow  = GetDevParamInt(byAddress, MCCDAQHAT_FFT_WIN0 + i, 1);
+        st.iFftOverlap = GetDevParamInt(byAddress, MCCDAQHAT_FFT_OVERLAP0 + i, 50);
+        st.iFftAvg     = GetDevParamInt(byAddress, MCCDAQHAT_FFT_AVG0 + i, 1);
+        st.pFftSpec    = findParam(MCCDAQHAT_FFT_SPEC0 + i);
+        st.pFftFreq    = findParam(MCCDAQHAT_FFT_FREQ0 + i);
+        st.pScope      = findParam(MCCDAQHAT_SCOPE_C0 + i);
+        st.iHistLen    = GetDevParamInt(byAddress, MCCDAQHAT_HIST_LEN0 + i, 0);
+        st.dHistRate   = GetDevParamDouble(byAddress, MCCDAQHAT_HIST_RATE0 + i, 1.);
+        st.pHist       = findParam(MCCDAQHAT_HIST_C0 + i);
+        st.dLodTime    = GetDevParamDouble(byAddress, MCCDAQHAT_LOD_TIME0 + i, 0.);
+        st.dLodAgo     = GetDevParamDouble(byAddress, MCCDAQHAT_LOD_AGO0 + i, 0.);
+        st.dLodSpan    = GetDevParamDouble(byAddress, MCCDAQHAT_LOD_SPAN0 + i, 60.);
+        st.iLodWidth   = GetDevParamInt(byAddress, MCCDAQHAT_LOD_WIDTH0 + i, 1000);
+        st.dLodRate    = GetDevParamDouble(byAddress, MCCDAQHAT_LOD_RATE0 + i, 1.);
+        st.pLodEnv     = findParam(MCCDAQHAT_LOD_ENV0 + i);
+        st.pLodMean    = findParam(MCCDAQHAT_LOD_MEAN0 + i);
+        st.pLodDt      = findParam(MCCDAQHAT_LOD_DT0 + i);
+        st.iRoiStart   = GetDevParamInt(byAddress, MCCDAQHAT_ROI_START0 + i, 0);
+        st.iRoiLen     = GetDevParamInt(byAddress, MCCDAQHAT_ROI_LEN0 + i, 0);
+        st.pRoi        = findParam(MCCDAQHAT_ROI_C0 + i);
+        st.pLast       = findParam(MCCDAQHAT_LAST0 + i);
+        st.iLastSrc    = GetDevParamInt(byAddress, MCCDAQHAT_LAST_SRC0 + i, 0);
+        st.dLastDb     = GetDevParamDouble(byAddress, MCCDAQHAT_LAST_DB0 + i, 0.);
+        st.iLastDbMode = GetDevParamInt(byAddress, MCCDAQHAT_LAST_DBMODE0 + i, 0);
+        st.iEuMode     = GetDevParamInt(byAddress, MCCDAQHAT_EU_MODE0 + i, 0);
+        if (st.iEuMode && (p = findParam(MCCDAQHAT_EU_COEF0 + i)) != nullptr)
+            st.adEuCoef = p->adCache;
+        st.iIirType    = GetDevParamInt(byAddress, MCCDAQHAT_IIR_TYPE0 + i, 0);
+        st.dIirFreq    = GetDevParamDouble(byAddress, MCCDAQHAT_IIR_FREQ0 + i, 50.);
+        st.dIirQ       = GetDevParamDouble(byAddress, MCCDAQHAT_IIR_Q0 + i, 0.7071);
+        st.iIirStages  = GetDevParamInt(byAddress, MCCDAQHAT_IIR_STAGES0 + i, 1);
+        st.iIirOut     = GetDevParamInt(byAddress, MCCDAQHAT_IIR_OUT0 + i, 0);
+        st.pIir        = findParam(MCCDAQHAT_IIR_C0 + i);
+        st.iEvtMode    = GetDevParamInt(byAddress, MCCDAQHAT_EVT_MODE0 + i, 0);
+        st.dEvtLevel   = GetDevParamDouble(byAddress, MCCDAQHAT_EVT_LEVEL0 + i, 0.);
+        st.dEvtHyst    = GetDevParamDouble(byAddress, MCCDAQHAT_EVT_HYST0 + i, 0.);
+        st.pEvtCount   = findParam(MCCDAQHAT_EVT_COUNT0 + i);
+        st.pEvtTime    = findParam(MCCDAQHAT_EVT_TIME0 + i);
+        st.pEvtList    = findParam(MCCDAQHAT_EVT_LIST0 + i);
+        st.dFreqGate   = GetDevParamDouble(byAddress, MCCDAQHAT_FREQ_GATE0 + i, 0.);
+        st.dFreqLevel  = GetDevParamDouble(byAddress, MCCDAQHAT_FREQ_LEVEL0 + i, 0.);
+        st.dFreqHyst   = GetDevParamDouble(byAddress, MCCDAQHAT_FREQ_HYST0 + i, 0.);
+        st.apFreq[0]   = findParam(MCCDAQHAT_FREQ0 + i);
+        st.apFreq[1]   = findParam(MCCDAQHAT_FREQ_PERIOD0 + i);
+        st.apFreq[2]   = findParam(MCCDAQHAT_FREQ_JITTER0 + i);
+    }
+    pNew->scope.iMode   = GetDevParamInt(byAddress, MCCDAQHAT_SCOPE_MODE, 0);
+    pNew->scope.iSource = GetDevParamInt(byAddress, MCCDAQHAT_SCOPE_SRC, 0);
+    pNew->scope.dLevel  = GetDevParamDouble(byAddress, MCCDAQHAT_SCOPE_LEVEL, 0.);
+    pNew->scope.iSlope  = GetDevParamInt(byAddress, MCCDAQHAT_SCOPE_SLOPE, 0);
+    pNew->scope.dHyst   = GetDevParamDouble(byAddress, MCCDAQHAT_SCOPE_HYST, 0.);
+    pNew->scope.iPre    = GetDevParamInt(byAddress, MCCDAQHAT_SCOPE_PRE, 100);
+    pNew->scope.iPost   = GetDevParamInt(byAddress, MCCDAQHAT_SCOPE_POST, 900);
+    pNew->scope.iArm    = pBoard->iScopeArm;
+    pNew->scope.pState  = findParam(MCCDAQHAT_SCOPE_STATE);
+    pNew->scope.pCount  = findParam(MCCDAQHAT_SCOPE_COUNT);
+    pNew->dPubRate      = GetDevParamDouble(byAddress, MCCDAQHAT_PUB_RATE, 0.);
+    pNew->uPubMax       = static_cast<size_t>(GetDevParamInt(byAddress, MCCDAQHAT_PUB_MAX, 10000));
+    pNew->iBlockMode    = GetDevParamInt(byAddress, MCCDAQHAT_BLOCK_MODE, 0);
+    pNew->pBlock        = findParam(MCCDAQHAT_BLOCK_C);
+    pNew->pBlockShape   = findParam(MCCDAQHAT_BLOCK_SHAPE);
+    pNew->pBlockPtr     = findParam(MCCDAQHAT_BLOCK_PTR);
+    pNew->pBlockSeq     = findParam(MCCDAQHAT_BLOCK_SEQ);
+    pNew->bLazy         = GetDevParamInt(byAddress, MCCDAQHAT_LAZY, 0) != 0;
+    for (int i = 0; i < MCCDAQHAT_VIRTUAL_CHANNELS; ++i)
+    {
+        int iIndex(GetMapHash(byAddress, MCCDAQHAT_VIRT_EXPR0 + i));
+        pNew->aVirtual[i].sExpression.clear();
+        if (m_mapDev2Asyn.find(iIndex) != m_mapDev2Asyn.end())
+            getStringParam(m_mapDev2Asyn[iIndex], pNew->aVirtual[i].sExpression);
+        pNew->aVirtual[i].pOutput = findParam(MCCDAQHAT_VIRT_C0 + i);
+    }
+    epicsAtomicSetPtrT(&pBoard->pConfig, static_cast<EpicsAtomicPtrT>(pNew));
+    if (pOld)
+        pBoard->apRetired.push_back(pOld);
+
+    // free snapshots, which are older than the one used by the acquisition thread
+    iSeen = epicsAtomicGetIntT(&pBoard->iConfigSeen);
+    for (size_t i = 0; i < pBoard->apRetired.size();)
+    {
+        if (pBoard->apRetired[i]->iGeneration < iSeen)
+        {
+            delete pBoard->apRetired[i];
+            pBoard->apRetired.erase(pBoard->apRetired.begin() + static_cast<std::ptrdiff_t>(i));
+        }
+        else
+            ++i;
+    }
+}
+
+/**
+ * @brief get current configuration snapshot of a module at a block boundary;
+ *        older snapshots are not used by the caller anymore and could be freed;
+ *        there is a single acquisition thread per module
+ * @param[in] pBoard  runtime state of a module
+ * @return configuration snapshot or nullptr
+ */
+const struct configMccDaqHats* mccdaqhatsCtrl::AcquireConfig(struct boardMccDaqHats* pBoard)
+{
+    const struct configMccDaqHats* pConfig(nullptr);
+    if (!pBoard)
+        return nullptr;
+    pConfig = reinterpret_cast<const struct configMccDaqHats*>(epicsAtomicGetPtrT(&pBoard->pConfig));
+    if (pConfig)
+        epicsAtomicSetIntT(&pBoard->iConfigSeen, pConfig->iGeneration);
+    return pConfig;
+}
+
+/**
+ * @brief search for the controller, which owns a module;
+ *        this locks the controller list, so it must not be called with a locked port
+ * @param[in] byAddress  device address (0…MAX_NUMBER_HATS-1)
+ * @return owning controller or nullptr
+ */
+mccdaqhatsCtrl* mccdaqhatsCtrl::FindOwner(uint8_t byAddress)
+{
+    mccdaqhatsCtrl* pResult(nullptr);
+    if (!m_hControllerLock || byAddress >= MAX_NUMBER_HATS)
+        return nullptr;
+    epicsMutexMustLock(m_hControllerLock);
+    for (auto it = m_mapControllers.begin(); it != m_mapControllers.end(); ++it)
+    {
+        mccdaqhatsCtrl* pCtrl((*it).second);
+        if (pCtrl && pCtrl->m_awHatID[byAddress])
+        {
+            pResult = pCtrl;
+            break;
+        }
+    }
+    epicsMutexUnlock(m_hControllerLock);
+    return pResult;
 }
 
 /**
@@ -1871,11 +4361,13 @@ epicsFloat64 mccdaqhatsCtrl::GetDevParamDouble(uint8_t byAddress, int iParam, ep
  * @param[in] (pArgs)            arguments to this wrapper
  * @param[in] szAsynPortName     [0]asyn port name of this motor controller
  * @param[in] szFileName         [1](over)write this file
+ * @param[in] iGroups            [2](optional) 1=add QSRV group information for PVA
  */
 void mccdaqhatsCtrl::writeDB(const iocshArgBuf* pArgs)
 {
     const char* szAsynPort(pArgs[0].sval);
     const char* szFilename(pArgs[1].sval);
+    bool bGroups(pArgs[2].ival != 0);
     mccdaqhatsCtrl* pInstance(nullptr);
     size_t uCount(0);
     FILE* pOutfile(nullptr);
@@ -1944,6 +4436,8 @@ void mccdaqhatsCtrl::writeDB(const iocshArgBuf* pArgs)
             struct paramMccDaqHats* pParam((*it2).second);
             const char *szHatType(nullptr), *szRecordType(nullptr), *szParamName(nullptr), *szDTYP(nullptr), *szAdditional(nullptr);
             asynParamType iParamType(asynParamNotDefined);
+            if (!pParam->wHatID && !pCtrl->m_bBusRecords)
+                continue; // shared SPI bus: the records of the first port are sufficient
             pCtrl->getParamType(pParam->iAsynReason, &iParamType);
             switch (iParamType)
             {
@@ -1951,7 +4445,7 @@ void mccdaqhatsCtrl::writeDB(const iocshArgBuf* pArgs)
                 case asynParamInt64:         szDTYP = "asynInt64";         break;
                 case asynParamUInt32Digital: szDTYP = "asynUInt32Digital"; break;
                 case asynParamFloat64:       szDTYP = "asynFloat64";       break;
-                case asynParamOctet:         szDTYP = pParam->bWritable ? "asynOctetWriteRead"  : "asynOctetRead";      break;
+                case asynParamOctet:         szDTYP = pParam->bWritable ? "asynOctetWrite"      : "asynOctetRead";      break;
                 case asynParamInt8Array:     szDTYP = pParam->bWritable ? "asynInt8ArrayOut"    : "asynInt8ArrayIn";    break;
                 case asynParamInt16Array:    szDTYP = pParam->bWritable ? "asynInt16ArrayOut"   : "asynInt16ArrayIn";   break;
                 case asynParamInt32Array:    szDTYP = pParam->bWritable ? "asynInt32ArrayOut"   : "asynInt32ArrayIn";   break;
@@ -1971,6 +4465,7 @@ void mccdaqhatsCtrl::writeDB(const iocshArgBuf* pArgs)
                 case HAT_ID_MCC_134: szHatType = "MCC 134 (4-ch 24 bit thermocouple input)";                            break;
                 case HAT_ID_MCC_152: szHatType = "MCC 152 (2-ch 12 bit analog output, 8-ch digital I/O)";               break;
                 case HAT_ID_MCC_172: szHatType = "MCC 172 (2-ch 24 bit differential analog input)";                     break;
+                case 0:              szHatType = "shared SPI bus of all HATs";                                         break;
                 default:             szHatType = "?unknown?"; break;
             }
             switch (pParam->asEnum.size())
@@ -2023,7 +4518,7 @@ void mccdaqhatsCtrl::writeDB(const iocshArgBuf* pArgs)
             }
             else
             {
-                if (pParam->wHatID == HAT_ID_MCC_134)
+                if (pParam->wHatID == HAT_ID_MCC_134 && !findStreamParam(pParam->iHatParam, nullptr))
                     fprintf(pOutfile, "  field(SCAN, \"1 second\")\n");
                 else
                     fprintf(pOutfile, "  field(SCAN, \"I/O Intr\")\n");
@@ -2043,6 +4538,31 @@ void mccdaqhatsCtrl::writeDB(const iocshArgBuf* pArgs)
                     fprintf(pOutfile, "  field(%sST, \"%s\")\n", aszPrefix[i], pParam->asEnum[i].c_str());
                 }
             }
+            if (bGroups)
+            {
+                // a PVA group per streaming module: all channel waveforms and the state,
+                // which are sent together by the block counter (last update of every publication)
+                std::string sGroup("MCC_A" + std::to_string(pParam->byAddress));
+                const char* szField(szParamName + sGroup.size() + 1);
+                switch (pParam->wHatID)
+                {
+                    case HAT_ID_MCC_118:
+                    case HAT_ID_MCC_128:
+                    case HAT_ID_MCC_172:
+                        if (strncmp(szParamName, sGroup.c_str(), sGroup.size()) || szParamName[sGroup.size()] != '_')
+                            break;
+                        if ((pParam->iHatParam >= MCCDAQHAT_C0 && pParam->iHatParam <= MCCDAQHAT_C7) ||
+                            pParam->iHatParam == MCCDAQHAT_STATE)
+                            fprintf(pOutfile, "  info(Q:group, {\"$(P):%s\":{\"%s\":{+channel:\"VAL\", +trigger:\"\"}}})\n",
+                                    sGroup.c_str(), szField);
+                        else if (pParam->iHatParam == MCCDAQHAT_BLOCK_SEQ)
+                            fprintf(pOutfile, "  info(Q:group, {\"$(P):%s\":{\"%s\":{+channel:\"VAL\", +trigger:\"*\"}, "
+                                    "\"\":{+type:\"meta\", +channel:\"VAL\"}}})\n", sGroup.c_str(), szField);
+                        break;
+                    default:
+                        break;
+                }
+            }
             if (szAdditional && *szAdditional)
             {
                 std::string s(szAdditional);
@@ -2071,7 +4591,8 @@ void mccdaqhatsCtrl::writeDB(const iocshArgBuf* pArgs)
 
 static const iocshArg mccdaqhatsInitializeArg0 = { "asyn-port-name", iocshArgString };
 static const iocshArg mccdaqhatsInitializeArg1 = { "comm-timeout",   iocshArgDouble };
-static const iocshArg* mccdaqhatsInitializeArgs[] = { &mccdaqhatsInitializeArg0, &mccdaqhatsInitializeArg1 };
+static const iocshArg mccdaqhatsInitializeArg2 = { "address-list",   iocshArgString };
+static const iocshArg* mccdaqhatsInitializeArgs[] = { &mccdaqhatsInitializeArg0, &mccdaqhatsInitializeArg1, &mccdaqhatsInitializeArg2 };
 static const iocshFuncDef mccdaqhatsInitializeDef =
     { "mccdaqhatsInitialize", ARRAY_SIZE(mccdaqhatsInitializeArgs),
       mccdaqhatsInitializeArgs
@@ -2080,13 +4601,16 @@ static const iocshFuncDef mccdaqhatsInitializeDef =
       ,"register a mccdaqhats controller\n\n"
       "  asyn-port-name  asyn port name of the controller\n"
       "  comm-timeout    PLC communication timeout in sec\n"
+      "  address-list    (optional) module addresses for this port, e.g. \"0,1\" or \"2-4\",\n"
+      "                  empty for all modules not used by another port\n"
 #endif
 #endif
     };
 
 static const iocshArg mccdaqhatsWriteDBArg0 = { "asyn-port-name", iocshArgString };
 static const iocshArg mccdaqhatsWriteDBArg1 = { "filename",   iocshArgStringPath };
-static const iocshArg* mccdaqhatsWriteDBArgs[] = { &mccdaqhatsWriteDBArg0, &mccdaqhatsWriteDBArg1 };
+static const iocshArg mccdaqhatsWriteDBArg2 = { "pva-groups", iocshArgInt };
+static const iocshArg* mccdaqhatsWriteDBArgs[] = { &mccdaqhatsWriteDBArg0, &mccdaqhatsWriteDBArg1, &mccdaqhatsWriteDBArg2 };
 static const iocshFuncDef mccdaqhatsWriteDBDef =
     { "mccdaqhatsWriteDB", ARRAY_SIZE(mccdaqhatsWriteDBArgs),
       mccdaqhatsWriteDBArgs
@@ -2095,6 +4619,7 @@ static const iocshFuncDef mccdaqhatsWriteDBDef =
       ,"write example EPICS DB file for what the mccdaqhatsInitialize function found here\n\n"
       "  asyn-port-name  asyn port name of the controller\n"
       "  filename        (over)write this file\n"
+      "  pva-groups      (optional) 1=add QSRV groups, one PVA structure per streaming module\n"
 #endif
 #endif
     };
@@ -7,6 +7,7 @@
 #define MCCDAQHATS_INCLUDED
 
 #include <asynPortDriver.h>
+#include <epicsMutex.h>
 #include <iocsh.h>
 #include <map>
 #include <vector>
@@ -14,6 +15,10 @@
 // forward declarations
 struct iocshArgs;
 struct parammccdaqhats;
+struct boardMccDaqHats;
+struct commandMccDaqHats;
+struct configMccDaqHats;
+struct scanBlockMccDaqHats;
 
 /// mccdaqhats controller
 class mccdaqhatsCtrl : public asynPortDriver
@@ -39,33 +44,75 @@ public:
     asynStatus readFloat64 (asynUser* pasynUser, epicsFloat64* pdValue);
     asynStatus writeFloat64(asynUser* pasynUser, epicsFloat64  dValue);
     asynStatus readFloat64Array(asynUser *pasynUser, epicsFloat64* pdValue, size_t uElements, size_t* puIn);
+    asynStatus writeFloat64Array(asynUser* pasynUser, epicsFloat64* pdValue, size_t uElements);
+    asynStatus writeOctet  (asynUser* pasynUser, const char* szValue, size_t uMaxChars, size_t* puActual);
 
     // report internal information on user request
     void report(FILE* fp, int iLevel);
 
     virtual void backgroundthread();
+    virtual void boardthread(struct boardMccDaqHats* pBoard);
     virtual void interrupt();
 
 protected:
     static std::map<std::string, mccdaqhatsCtrl*> m_mapControllers; ///< global mapping of all controllers
+    static epicsMutexId                    m_hControllerLock; ///< protects "m_mapControllers" against interrupt thread
     std::map<int, struct paramMccDaqHats*> m_mapParameters;  ///< mapping of asyn reasons to parameter
     std::map<int, int>                     m_mapDev2Asyn;    ///< mapping of device/parameter to asyn reason
     double                                 m_dTimeout;       ///< communication timeout
-    std::vector<uint8_t>                   m_abyChannelMask; ///< channel mask for every module
+    std::vector<uint8_t>                   m_abyChannelMask; ///< active channel mask for every module
+    std::vector<uint8_t>                   m_abyRequestedMask; ///< requested channel mask for every module incl. queued commands (locked port)
+    std::vector<epicsUInt16>               m_awHatID;        ///< HAT id for every module owned by this controller (0=not owned)
+    std::vector<struct boardMccDaqHats*>   m_apBoards;       ///< runtime state for every module owned by this controller
     epicsThreadId                          m_hThread;        ///< background update thread
+    int                                    m_iBusLoadReason; ///< asyn reason of published bus load or -1
+    int                                    m_iBusLimitReason;  ///< asyn reason of published bus limit or -1
+    int                                    m_iBusPolicyReason; ///< asyn reason of published bus policy or -1
+    std::vector<int>                       m_aiBusWaitReason;  ///< asyn reasons of published maximum bus wait per priority class or -1
+    bool                                   m_bBusRecords;    ///< mccdaqhatsWriteDB writes the records of the bus parameters
+    std::vector<bool>                      m_abInterruptUsers; ///< asyn reasons with interrupt users (locked port)
+    epicsUInt64                            m_qwUsersNext;    ///< time of next update of "m_abInterruptUsers" (monotonic ns)
 
     static int   GetMapHash(uint8_t byAddress, int iParam);
+    static bool  ParseAddressList(const char* szList, epicsUInt32* pdwAddresses);
+    static mccdaqhatsCtrl* FindOwner(uint8_t byAddress);
+    asynStatus   AdmitScan(asynUser* pasynUser, uint8_t byAddress, uint16_t wHatID, uint8_t byMask, double dRate);
+    int          GetScanState(uint8_t byAddress);
+    bool         IsScanActive(uint8_t byAddress);
+    bool         SetScanState(uint8_t byAddress, int iState, int iExpected = -1);
+    bool         IsScanBusy(uint8_t byAddress);
+    asynStatus   QueueScan(asynUser* pasynUser, uint8_t byAddress, bool bStart, int iParam = -1, double dValue = 0.);
+    asynStatus   AbortScan(struct boardMccDaqHats* pBoard, int iState);
+    asynStatus   StartScan(struct boardMccDaqHats* pBoard, const struct commandMccDaqHats& cmd, bool bRestart = false);
+    asynStatus   StopScan(struct boardMccDaqHats* pBoard);
+    void         RestartScan(struct boardMccDaqHats* pBoard, const struct commandMccDaqHats& cmd);
+    void         PublishConfig(uint8_t byAddress);
+    static const struct configMccDaqHats* AcquireConfig(struct boardMccDaqHats* pBoard);
+    void         ProcessChannel(struct boardMccDaqHats* pBoard, const struct configMccDaqHats* pConfig, int iChannel,
+                                const struct scanBlockMccDaqHats& block);
+    void         PublishScan(struct boardMccDaqHats* pBoard, const struct configMccDaqHats* pConfig,
+                             const struct scanBlockMccDaqHats& block);
+    void         PublishChannel(struct boardMccDaqHats* pBoard, const struct configMccDaqHats* pConfig, int iChannel,
+                                epicsUInt64 qwNow, bool bPublish);
     epicsInt32   GetDevParamInt(uint8_t byAddress, int iParam, epicsInt32 iDefaultValue);
     epicsFloat64 GetDevParamDouble(uint8_t byAddress, int iParam, epicsFloat64 dDefaultValue);
+    void         UpdateInterruptUsers();
+    bool         HasInterruptUsers(const struct paramMccDaqHats* pParam) const;
+    void         PollBoard(struct boardMccDaqHats* pBoard, const struct configMccDaqHats* pConfig);
+    void         PublishBlock(struct boardMccDaqHats* pBoard, const struct configMccDaqHats* pConfig);
+    void         PublishArray(struct paramMccDaqHats* pParam, std::vector<double>& adNew, std::vector<double>& adPending,
+                              bool bNow, size_t uMax);
 
 private:
     /// @brief this is a wrapper for real implementation "mccdaqhatsCtrl::backgroundthread"
     static void backgroundthreadfunc(void* pParameter)
         { mccdaqhatsCtrl* pMeMyselfAndI(reinterpret_cast<mccdaqhatsCtrl*>(pParameter)); if (pMeMyselfAndI) pMeMyselfAndI->backgroundthread(); }
 
-    /// @brief this is a wrapper for real implementation "mccdaqhatsCtrl::interrupt"
-    static void interruptfunc(void* pParameter)
-        { mccdaqhatsCtrl* pMeMyselfAndI(reinterpret_cast<mccdaqhatsCtrl*>(pParameter)); if (pMeMyselfAndI) pMeMyselfAndI->interrupt(); }
+    /// @brief this is a wrapper for real implementation "mccdaqhatsCtrl::boardthread"
+    static void boardthreadfunc(void* pParameter);
+
+    /// @brief this is a dispatcher to "mccdaqhatsCtrl::interrupt" of every controller (the library supports a single callback only)
+    static void interruptfunc(void* pParameter);
 };
 
 #endif /*MCCDAQHATS_INCLUDED*/
@@ -0,0 +1,49 @@
+/*
+ * SPDX-License-Identifier: EPICS
+ * Helmholtz-Zentrum Berlin fuer Materialien und Energie GmbH 2023-2024
+ * Lutz Rossa <rossa@helmholtz-berlin.de>
+ */
+#ifndef MCCDAQHATSBLOCK_INCLUDED
+#define MCCDAQHATSBLOCK_INCLUDED
+
+#include <stddef.h>
+#include <epicsTypes.h>
+#include <epicsTime.h>
+
+/// version of \ref mccdaqhatsBlock, it is incremented on incompatible changes
+#define MCCDAQHATS_BLOCK_VERSION 2
+
+/// status flags of \ref mccdaqhatsBlock
+enum mccdaqhatsBlockFlags
+{
+    MCCDAQHATS_BLOCK_GAP       = 0x01, ///< block follows a reconfiguration gap, "qwSample" is not contiguous
+    MCCDAQHATS_BLOCK_TRIGGERED = 0x02, ///< hardware trigger occurred
+    MCCDAQHATS_BLOCK_OVERRUN   = 0x04, ///< hardware or buffer overrun, data was lost before this block
+    MCCDAQHATS_BLOCK_CONVERTED = 0x08, ///< at least one channel is in engineering units, see "byConverted"
+    MCCDAQHATS_BLOCK_FILTERED  = 0x10  ///< at least one channel is filtered by the inline IIR filter, see "byFiltered"
+};
+
+/**
+ * @brief The mccdaqhatsBlock struct describes a block of acquired data of a streaming module;
+ *        it is published by the asynGenericPointer interrupt of "MCC_A<n>_BLOCK_PTR" and the
+ *        data points into the buffer of the acquisition thread: it is valid during the
+ *        callback only, so consumers have to copy the parts they need
+ */
+struct mccdaqhatsBlock
+{
+    epicsUInt32    dwVersion;   ///< \ref MCCDAQHATS_BLOCK_VERSION
+    epicsUInt32    dwFlags;     ///< status bits (enum \ref mccdaqhatsBlockFlags)
+    epicsUInt8     byAddress;   ///< HAT address
+    epicsUInt16    wHatID;      ///< HAT id -> hardware type
+    epicsUInt8     byMask;      ///< channel selection bit mask
+    epicsUInt8     byChannels;  ///< number of enabled channels = values per scan
+    epicsUInt8     byConverted; ///< bit mask of channels in engineering units (EU_MODE), the others are in volts
+    epicsUInt8     byFiltered;  ///< bit mask of channels with inline IIR filter (IIR_OUT=inline), the others are unfiltered
+    epicsUInt64    qwSample;    ///< index of the first scan, counted by the module since IOC start
+    epicsTimeStamp tStamp;      ///< time of reception of this block
+    double         dRate;       ///< sample rate per channel in Hz
+    size_t         uScans;      ///< number of scans
+    const double*  pdData;      ///< interleaved values "uScans" * "byChannels" (calibrated volts, channels of "byConverted" in engineering units)
+};
+
+#endif /*MCCDAQHATSBLOCK_INCLUDED*/
@@ -0,0 +1,413 @@
+/*
+ * SPDX-License-Identifier: EPICS
+ * Helmholtz-Zentrum Berlin fuer Materialien und Energie GmbH 2023-2024
+ * Lutz Rossa <rossa@helmholtz-berlin.de>
+ */
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include <daqhats/daqhats.h>
+#include <epicsEvent.h>
+#include <epicsMutex.h>
+#include <epicsThread.h>
+#include <epicsTime.h>
+#include "mccdaqhatsBus.h"
+
+/* ========================================================================
+ * scheduler state
+ * ======================================================================== */
+
+/**
+ * @brief internal state of the bus scheduler:
+ *        a waiting transaction of a higher priority class always gets the bus next,
+ *        the owning thread may acquire the bus recursively
+ */
+static struct busState
+{
+    epicsMutexId  hLock;                                   ///< protects this structure
+    epicsEventId  ahEvent[mccdaqhatsBus::PRIO_COUNT];      ///< wake up waiting transactions of this class
+    int           aiWaiting[mccdaqhatsBus::PRIO_COUNT];    ///< number of waiting transactions
+    epicsThreadId hOwner;                                  ///< current owner or 0
+    int           iDepth;                                  ///< recursion depth of owner
+    epicsUInt64   qwHoldStart;                             ///< time stamp of acquisition [ns]
+    struct mccdaqhatsBus::statistics aStat[mccdaqhatsBus::PRIO_COUNT]; ///< latency statistics
+    epicsUInt16   awHatID[MAX_NUMBER_HATS];                ///< planner: HAT id of running scans
+    double        adSamples[MAX_NUMBER_HATS];              ///< planner: samples per second of running scans
+    double        adTransaction[3];                        ///< planner: measured time of a single transaction [s] (MCC118, MCC128, MCC172)
+    double        dCpuPerSample;                           ///< planner: measured processing time per sample [s]
+    double        dLimit;                                  ///< planner: allowed load (1.0 = 100%)
+    bool          bRefuse;                                 ///< planner: refuse (true) or warn (false) on overload
+} g_bus;
+
+/**
+ * @brief nominal bus properties of scanning HAT types for the bandwidth model:
+ *        a scan transfers samples in blocks, every block costs one transaction plus its data bytes
+ */
+static const struct busModel
+{
+    epicsUInt16 wHatID;             ///< HAT type
+    double      dBytesPerSample;    ///< transferred bytes per sample
+    double      dBitRate;           ///< nominal SPI clock [bit/s]
+    double      dSamplesPerBlock;   ///< samples per transaction of the library scan thread
+    double      dTransaction;       ///< default time of a single transaction [s], if not calibrated
+} g_aBusModel[3] =
+{
+    { HAT_ID_MCC_118, 2., 18e6, 256., 100e-6 },
+    { HAT_ID_MCC_128, 2., 18e6, 256., 100e-6 },
+    { HAT_ID_MCC_172, 3., 18e6, 256., 100e-6 }
+};
+
+/**
+ * @brief get index into "g_aBusModel" of a HAT type
+ * @param[in] wHatID  HAT type
+ * @return index or -1 for HATs without scan
+ */
+static int busModelIndex(epicsUInt16 wHatID)
+{
+    for (size_t i = 0; i < sizeof(g_aBusModel) / sizeof(g_aBusModel[0]); ++i)
+        if (g_aBusModel[i].wHatID == wHatID)
+            return static_cast<int>(i);
+    return -1;
+}
+
+/**
+ * @brief built-in measurement of the processing time per sample: de-interleave a synthetic block
+ *        like the background thread does (the cost of the stream processing stages is not included)
+ * @return processing time per sample [s]
+ */
+static double busMeasureCpu()
+{
+    const size_t uSamples(80000), uChannels(8);
+    std::vector<double> adIn(uSamples), adOut(uSamples / uChannels);
+    epicsUInt64 qwStart, qwBest(0);
+    double dSum(0.);
+    for (size_t i = 0; i < uSamples; ++i)
+        adIn[i] = static_cast<double>(i & 0xFFF) * 1e-3;
+    for (int iLoop = 0; iLoop < 5; ++iLoop)
+    {
+        qwStart = epicsMonotonicGet();
+        for (size_t j = 0; j < uChannels; ++j)
+        {
+            for (size_t k = 0; k < adOut.size(); ++k)
+                adOut[k] = adIn[uChannels * k + j];
+            dSum += adOut[adOut.size() - 1];
+        }
+        qwStart = epicsMonotonicGet() - qwStart;
+        if (!iLoop || qwStart < qwBest)
+            qwBest = qwStart;
+    }
+    if (dSum < 0.) // never true, keeps the compiler from removing the loop
+        qwBest = 0;
+    return 1e-9 * static_cast<double>(qwBest) / static_cast<double>(uSamples);
+}
+
+/// @brief create the scheduler state once, called by "busInit"
+static void busInitOnce(void* pParameter)
+{
+    (void)pParameter;
+    memset(&g_bus, 0, sizeof(g_bus));
+    g_bus.hLock = epicsMutexMustCreate();
+    for (int i = 0; i < mccdaqhatsBus::PRIO_COUNT; ++i)
+        g_bus.ahEvent[i] = epicsEventMustCreate(epicsEventEmpty);
+    for (size_t i = 0; i < sizeof(g_aBusModel) / sizeof(g_aBusModel[0]); ++i)
+        g_bus.adTransaction[i] = g_aBusModel[i].dTransaction;
+    g_bus.dCpuPerSample = busMeasureCpu();
+    g_bus.dLimit        = 0.9;
+    g_bus.bRefuse       = false;
+}
+
+/// @brief create the scheduler state on first use (thread safe)
+static void busInit()
+{
+    static epicsThreadOnceId hOnce(EPICS_THREAD_ONCE_INIT);
+    epicsThreadOnce(&hOnce, &busInitOnce, nullptr);
+}
+
+/**
+ * @brief acquire the shared bus for a transaction
+ * @param[in] iPrio  priority class of the transaction
+ */
+void mccdaqhatsBus::acquire(Priority iPrio)
+{
+    epicsThreadId hSelf(epicsThreadGetIdSelf());
+    epicsUInt64 qwStart(epicsMonotonicGet()), qwNow;
+    double dWait;
+    busInit();
+    epicsMutexMustLock(g_bus.hLock);
+    if (g_bus.hOwner == hSelf)
+    {
+        ++g_bus.iDepth;
+        epicsMutexUnlock(g_bus.hLock);
+        return;
+    }
+    ++g_bus.aiWaiting[iPrio];
+    for (;;)
+    {
+        bool bHigher(false);
+        for (int i = 0; i < iPrio; ++i)
+            if (g_bus.aiWaiting[i] > 0)
+                bHigher = true;
+        if (!g_bus.hOwner && !bHigher)
+            break;
+        epicsMutexUnlock(g_bus.hLock);
+        epicsEventMustWait(g_bus.ahEvent[iPrio]);
+        epicsMutexMustLock(g_bus.hLock);
+    }
+    --g_bus.aiWaiting[iPrio];
+    g_bus.hOwner = hSelf;
+    g_bus.iDepth = 1;
+    qwNow = epicsMonotonicGet();
+    g_bus.qwHoldStart = qwNow;
+    dWait = 1e-9 * static_cast<double>(qwNow - qwStart);
+    ++g_bus.aStat[iPrio].qwCount;
+    g_bus.aStat[iPrio].dWaitSum += dWait;
+    if (dWait > g_bus.aStat[iPrio].dWaitMax)
+        g_bus.aStat[iPrio].dWaitMax = dWait;
+    epicsMutexUnlock(g_bus.hLock);
+}
+
+/**
+ * @brief release the shared bus and wake up the waiting transaction with highest priority
+ * @param[in] iPrio  priority class of the transaction
+ */
+void mccdaqhatsBus::release(Priority iPrio)
+{
+    double dHold;
+    epicsMutexMustLock(g_bus.hLock);
+    if (g_bus.hOwner != epicsThreadGetIdSelf() || --g_bus.iDepth > 0)
+    {
+        epicsMutexUnlock(g_bus.hLock);
+        return;
+    }
+    g_bus.hOwner = static_cast<epicsThreadId>(0);
+    dHold = 1e-9 * static_cast<double>(epicsMonotonicGet() - g_bus.qwHoldStart);
+    g_bus.aStat[iPrio].dHoldSum += dHold;
+    if (dHold > g_bus.aStat[iPrio].dHoldMax)
+        g_bus.aStat[iPrio].dHoldMax = dHold;
+    for (int i = 0; i < PRIO_COUNT; ++i)
+    {
+        if (g_bus.aiWaiting[i] > 0)
+        {
+            epicsEventMustTrigger(g_bus.ahEvent[i]);
+            break;
+        }
+    }
+    epicsMutexUnlock(g_bus.hLock);
+}
+
+/**
+ * @brief get latency statistics of a priority class
+ * @param[in]  iPrio  priority class
+ * @param[out] pStat  statistics
+ * @return true on success
+ */
+bool mccdaqhatsBus::getStatistics(Priority iPrio, struct statistics* pStat)
+{
+    if (iPrio < 0 || iPrio >= PRIO_COUNT || !pStat)
+        return false;
+    busInit();
+    epicsMutexMustLock(g_bus.hLock);
+    *pStat = g_bus.aStat[iPrio];
+    epicsMutexUnlock(g_bus.hLock);
+    return true;
+}
+
+/// @brief clear latency statistics of all priority classes
+void mccdaqhatsBus::resetStatistics()
+{
+    busInit();
+    epicsMutexMustLock(g_bus.hLock);
+    memset(&g_bus.aStat[0], 0, sizeof(g_bus.aStat));
+    epicsMutexUnlock(g_bus.hLock);
+}
+
+/* ========================================================================
+ * bandwidth planner
+ * ======================================================================== */
+
+/**
+ * @brief calibrate the bandwidth model with measured transaction times of a HAT type;
+ *        the median of all measurements is used, single slow transactions (scheduling) do not count
+ * @param[in] wHatID         HAT type
+ * @param[in] adTransaction  measured times of single transactions [s]
+ * @param[in] uCount         number of measurements
+ */
+void mccdaqhatsBus::calibrate(epicsUInt16 wHatID, const double* adTransaction, size_t uCount)
+{
+    int i(busModelIndex(wHatID));
+    std::vector<double> adTime;
+    double dMedian;
+    busInit();
+    if (i < 0 || !adTransaction)
+        return;
+    for (size_t j = 0; j < uCount; ++j)
+        if (adTransaction[j] > 0.)
+            adTime.push_back(adTransaction[j]);
+    if (adTime.empty())
+        return;
+    std::nth_element(adTime.begin(), adTime.begin() + adTime.size() / 2, adTime.end());
+    dMedian = adTime[adTime.size() / 2];
+    if (!(adTime.size() & 1))
+        dMedian = 0.5 * (dMedian + *std::max_element(adTime.begin(), adTime.begin() + adTime.size() / 2));
+    epicsMutexMustLock(g_bus.hLock);
+    g_bus.adTransaction[i] = dMedian;
+    epicsMutexUnlock(g_bus.hLock);
+}
+
+/**
+ * @brief predict the load of a scan
+ * @param[in] wHatID             HAT type
+ * @param[in] dSamplesPerSecond  sum of samples per second of all channels
+ * @return predicted load (1.0 = 100% of bus and CPU time for SPI transfers and de-interleaving)
+ */
+double mccdaqhatsBus::predictLoad(epicsUInt16 wHatID, double dSamplesPerSecond)
+{
+    int i(busModelIndex(wHatID));
+    double dTransaction;
+    busInit();
+    if (i < 0 || !(dSamplesPerSecond > 0.))
+        return 0.;
+    dTransaction = g_bus.adTransaction[i];
+    return dSamplesPerSecond * (8. * g_aBusModel[i].dBytesPerSample / g_aBusModel[i].dBitRate + g_bus.dCpuPerSample)
+         + dSamplesPerSecond / g_aBusModel[i].dSamplesPerBlock * dTransaction;
+}
+
+/**
+ * @brief admission control for a new scan: check the predicted total load of all running scans
+ *        and register this scan, if it is accepted
+ * @param[in]  byAddress          device address (0…MAX_NUMBER_HATS-1)
+ * @param[in]  wHatID             HAT type
+ * @param[in]  dSamplesPerSecond  sum of samples per second of all channels
+ * @param[out] pdTotal            (optional) predicted total load with this scan
+ * @return true, if the total load is within the limit
+ */
+bool mccdaqhatsBus::admit(epicsUInt8 byAddress, epicsUInt16 wHatID, double dSamplesPerSecond, double* pdTotal)
+{
+    double dTotal(predictLoad(wHatID, dSamplesPerSecond));
+    bool bResult;
+    if (byAddress >= MAX_NUMBER_HATS)
+        return false;
+    epicsMutexMustLock(g_bus.hLock);
+    for (int i = 0; i < MAX_NUMBER_HATS; ++i)
+        if (i != byAddress)
+            dTotal += predictLoad(g_bus.awHatID[i], g_bus.adSamples[i]);
+    bResult = (dTotal <= g_bus.dLimit);
+    if (bResult || !g_bus.bRefuse)
+    {
+        g_bus.awHatID[byAddress]   = wHatID;
+        g_bus.adSamples[byAddress] = dSamplesPerSecond;
+    }
+    epicsMutexUnlock(g_bus.hLock);
+    if (pdTotal)
+        *pdTotal = dTotal;
+    return bResult;
+}
+
+/**
+ * @brief register the sample rate of a (running) scan
+ * @param[in] byAddress          device address (0…MAX_NUMBER_HATS-1)
+ * @param[in] wHatID             HAT type
+ * @param[in] dSamplesPerSecond  sum of samples per second of all channels, 0 for stopped scan
+ */
+void mccdaqhatsBus::setBoardLoad(epicsUInt8 byAddress, epicsUInt16 wHatID, double dSamplesPerSecond)
+{
+    busInit();
+    if (byAddress >= MAX_NUMBER_HATS)
+        return;
+    epicsMutexMustLock(g_bus.hLock);
+    g_bus.awHatID[byAddress]   = dSamplesPerSecond > 0. ? wHatID : 0;
+    g_bus.adSamples[byAddress] = dSamplesPerSecond > 0. ? dSamplesPerSecond : 0.;
+    epicsMutexUnlock(g_bus.hLock);
+}
+
+/**
+ * @brief get predicted load of a single scan
+ * @param[in] byAddress  device address (0…MAX_NUMBER_HATS-1)
+ * @return predicted load (1.0 = 100%)
+ */
+double mccdaqhatsBus::getBoardLoad(epicsUInt8 byAddress)
+{
+    double dResult;
+    busInit();
+    if (byAddress >= MAX_NUMBER_HATS)
+        return 0.;
+    epicsMutexMustLock(g_bus.hLock);
+    dResult = predictLoad(g_bus.awHatID[byAddress], g_bus.adSamples[byAddress]);
+    epicsMutexUnlock(g_bus.hLock);
+    return dResult;
+}
+
+/// @brief get predicted total load of all running scans (1.0 = 100%)
+double mccdaqhatsBus::getLoad()
+{
+    double dResult(0.);
+    busInit();
+    epicsMutexMustLock(g_bus.hLock);
+    for (int i = 0; i < MAX_NUMBER_HATS; ++i)
+        dResult += predictLoad(g_bus.awHatID[i], g_bus.adSamples[i]);
+    epicsMutexUnlock(g_bus.hLock);
+    return dResult;
+}
+
+/// @brief set allowed total load (1.0 = 100%)
+void mccdaqhatsBus::setLimit(double dLimit)
+{
+    busInit();
+    epicsMutexMustLock(g_bus.hLock);
+    g_bus.dLimit = dLimit;
+    epicsMutexUnlock(g_bus.hLock);
+}
+
+/// @brief get allowed total load (1.0 = 100%)
+double mccdaqhatsBus::getLimit()
+{
+    double dResult;
+    busInit();
+    epicsMutexMustLock(g_bus.hLock);
+    dResult = g_bus.dLimit;
+    epicsMutexUnlock(g_bus.hLock);
+    return dResult;
+}
+
+/// @brief select, whether an overload refuses (true) or warns (false) on scan start
+void mccdaqhatsBus::setRefuse(bool bRefuse)
+{
+    busInit();
+    epicsMutexMustLock(g_bus.hLock);
+    g_bus.bRefuse = bRefuse;
+    epicsMutexUnlock(g_bus.hLock);
+}
+
+/// @brief get, whether an overload refuses (true) or warns (false) on scan start
+bool mccdaqhatsBus::getRefuse()
+{
+    bool bResult;
+    busInit();
+    epicsMutexMustLock(g_bus.hLock);
+    bResult = g_bus.bRefuse;
+    epicsMutexUnlock(g_bus.hLock);
+    return bResult;
+}
+
+/**
+ * @brief report latency statistics and bandwidth model
+ * @param[in] fp  output file descriptor
+ */
+void mccdaqhatsBus::report(FILE* fp)
+{
+    static const char* aszNames[PRIO_COUNT] = { "stream", "interrupt", "config" };
+    fprintf(fp, "SPI bus scheduler:\n");
+    for (int i = 0; i < PRIO_COUNT; ++i)
+    {
+        struct statistics s;
+        if (!getStatistics(static_cast<Priority>(i), &s))
+            continue;
+        fprintf(fp, "  %-9s count=%llu wait avg=%.1fus max=%.1fus hold avg=%.1fus max=%.1fus\n",
+                aszNames[i], static_cast<unsigned long long>(s.qwCount),
+                s.qwCount ? 1e6 * s.dWaitSum / static_cast<double>(s.qwCount) : 0., 1e6 * s.dWaitMax,
+                s.qwCount ? 1e6 * s.dHoldSum / static_cast<double>(s.qwCount) : 0., 1e6 * s.dHoldMax);
+    }
+    fprintf(fp, "bandwidth model: load=%.1f%% limit=%.1f%% (%s) cpu=%.1fns/sample transaction=%.1f/%.1f/%.1fus\n",
+            100. * getLoad(), 100. * getLimit(), getRefuse() ? "refuse" : "warn", 1e9 * g_bus.dCpuPerSample,
+            1e6 * g_bus.adTransaction[0], 1e6 * g_bus.adTransaction[1], 1e6 * g_bus.adTransaction[2]);
+}
@@ -0,0 +1,66 @@
+/*
+ * SPDX-License-Identifier: EPICS
+ * Helmholtz-Zentrum Berlin fuer Materialien und Energie GmbH 2023-2024
+ * Lutz Rossa <rossa@helmholtz-berlin.de>
+ */
+#ifndef MCCDAQHATSBUS_INCLUDED
+#define MCCDAQHATSBUS_INCLUDED
+
+#include <stdio.h>
+#include <epicsTypes.h>
+
+/// prioritized scheduler for SPI transactions, which is shared by all HATs and controllers
+class mccdaqhatsBus
+{
+public:
+    /// priority classes, lower value means higher priority
+    enum Priority
+    {
+        PRIO_STREAM = 0, ///< draining data of running scans
+        PRIO_INTERRUPT,  ///< interrupt service
+        PRIO_CONFIG,     ///< configuration and slow reads
+        PRIO_COUNT
+    };
+
+    /// latency statistics of a priority class
+    struct statistics
+    {
+        epicsUInt64 qwCount;   ///< number of transactions
+        double      dWaitSum;  ///< sum of wait times in seconds
+        double      dWaitMax;  ///< maximum wait time in seconds
+        double      dHoldSum;  ///< sum of bus hold times in seconds
+        double      dHoldMax;  ///< maximum bus hold time in seconds
+    };
+
+    static void acquire(Priority iPrio);
+    static void release(Priority iPrio);
+    static bool getStatistics(Priority iPrio, struct statistics* pStat);
+    static void resetStatistics();
+    static void report(FILE* fp);
+
+    // bandwidth planner for all running scans
+    static void   calibrate(epicsUInt16 wHatID, const double* adTransaction, size_t uCount);
+    static double predictLoad(epicsUInt16 wHatID, double dSamplesPerSecond);
+    static bool   admit(epicsUInt8 byAddress, epicsUInt16 wHatID, double dSamplesPerSecond, double* pdTotal);
+    static void   setBoardLoad(epicsUInt8 byAddress, epicsUInt16 wHatID, double dSamplesPerSecond);
+    static double getBoardLoad(epicsUInt8 byAddress);
+    static double getLoad();
+    static void   setLimit(double dLimit);
+    static double getLimit();
+    static void   setRefuse(bool bRefuse);
+    static bool   getRefuse();
+};
+
+/// helper class to acquire the bus for the life time of this object
+class mccdaqhatsBusGuard
+{
+public:
+    explicit mccdaqhatsBusGuard(mccdaqhatsBus::Priority iPrio) : m_iPrio(iPrio) { mccdaqhatsBus::acquire(m_iPrio); }
+    ~mccdaqhatsBusGuard() { mccdaqhatsBus::release(m_iPrio); }
+private:
+    mccdaqhatsBus::Priority m_iPrio;
+    mccdaqhatsBusGuard(const mccdaqhatsBusGuard&);
+    mccdaqhatsBusGuard& operator=(const mccdaqhatsBusGuard&);
+};
+
+#endif /*MCCDAQHATSBUS_INCLUDED*/
@@ -0,0 +1,2300 @@
+/*
+ * SPDX-License-Identifier: EPICS
+ * Helmholtz-Zentrum Berlin fuer Materialien und Energie GmbH 2023-2024
+ * Lutz Rossa <rossa@helmholtz-berlin.de>
+ */
+#include <ctype.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <limits>
+#include <epicsMath.h>
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include "mccdaqhatsDsp.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/* ========================================================================
+ * basic kernels
+ * ======================================================================== */
+
+/**
+ * @brief copy every n-th value of an interleaved block
+ * @param[in]  pdIn     interleaved input block
+ * @param[in]  uStride  number of interleaved channels
+ * @param[in]  uOffset  index of channel inside a scan
+ * @param[in]  uCount   number of scans
+ * @param[out] pdOut    channel data
+ */
+void mccdaqhatsDsp::deinterleave(const double* MCC_RESTRICT pdIn, size_t uStride, size_t uOffset, size_t uCount, double* MCC_RESTRICT pdOut)
+{
+    pdIn += uOffset;
+    if (uStride == 1)
+        memcpy(pdOut, pdIn, uCount * sizeof(double));
+    else
+        for (size_t i = 0; i < uCount; ++i)
+            pdOut[i] = pdIn[i * uStride];
+}
+
+/**
+ * @brief sum of values; four independent partial sums allow vectorization without
+ *        relaxed floating point rules
+ * @param[in] pdIn    input values
+ * @param[in] uCount  number of values
+ * @return sum
+ */
+double mccdaqhatsDsp::sum(const double* MCC_RESTRICT pdIn, size_t uCount)
+{
+    double a0(0.), a1(0.), a2(0.), a3(0.);
+    size_t i(0);
+    for (; i + 4 <= uCount; i += 4)
+    {
+        a0 += pdIn[i];
+        a1 += pdIn[i + 1];
+        a2 += pdIn[i + 2];
+        a3 += pdIn[i + 3];
+    }
+    for (; i < uCount; ++i)
+        a0 += pdIn[i];
+    return (a0 + a1) + (a2 + a3);
+}
+
+/**
+ * @brief dot product of two vectors, see \ref mccdaqhatsDsp::sum
+ * @param[in] pdA     1st vector
+ * @param[in] pdB     2nd vector
+ * @param[in] uCount  number of values
+ * @return dot product
+ */
+double mccdaqhatsDsp::dot(const double* MCC_RESTRICT pdA, const double* MCC_RESTRICT pdB, size_t uCount)
+{
+    double a0(0.), a1(0.), a2(0.), a3(0.);
+    size_t i(0);
+    for (; i + 4 <= uCount; i += 4)
+    {
+        a0 += pdA[i]     * pdB[i];
+        a1 += pdA[i + 1] * pdB[i + 1];
+        a2 += pdA[i + 2] * pdB[i + 2];
+        a3 += pdA[i + 3] * pdB[i + 3];
+    }
+    for (; i < uCount; ++i)
+        a0 += pdA[i] * pdB[i];
+    return (a0 + a1) + (a2 + a3);
+}
+
+/* ========================================================================
+ * decimation
+ * ======================================================================== */
+
+/// constructor: disabled decimator
+mccdaqhatsDecimator::mccdaqhatsDecimator()
+    : m_iFactor(1)
+    , m_iType(FILTER_BOXCAR)
+    , m_iPhase(0)
+    , m_dSum(0.)
+    , m_dRange(16.)
+    , m_dScale(1.)
+    , m_dGain(1.)
+{
+    reset();
+}
+
+/**
+ * @brief change factor and filter type, this resets the filter state on changes
+ * @param[in] iFactor  decimation factor, 1=disabled, FILTER_FIR is limited to MAX_FIR_FACTOR
+ * @param[in] iType    filter type (enum \ref FilterType)
+ * @param[in] dRange   CIC: maximum absolute input value (e.g. after unit conversion), values outside are clipped
+ * @return true, if the configuration was changed
+ */
+bool mccdaqhatsDecimator::configure(int iFactor, int iType, double dRange)
+{
+    if (iFactor < 1)
+        iFactor = 1;
+    if (iType < 0 || iType >= FILTER_COUNT)
+        iType = FILTER_BOXCAR;
+    if (iType == FILTER_FIR && iFactor > MAX_FIR_FACTOR)
+        iFactor = MAX_FIR_FACTOR; // a longer filter costs too much, a shorter one aliases
+    if (!(dRange > 0.) || !isfinite(dRange))
+        dRange = 16.;
+    if (iFactor == m_iFactor && iType == m_iType && (iType != FILTER_CIC || dRange == m_dRange))
+        return false;
+    m_iFactor = iFactor;
+    m_iType   = iType;
+    m_dRange  = dRange;
+    m_adTaps.clear();
+    m_adHist.clear();
+    if (m_iFactor > 1 && m_iType == FILTER_CIC)
+    {
+        // the input range needs log2(range) bits (5 bits for ±16 V), the integrators grow by 3*log2(factor) bits:
+        // use the remaining bits as fraction, modulo arithmetic of the integrators is compensated by the combs
+        int iBits(0), iRangeBits(0);
+        while ((1 << iBits) < m_iFactor)
+            ++iBits;
+        frexp(m_dRange, &iRangeBits);
+        m_dScale = ldexp(1., 63 - iRangeBits - 3 * iBits);
+        m_dGain  = 1. / (m_dScale * static_cast<double>(m_iFactor) * static_cast<double>(m_iFactor) * static_cast<double>(m_iFactor));
+    }
+    if (m_iFactor > 1 && m_iType == FILTER_FIR)
+    {
+        // Blackman windowed sinc with cutoff at 80% of the output Nyquist frequency
+        size_t uTaps(8 * static_cast<size_t>(m_iFactor) + 1), uMid;
+        double dCutoff(0.4 / static_cast<double>(m_iFactor)), dSum(0.);
+        uMid = uTaps / 2;
+        m_adTaps.resize(uTaps);
+        for (size_t i = 0; i < uTaps; ++i)
+        {
+            double x(static_cast<double>(i) - static_cast<double>(uMid));
+            double w(0.42 - 0.5 * cos(2. * M_PI * static_cast<double>(i) / static_cast<double>(uTaps - 1))
+                     + 0.08 * cos(4. * M_PI * static_cast<double>(i) / static_cast<double>(uTaps - 1)));
+            double h(i == uMid ? 2. * dCutoff : sin(2. * M_PI * dCutoff * x) / (M_PI * x));
+            m_adTaps[i] = h * w;
+            dSum += m_adTaps[i];
+        }
+        for (size_t i = 0; i < uTaps; ++i)
+            m_adTaps[i] /= dSum;
+        m_adHist.assign(uTaps - 1, 0.);
+    }
+    reset();
+    return true;
+}
+
+/// clear filter state
+void mccdaqhatsDecimator::reset()
+{
+    m_iPhase = m_iFactor;
+    m_dSum   = 0.;
+    for (int i = 0; i < 3; ++i)
+        m_aqwInt[i] = m_aqwComb[i] = 0;
+    if (!m_adTaps.empty())
+        m_adHist.assign(m_adTaps.size() - 1, 0.);
+}
+
+/**
+ * @brief filter and decimate a block of a single channel
+ * @param[in]  pdIn    input samples
+ * @param[in]  uCount  number of input samples
+ * @param[out] adOut   decimated samples (replaced)
+ * @return number of decimated samples
+ */
+size_t mccdaqhatsDecimator::process(const double* pdIn, size_t uCount, std::vector<double>& adOut)
+{
+    size_t uOut(0), uPos(0);
+    adOut.resize((static_cast<size_t>(m_iFactor - m_iPhase) + uCount) / static_cast<size_t>(m_iFactor));
+    if (m_iFactor <= 1)
+    {
+        adOut.assign(pdIn, pdIn + uCount);
+        return uCount;
+    }
+    switch (m_iType)
+    {
+        case FILTER_BOXCAR:
+            while (uPos < uCount)
+            {
+                size_t uTake(static_cast<size_t>(m_iPhase));
+                if (uTake > uCount - uPos)
+                    uTake = uCount - uPos;
+                m_dSum   += mccdaqhatsDsp::sum(&pdIn[uPos], uTake);
+                m_iPhase -= static_cast<int>(uTake);
+                uPos     += uTake;
+                if (!m_iPhase)
+                {
+                    adOut[uOut++] = m_dSum / static_cast<double>(m_iFactor);
+                    m_dSum   = 0.;
+                    m_iPhase = m_iFactor;
+                }
+            }
+            break;
+        case FILTER_CIC:
+            // the integrators are a recursion, only the combs run at the output rate
+            for (; uPos < uCount; ++uPos)
+            {
+                double x(pdIn[uPos]);
+                if (!(x > -m_dRange)) x = -m_dRange; // also NaN
+                if (x > m_dRange) x = m_dRange;
+                m_aqwInt[0] += static_cast<epicsUInt64>(static_cast<epicsInt64>(x * m_dScale));
+                m_aqwInt[1] += m_aqwInt[0];
+                m_aqwInt[2] += m_aqwInt[1];
+                if (--m_iPhase)
+                    continue;
+                epicsUInt64 c(m_aqwInt[2]);
+                for (int i = 0; i < 3; ++i)
+                {
+                    epicsUInt64 d(c - m_aqwComb[i]);
+                    m_aqwComb[i] = c;
+                    c = d;
+                }
+                adOut[uOut++] = static_cast<double>(static_cast<epicsInt64>(c)) * m_dGain;
+                m_iPhase = m_iFactor;
+            }
+            break;
+        case FILTER_FIR:
+        {
+            // history and block are linear in memory, outputs are computed at the decimated positions only
+            size_t uTaps(m_adTaps.size()), uHist(uTaps - 1), uEnd;
+            m_adHist.insert(m_adHist.end(), pdIn, pdIn + uCount);
+            uEnd = uHist + static_cast<size_t>(m_iPhase) - 1; // last input sample of next output
+            for (; uEnd < m_adHist.size(); uEnd += static_cast<size_t>(m_iFactor))
+                adOut[uOut++] = mccdaqhatsDsp::dot(&m_adHist[uEnd + 1 - uTaps], &m_adTaps[0], uTaps);
+            m_iPhase = static_cast<int>(uEnd + 1 - m_adHist.size());
+            m_adHist.erase(m_adHist.begin(), m_adHist.end() - static_cast<std::ptrdiff_t>(uHist));
+            break;
+        }
+    }
+    adOut.resize(uOut);
+    return uOut;
+}
+
+/* ========================================================================
+ * statistics
+ * ======================================================================== */
+
+/// maximum window length of sliding statistics
+#define MAX_STAT_WINDOW 1000000
+
+/**
+ * @brief sum of squared deviations from a mean (2nd pass of a two pass variance),
+ *        see \ref mccdaqhatsDsp::sum
+ * @param[in] pdIn    input values
+ * @param[in] uCount  number of values
+ * @param[in] dMean   mean of input values
+ * @return sum of squared deviations
+ */
+double mccdaqhatsDsp::sumsqdev(const double* MCC_RESTRICT pdIn, size_t uCount, double dMean)
+{
+    double a0(0.), a1(0.), a2(0.), a3(0.);
+    size_t i(0);
+    for (; i + 4 <= uCount; i += 4)
+    {
+        double d0(pdIn[i] - dMean), d1(pdIn[i + 1] - dMean), d2(pdIn[i + 2] - dMean), d3(pdIn[i + 3] - dMean);
+        a0 += d0 * d0;
+        a1 += d1 * d1;
+        a2 += d2 * d2;
+        a3 += d3 * d3;
+    }
+    for (; i < uCount; ++i)
+        a0 += (pdIn[i] - dMean) * (pdIn[i] - dMean);
+    return (a0 + a1) + (a2 + a3);
+}
+
+/**
+ * @brief minimum and maximum of values, see \ref mccdaqhatsDsp::sum
+ * @param[in]     pdIn    input values
+ * @param[in]     uCount  number of values
+ * @param[in,out] dMin    minimum (initial value is included)
+ * @param[in,out] dMax    maximum (initial value is included)
+ */
+void mccdaqhatsDsp::minmax(const double* MCC_RESTRICT pdIn, size_t uCount, double& dMin, double& dMax)
+{
+    double n0(dMin), n1(dMin), n2(dMin), n3(dMin), x0(dMax), x1(dMax), x2(dMax), x3(dMax);
+    size_t i(0);
+    for (; i + 4 <= uCount; i += 4)
+    {
+        n0 = pdIn[i]     < n0 ? pdIn[i]     : n0;
+        n1 = pdIn[i + 1] < n1 ? pdIn[i + 1] : n1;
+        n2 = pdIn[i + 2] < n2 ? pdIn[i + 2] : n2;
+        n3 = pdIn[i + 3] < n3 ? pdIn[i + 3] : n3;
+        x0 = pdIn[i]     > x0 ? pdIn[i]     : x0;
+        x1 = pdIn[i + 1] > x1 ? pdIn[i + 1] : x1;
+        x2 = pdIn[i + 2] > x2 ? pdIn[i + 2] : x2;
+        x3 = pdIn[i + 3] > x3 ? pdIn[i + 3] : x3;
+    }
+    for (; i < uCount; ++i)
+    {
+        n0 = pdIn[i] < n0 ? pdIn[i] : n0;
+        x0 = pdIn[i] > x0 ? pdIn[i] : x0;
+    }
+    n0 = n1 < n0 ? n1 : n0;
+    n2 = n3 < n2 ? n3 : n2;
+    dMin = n2 < n0 ? n2 : n0;
+    x0 = x1 > x0 ? x1 : x0;
+    x2 = x3 > x2 ? x3 : x2;
+    dMax = x2 > x0 ? x2 : x0;
+}
+
+/// constructor: disabled statistics
+mccdaqhatsStatistics::mccdaqhatsStatistics()
+    : m_iMode(STAT_OFF)
+    , m_dwWindow(1)
+    , m_bNext(true)
+{
+    reset();
+}
+
+/**
+ * @brief change mode and window length, this resets the accumulators on changes
+ * @param[in] iMode    statistics window (enum \ref StatMode)
+ * @param[in] iWindow  window length of sliding statistics
+ * @return true, if the configuration was changed
+ */
+bool mccdaqhatsStatistics::configure(int iMode, int iWindow)
+{
+    if (iMode < 0 || iMode >= STAT_COUNT)
+        iMode = STAT_OFF;
+    if (iWindow < 2)
+        iWindow = 2;
+    if (iWindow > MAX_STAT_WINDOW)
+        iWindow = MAX_STAT_WINDOW;
+    if (iMode != STAT_SLIDING)
+        iWindow = static_cast<int>(m_dwWindow); // not used
+    if (iMode == m_iMode && static_cast<epicsUInt32>(iWindow) == m_dwWindow)
+        return false;
+    m_iMode    = iMode;
+    m_dwWindow = static_cast<epicsUInt32>(iWindow);
+    if (m_iMode == STAT_SLIDING)
+    {
+        m_adRing.assign(m_dwWindow, 0.);
+        m_aQueue[0].resize(m_dwWindow);
+        m_aQueue[1].resize(m_dwWindow);
+    }
+    else
+    {
+        std::vector<double>().swap(m_adRing);
+        std::vector<QueueEntry>().swap(m_aQueue[0]);
+        std::vector<QueueEntry>().swap(m_aQueue[1]);
+    }
+    reset();
+    return true;
+}
+
+/// clear accumulators
+void mccdaqhatsStatistics::reset()
+{
+    m_qwCount  = 0;
+    m_dMean    = 0.;
+    m_dM2      = 0.;
+    m_dMin     = std::numeric_limits<double>::infinity();
+    m_dMax     = -std::numeric_limits<double>::infinity();
+    m_dwPos    = 0;
+    m_dwIndex  = 0;
+    m_dwRecalc = m_dwWindow;
+    m_adwQHead[0] = m_adwQHead[1] = m_adwQCount[0] = m_adwQCount[1] = 0;
+}
+
+/**
+ * @brief add statistics of a block of data (parallel algorithm of Chan et al.)
+ * @param[in] qwCount  number of samples of block
+ * @param[in] dMean    mean of block
+ * @param[in] dM2      sum of squared deviations of block
+ * @param[in] dMin     minimum of block
+ * @param[in] dMax     maximum of block
+ */
+void mccdaqhatsStatistics::merge(epicsUInt64 qwCount, double dMean, double dM2, double dMin, double dMax)
+{
+    double dCountA(static_cast<double>(m_qwCount)), dCountB(static_cast<double>(qwCount));
+    double dDelta(dMean - m_dMean), dCount(dCountA + dCountB);
+    if (!qwCount)
+        return;
+    m_dMean   += dDelta * dCountB / dCount;
+    m_dM2     += dM2 + dDelta * dDelta * dCountA * dCountB / dCount;
+    m_qwCount += qwCount;
+    if (dMin < m_dMin) m_dMin = dMin;
+    if (dMax > m_dMax) m_dMax = dMax;
+}
+
+/**
+ * @brief add a single sample to the sliding window: Welford update for adding the new
+ *        and removing the oldest sample, monotonic queues for minimum and maximum
+ * @param[in] dValue  new sample
+ */
+void mccdaqhatsStatistics::slide(double dValue)
+{
+    epicsUInt32 dwIdx(m_dwIndex++);
+    if (m_qwCount < m_dwWindow)
+    {
+        double dDelta(dValue - m_dMean);
+        ++m_qwCount;
+        m_dMean += dDelta / static_cast<double>(m_qwCount);
+        m_dM2   += dDelta * (dValue - m_dMean);
+    }
+    else
+    {
+        double dOld(m_adRing[m_dwPos]);
+        double dMean(m_dMean + (dValue - dOld) / static_cast<double>(m_dwWindow));
+        m_dM2  += (dValue - dOld) * ((dValue - dMean) + (dOld - m_dMean));
+        m_dMean = dMean;
+        if (m_dM2 < 0.)
+            m_dM2 = 0.;
+    }
+    m_adRing[m_dwPos] = dValue;
+    if (++m_dwPos >= m_dwWindow)
+        m_dwPos = 0;
+    if (m_qwCount >= m_dwWindow && !--m_dwRecalc)
+        recalc();
+    for (int i = 0; i < 2; ++i)
+    {
+        std::vector<QueueEntry>& q(m_aQueue[i]);
+        epicsUInt32& dwHead(m_adwQHead[i]);
+        epicsUInt32& dwCount(m_adwQCount[i]);
+        // drop samples outside of window (modulo arithmetic of index)
+        while (dwCount && static_cast<epicsUInt32>(dwIdx - q[dwHead].dwIdx) >= m_dwWindow)
+        {
+            if (++dwHead >= m_dwWindow)
+                dwHead = 0;
+            --dwCount;
+        }
+        // drop samples, which cannot become minimum (maximum) anymore
+        while (dwCount)
+        {
+            epicsUInt32 dwLast((dwHead + dwCount - 1) % m_dwWindow);
+            if (i ? (q[dwLast].dValue > dValue) : (q[dwLast].dValue < dValue))
+                break;
+            --dwCount;
+        }
+        q[(dwHead + dwCount) % m_dwWindow].dValue = dValue;
+        q[(dwHead + dwCount) % m_dwWindow].dwIdx  = dwIdx;
+        ++dwCount;
+    }
+}
+
+/// sliding: exact recalculation of mean and variance once per window to limit rounding errors
+void mccdaqhatsStatistics::recalc()
+{
+    m_dMean    = mccdaqhatsDsp::sum(&m_adRing[0], m_dwWindow) / static_cast<double>(m_dwWindow);
+    m_dM2      = mccdaqhatsDsp::sumsqdev(&m_adRing[0], m_dwWindow, m_dMean);
+    m_dwRecalc = m_dwWindow;
+}
+
+/**
+ * @brief add a block of a single channel and calculate the statistics
+ * @param[in]  pdIn    input samples
+ * @param[in]  uCount  number of input samples
+ * @param[out] result  statistics of the window
+ * @return true, if the result is valid
+ */
+bool mccdaqhatsStatistics::process(const double* pdIn, size_t uCount, Result& result)
+{
+    switch (m_iMode)
+    {
+        case STAT_BLOCK:
+            // the window covers all blocks since the last result was used
+            if (m_bNext)
+                reset();
+            m_bNext = false;
+            // fall through
+        case STAT_CUMULATIVE:
+            if (uCount)
+            {
+                double dMean(mccdaqhatsDsp::sum(pdIn, uCount) / static_cast<double>(uCount));
+                double dMin(std::numeric_limits<double>::infinity()), dMax(-std::numeric_limits<double>::infinity());
+                mccdaqhatsDsp::minmax(pdIn, uCount, dMin, dMax);
+                merge(uCount, dMean, mccdaqhatsDsp::sumsqdev(pdIn, uCount, dMean), dMin, dMax);
+            }
+            break;
+        case STAT_SLIDING:
+            for (size_t i = 0; i < uCount; ++i)
+                slide(pdIn[i]);
+            if (m_adwQCount[0] && m_adwQCount[1])
+            {
+                m_dMin = m_aQueue[0][m_adwQHead[0]].dValue;
+                m_dMax = m_aQueue[1][m_adwQHead[1]].dValue;
+            }
+            break;
+        default:
+            return false;
+    }
+    if (!m_qwCount)
+        return false;
+    result.qwCount = m_qwCount;
+    result.dMean   = m_dMean;
+    result.dMin    = m_dMin;
+    result.dMax    = m_dMax;
+    result.dRms    = sqrt(m_dMean * m_dMean + m_dM2 / static_cast<double>(m_qwCount));
+    result.dStd    = (m_qwCount > 1) ? sqrt(m_dM2 / static_cast<double>(m_qwCount - 1)) : 0.;
+    return true;
+}
+
+/* ========================================================================
+ * spectrum
+ * ======================================================================== */
+
+/// minimum and maximum FFT size
+#define MIN_FFT_SIZE 64
+#define MAX_FFT_SIZE 16384
+
+/// constructor: disabled spectrum
+mccdaqhatsSpectrum::mccdaqhatsSpectrum()
+    : m_iOutput(OUTPUT_OFF)
+    , m_iWindow(WINDOW_RECT)
+    , m_iOverlap(0)
+    , m_iAverages(1)
+    , m_uSize(0)
+    , m_uHop(0)
+    , m_uFill(0)
+    , m_iCount(0)
+    , m_dWinSum(1.)
+    , m_dWinSum2(1.)
+{
+}
+
+/**
+ * @brief change the spectrum configuration, this allocates all buffers and resets the
+ *        averaging on changes
+ * @param[in] iOutput    output type (enum \ref OutputType)
+ * @param[in] iSize      FFT size, power of two
+ * @param[in] iWindow    window function (enum \ref WindowType)
+ * @param[in] iOverlap   segment overlap in percent (0…90)
+ * @param[in] iAverages  number of averaged segments (Welch)
+ * @return true, if the configuration was changed
+ */
+bool mccdaqhatsSpectrum::configure(int iOutput, int iSize, int iWindow, int iOverlap, int iAverages)
+{
+    size_t uSize(MIN_FFT_SIZE), uHalf;
+    if (iOutput < 0 || iOutput >= OUTPUT_COUNT)
+        iOutput = OUTPUT_OFF;
+    while (uSize < MAX_FFT_SIZE && static_cast<int>(uSize) < iSize)
+        uSize *= 2;
+    if (iWindow < 0 || iWindow >= WINDOW_COUNT)
+        iWindow = WINDOW_HANN;
+    if (iOverlap < 0)  iOverlap = 0;
+    if (iOverlap > 90) iOverlap = 90;
+    if (iAverages < 1) iAverages = 1;
+    if (iOutput == OUTPUT_OFF)
+        uSize = 0;
+    if (iOutput == m_iOutput && uSize == m_uSize && iWindow == m_iWindow && iOverlap == m_iOverlap && iAverages == m_iAverages)
+        return false;
+    m_iOutput   = iOutput;
+    m_uSize     = uSize;
+    m_iWindow   = iWindow;
+    m_iOverlap  = iOverlap;
+    m_iAverages = iAverages;
+    if (!m_uSize)
+    {
+        std::vector<double>().swap(m_adInput);
+        std::vector<double>().swap(m_adWindow);
+        std::vector<double>().swap(m_adRe);
+        std::vector<double>().swap(m_adIm);
+        std::vector<double>().swap(m_adCos);
+        std::vector<double>().swap(m_adSin);
+        std::vector<epicsUInt32>().swap(m_adwRev);
+        std::vector<double>().swap(m_adPower);
+        reset();
+        return true;
+    }
+    uHalf  = m_uSize / 2;
+    m_uHop = m_uSize - (m_uSize * static_cast<size_t>(m_iOverlap)) / 100;
+    m_adInput.assign(m_uSize, 0.);
+    m_adRe.assign(uHalf, 0.);
+    m_adIm.assign(uHalf, 0.);
+    m_adPower.assign(uHalf + 1, 0.);
+
+    // window function
+    m_adWindow.resize(m_uSize);
+    m_dWinSum = m_dWinSum2 = 0.;
+    for (size_t i = 0; i < m_uSize; ++i)
+    {
+        double x(2. * M_PI * static_cast<double>(i) / static_cast<double>(m_uSize)); // periodic window
+        switch (m_iWindow)
+        {
+            case WINDOW_HANN:     m_adWindow[i] = 0.5 - 0.5 * cos(x); break;
+            case WINDOW_HAMMING:  m_adWindow[i] = 0.54 - 0.46 * cos(x); break;
+            case WINDOW_BLACKMAN: m_adWindow[i] = 0.42 - 0.5 * cos(x) + 0.08 * cos(2. * x); break;
+            default:              m_adWindow[i] = 1.; break;
+        }
+        m_dWinSum  += m_adWindow[i];
+        m_dWinSum2 += m_adWindow[i] * m_adWindow[i];
+    }
+
+    // twiddle factors exp(-2πik/N) for k < N/2, the N/2 point FFT uses every 2nd one
+    m_adCos.resize(uHalf);
+    m_adSin.resize(uHalf);
+    for (size_t i = 0; i < uHalf; ++i)
+    {
+        m_adCos[i] = cos(2. * M_PI * static_cast<double>(i) / static_cast<double>(m_uSize));
+        m_adSin[i] = -sin(2. * M_PI * static_cast<double>(i) / static_cast<double>(m_uSize));
+    }
+
+    // bit reversal permutation of N/2 point FFT
+    m_adwRev.resize(uHalf);
+    for (size_t i = 0, j = 0; i < uHalf; ++i)
+    {
+        m_adwRev[i] = static_cast<epicsUInt32>(j);
+        for (size_t uBit = uHalf >> 1; uBit; uBit >>= 1)
+        {
+            j ^= uBit;
+            if (j & uBit)
+                break;
+        }
+    }
+    reset();
+    return true;
+}
+
+/// clear input buffer and averaging
+void mccdaqhatsSpectrum::reset()
+{
+    m_uFill  = 0;
+    m_iCount = 0;
+    if (!m_adPower.empty())
+        memset(&m_adPower[0], 0, m_adPower.size() * sizeof(m_adPower[0]));
+}
+
+/**
+ * @brief windowed real FFT of "m_adInput" by a complex FFT of half size,
+ *        the power of every bin is added to "m_adPower"
+ */
+void mccdaqhatsSpectrum::transform()
+{
+    size_t uHalf(m_uSize / 2);
+    double* MCC_RESTRICT pdRe(&m_adRe[0]);
+    double* MCC_RESTRICT pdIm(&m_adIm[0]);
+    const double* MCC_RESTRICT pdCos(&m_adCos[0]);
+    const double* MCC_RESTRICT pdSin(&m_adSin[0]);
+
+    // pack even/odd samples into real/imaginary part in bit reversed order
+    for (size_t i = 0; i < uHalf; ++i)
+    {
+        size_t j(m_adwRev[i]);
+        pdRe[j] = m_adInput[2 * i] * m_adWindow[2 * i];
+        pdIm[j] = m_adInput[2 * i + 1] * m_adWindow[2 * i + 1];
+    }
+
+    // iterative radix-2 butterflies
+    for (size_t uLen = 2; uLen <= uHalf; uLen *= 2)
+    {
+        size_t uStep(m_uSize / uLen), uMid(uLen / 2);
+        for (size_t uBase = 0; uBase < uHalf; uBase += uLen)
+        {
+            double* MCC_RESTRICT pdRe0(pdRe + uBase);
+            double* MCC_RESTRICT pdIm0(pdIm + uBase);
+            double* MCC_RESTRICT pdRe1(pdRe + uBase + uMid);
+            double* MCC_RESTRICT pdIm1(pdIm + uBase + uMid);
+            for (size_t k = 0; k < uMid; ++k)
+            {
+                double c(pdCos[k * uStep]), s(pdSin[k * uStep]);
+                double tr(pdRe1[k] * c - pdIm1[k] * s);
+                double ti(pdRe1[k] * s + pdIm1[k] * c);
+                pdRe1[k] = pdRe0[k] - tr;
+                pdIm1[k] = pdIm0[k] - ti;
+                pdRe0[k] += tr;
+                pdIm0[k] += ti;
+            }
+        }
+    }
+
+    // split into spectrum of the real input: X[k] = E[k] + W^k O[k]
+    for (size_t k = 0; k <= uHalf; ++k)
+    {
+        size_t a(k % uHalf), b((uHalf - k) % uHalf);
+        double dEr(0.5 * (pdRe[a] + pdRe[b])), dEi(0.5 * (pdIm[a] - pdIm[b]));
+        double dOr(0.5 * (pdIm[a] + pdIm[b])), dOi(-0.5 * (pdRe[a] - pdRe[b]));
+        double c(k < uHalf ? pdCos[k] : -1.), s(k < uHalf ? pdSin[k] : 0.);
+        double dXr(dEr + dOr * c - dOi * s), dXi(dEi + dOr * s + dOi * c);
+        m_adPower[k] += dXr * dXr + dXi * dXi;
+    }
+}
+
+/**
+ * @brief add a block of a single channel and calculate a spectrum after
+ *        every "averages" segments
+ * @param[in]  pdIn    input samples
+ * @param[in]  uCount  number of input samples
+ * @param[in]  dRate   sample rate in Hz (for PSD scaling)
+ * @param[out] adOut   last complete spectrum with N/2+1 bins
+ * @return true, if a new spectrum is available
+ */
+bool mccdaqhatsSpectrum::process(const double* pdIn, size_t uCount, double dRate, std::vector<double>& adOut)
+{
+    bool bResult(false);
+    if (!m_uSize)
+        return false;
+    while (uCount)
+    {
+        size_t uTake(m_uSize - m_uFill);
+        if (uTake > uCount)
+            uTake = uCount;
+        memcpy(&m_adInput[m_uFill], pdIn, uTake * sizeof(double));
+        m_uFill += uTake;
+        pdIn    += uTake;
+        uCount  -= uTake;
+        if (m_uFill < m_uSize)
+            break;
+        transform();
+        memmove(&m_adInput[0], &m_adInput[m_uHop], (m_uSize - m_uHop) * sizeof(double));
+        m_uFill = m_uSize - m_uHop;
+        if (++m_iCount < m_iAverages)
+            continue;
+
+        // scale averaged power to one-sided spectrum
+        size_t uBins(bins());
+        double dScale;
+        if (m_iOutput == OUTPUT_PSD)
+            dScale = (dRate > 0.) ? (2. / (dRate * m_dWinSum2 * static_cast<double>(m_iCount))) : 0.;
+        else
+            dScale = 4. / (m_dWinSum * m_dWinSum * static_cast<double>(m_iCount));
+        adOut.resize(uBins);
+        for (size_t k = 0; k < uBins; ++k)
+        {
+            // DC and Nyquist bins have no negative frequency counterpart
+            if (k == 0 || k == uBins - 1)
+                adOut[k] = (m_iOutput == OUTPUT_PSD) ? (0.5 * dScale * m_adPower[k]) : sqrt(0.25 * dScale * m_adPower[k]);
+            else
+                adOut[k] = (m_iOutput == OUTPUT_PSD) ? (dScale * m_adPower[k]) : sqrt(dScale * m_adPower[k]);
+        }
+        memset(&m_adPower[0], 0, m_adPower.size() * sizeof(m_adPower[0]));
+        m_iCount = 0;
+        bResult  = true;
+    }
+    return bResult;
+}
+
+/**
+ * @brief frequency axis of the spectrum
+ * @param[in]  dRate  sample rate in Hz
+ * @param[out] adOut  frequency of every bin in Hz
+ */
+void mccdaqhatsSpectrum::frequencies(double dRate, std::vector<double>& adOut) const
+{
+    adOut.resize(m_uSize ? bins() : 0);
+    for (size_t k = 0; k < adOut.size(); ++k)
+        adOut[k] = dRate * static_cast<double>(k) / static_cast<double>(m_uSize);
+}
+
+/* ========================================================================
+ * oscilloscope
+ * ======================================================================== */
+
+/// maximum number of samples before and after trigger
+#define MAX_SCOPE_LENGTH 10000
+
+/// constructor: disabled scope
+mccdaqhatsScope::mccdaqhatsScope()
+    : m_iMode(SCOPE_OFF)
+    , m_iSource(0)
+    , m_dLevel(0.)
+    , m_iSlope(SLOPE_RISING)
+    , m_dHyst(0.)
+    , m_uPre(0)
+    , m_uPost(0)
+    , m_uLength(0)
+    , m_iState(STATE_IDLE)
+    , m_dwCount(0)
+{
+    reset();
+}
+
+/**
+ * @brief change the trigger configuration, this allocates all buffers and re-arms on changes
+ * @param[in] iMode    trigger mode (enum \ref ScopeMode)
+ * @param[in] iSource  trigger channel (0…7)
+ * @param[in] dLevel   trigger level
+ * @param[in] iSlope   trigger slope (enum \ref ScopeSlope)
+ * @param[in] dHyst    hysteresis: the signal has to be this far on the other side of the level before a trigger
+ * @param[in] iPre     number of samples before trigger
+ * @param[in] iPost    number of samples from trigger on
+ * @return true, if the configuration was changed
+ */
+bool mccdaqhatsScope::configure(int iMode, int iSource, double dLevel, int iSlope, double dHyst, int iPre, int iPost)
+{
+    size_t uPre, uPost;
+    if (iMode < 0 || iMode >= SCOPE_MODES)
+        iMode = SCOPE_OFF;
+    if (iSource < 0 || iSource > 7)
+        iSource = 0;
+    if (!isfinite(dLevel))
+        dLevel = 0.;
+    if (!isfinite(dHyst) || dHyst < 0.)
+        dHyst = 0.;
+    iSlope = iSlope ? SLOPE_FALLING : SLOPE_RISING;
+    uPre  = static_cast<size_t>(iPre < 0 ? 0 : (iPre > MAX_SCOPE_LENGTH ? MAX_SCOPE_LENGTH : iPre));
+    uPost = static_cast<size_t>(iPost < 1 ? 1 : (iPost > MAX_SCOPE_LENGTH ? MAX_SCOPE_LENGTH : iPost));
+    if (iMode == m_iMode && iSource == m_iSource && dLevel == m_dLevel && iSlope == m_iSlope &&
+        dHyst == m_dHyst && uPre == m_uPre && uPost == m_uPost)
+        return false;
+    m_iMode   = iMode;
+    m_iSource = iSource;
+    m_dLevel  = dLevel;
+    m_iSlope  = iSlope;
+    m_dHyst   = dHyst;
+    if (uPre != m_uPre || uPost != m_uPost || (m_iMode == SCOPE_OFF) != (m_uLength == 0))
+    {
+        m_uPre    = uPre;
+        m_uPost   = uPost;
+        m_uLength = (m_iMode == SCOPE_OFF) ? 0 : (m_uPre + m_uPost);
+        for (int i = 0; i < 8; ++i)
+        {
+            if (m_uLength)
+            {
+                m_adRing[i].assign(m_uLength, 0.);
+                m_adCapture[i].assign(m_uLength, 0.);
+            }
+            else
+            {
+                std::vector<double>().swap(m_adRing[i]);
+                std::vector<double>().swap(m_adCapture[i]);
+            }
+        }
+    }
+    reset();
+    return true;
+}
+
+/// clear pre-trigger history and re-arm
+void mccdaqhatsScope::reset()
+{
+    m_uWrite = m_uValid = 0;
+    arm();
+}
+
+/// arm trigger, this is needed for single mode after a capture
+void mccdaqhatsScope::arm()
+{
+    m_iState  = (m_iMode == SCOPE_OFF) ? STATE_IDLE : STATE_WAITING;
+    m_bArmed  = false;
+    m_uRemain = 0;
+    m_uWait   = 0;
+}
+
+/**
+ * @brief copy samples of all channels into the rings
+ * @param[in] apdIn   input samples of every channel or nullptr
+ * @param[in] uPos    first sample
+ * @param[in] uCount  number of samples
+ */
+void mccdaqhatsScope::push(const double* const apdIn[8], size_t uPos, size_t uCount)
+{
+    size_t uWrite(m_uWrite);
+    if (uCount > m_uLength)
+    {
+        // older samples would be overwritten inside this call
+        uPos  += uCount - m_uLength;
+        uCount = m_uLength;
+    }
+    for (int i = 0; i < 8; ++i)
+    {
+        size_t uFirst(m_uLength - m_uWrite);
+        double* pdRing(&m_adRing[i][0]);
+        if (uFirst > uCount)
+            uFirst = uCount;
+        if (!apdIn[i])
+        {
+            memset(&pdRing[m_uWrite], 0, uFirst * sizeof(double));
+            memset(pdRing, 0, (uCount - uFirst) * sizeof(double));
+            continue;
+        }
+        memcpy(&pdRing[m_uWrite], &apdIn[i][uPos], uFirst * sizeof(double));
+        memcpy(pdRing, &apdIn[i][uPos + uFirst], (uCount - uFirst) * sizeof(double));
+    }
+    uWrite += uCount;
+    if (uWrite >= m_uLength)
+        uWrite -= m_uLength;
+    m_uWrite = uWrite;
+    m_uValid = (m_uValid + uCount > m_uLength) ? m_uLength : (m_uValid + uCount);
+}
+
+/// linearize the rings into the capture buffers, the oldest sample is at the write position
+void mccdaqhatsScope::finish()
+{
+    for (int i = 0; i < 8; ++i)
+    {
+        memcpy(&m_adCapture[i][0], &m_adRing[i][m_uWrite], (m_uLength - m_uWrite) * sizeof(double));
+        memcpy(&m_adCapture[i][m_uLength - m_uWrite], &m_adRing[i][0], m_uWrite * sizeof(double));
+    }
+    ++m_dwCount;
+    if (m_iMode == SCOPE_SINGLE)
+    {
+        m_iState = STATE_DONE;
+        return;
+    }
+    arm();
+}
+
+/**
+ * @brief add a block of all channels, search triggers and complete captures;
+ *        this does not allocate memory
+ * @param[in] apdIn   input samples of every channel or nullptr for disabled channels
+ * @param[in] uCount  number of samples per channel
+ * @return true, if a new capture is available (the last one of this block)
+ */
+bool mccdaqhatsScope::process(const double* const apdIn[8], size_t uCount)
+{
+    bool bResult(false);
+    size_t uPos(0);
+    if (!m_uLength)
+        return false;
+    while (uPos < uCount)
+    {
+        switch (m_iState)
+        {
+            case STATE_WAITING:
+            {
+                const double* pdTrig(apdIn[m_iSource]);
+                double dLow(m_dLevel - m_dHyst), dHigh(m_dLevel + m_dHyst);
+                size_t i(uPos), uFound(uCount);
+                // the pre-trigger history has to be filled first
+                if (m_uValid < m_uPre)
+                    i += (m_uPre - m_uValid < uCount - uPos) ? (m_uPre - m_uValid) : (uCount - uPos);
+                for (; i < uCount; ++i)
+                {
+                    if (pdTrig)
+                    {
+                        double x(pdTrig[i]);
+                        if (m_iSlope == SLOPE_RISING)
+                        {
+                            if (x < dLow)
+                                m_bArmed = true;
+                            else if (m_bArmed && x >= m_dLevel)
+                            {
+                                uFound = i;
+                                break;
+                            }
+                        }
+                        else
+                        {
+                            if (x > dHigh)
+                                m_bArmed = true;
+                            else if (m_bArmed && x <= m_dLevel)
+                            {
+                                uFound = i;
+                                break;
+                            }
+                        }
+                    }
+                    if (m_iMode == SCOPE_AUTO && ++m_uWait >= m_uLength)
+                    {
+                        uFound = i; // forced capture
+                        break;
+                    }
+                }
+                if (uFound >= uCount)
+                {
+                    push(apdIn, uPos, uCount - uPos);
+                    uPos = uCount;
+                    break;
+                }
+                // the trigger sample is the 1st sample after the pre-trigger history
+                push(apdIn, uPos, uFound + 1 - uPos);
+                uPos      = uFound + 1;
+                m_iState  = STATE_TRIGGERED;
+                m_uRemain = m_uPost - 1;
+                if (!m_uRemain)
+                {
+                    finish();
+                    bResult = true;
+                }
+                break;
+            }
+            case STATE_TRIGGERED:
+            {
+                size_t uTake(m_uRemain < uCount - uPos ? m_uRemain : (uCount - uPos));
+                push(apdIn, uPos, uTake);
+                uPos      += uTake;
+                m_uRemain -= uTake;
+                if (!m_uRemain)
+                {
+                    finish();
+                    bResult = true;
+                }
+                break;
+            }
+            default:
+                // keep the history only
+                push(apdIn, uPos, uCount - uPos);
+                uPos = uCount;
+                break;
+        }
+    }
+    return bResult;
+}
+
+/* ========================================================================
+ * history
+ * ======================================================================== */
+
+/// maximum history length in samples
+#define MAX_HISTORY_LENGTH 4000000
+
+/// constructor: disabled history
+mccdaqhatsHistory::mccdaqhatsHistory()
+    : m_pdBase(nullptr)
+    , m_uCapacity(0)
+    , m_uLength(0)
+    , m_uWrite(0)
+    , m_uFill(0)
+    , m_bMirror(false)
+{
+}
+
+/// destructor: free buffers
+mccdaqhatsHistory::~mccdaqhatsHistory()
+{
+    release();
+}
+
+/// free buffers
+void mccdaqhatsHistory::release()
+{
+#if defined(__linux__)
+    if (m_bMirror && m_pdBase)
+        munmap(m_pdBase, 2 * m_uCapacity * sizeof(double));
+#endif
+    std::vector<double>().swap(m_adFallback);
+    m_pdBase    = nullptr;
+    m_uCapacity = 0;
+    m_bMirror   = false;
+}
+
+/**
+ * @brief change the history length, this reallocates and clears the history on changes
+ * @param[in] uLength  number of samples, 0=disabled
+ * @param[in] bMirror  false: always use the buffer of double size (tests)
+ * @return true, if the configuration was changed
+ */
+bool mccdaqhatsHistory::configure(size_t uLength, bool bMirror)
+{
+    size_t uBytes(0);
+    if (uLength > MAX_HISTORY_LENGTH)
+        uLength = MAX_HISTORY_LENGTH;
+    if (uLength == m_uLength && (bMirror || !m_bMirror))
+        return false;
+    release();
+    m_uLength = uLength;
+    reset();
+    if (!m_uLength)
+        return true;
+#if defined(__linux__) && defined(SYS_memfd_create)
+    if (bMirror)
+    {
+        // map the same anonymous file twice behind each other
+        size_t uPage(static_cast<size_t>(sysconf(_SC_PAGESIZE)));
+        int iFD(static_cast<int>(syscall(SYS_memfd_create, "mccdaqhats", 0)));
+        uBytes = ((m_uLength * sizeof(double) + uPage - 1) / uPage) * uPage;
+        if (iFD >= 0)
+        {
+            void* pBase(MAP_FAILED);
+            if (!ftruncate(iFD, static_cast<off_t>(uBytes)))
+                pBase = mmap(nullptr, 2 * uBytes, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (pBase != MAP_FAILED)
+            {
+                char* pcBase(static_cast<char*>(pBase));
+                if (mmap(pcBase, uBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, iFD, 0) != MAP_FAILED &&
+                    mmap(pcBase + uBytes, uBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, iFD, 0) != MAP_FAILED)
+                {
+                    m_pdBase    = static_cast<double*>(pBase);
+                    m_uCapacity = uBytes / sizeof(double);
+                    m_bMirror   = true;
+                }
+                else
+                    munmap(pBase, 2 * uBytes);
+            }
+            close(iFD);
+        }
+    }
+#endif
+    if (!m_bMirror)
+    {
+        m_adFallback.assign(2 * m_uLength, 0.);
+        m_pdBase    = &m_adFallback[0];
+        m_uCapacity = m_uLength;
+    }
+    (void)uBytes;
+    (void)bMirror;
+    return true;
+}
+
+/// clear history
+void mccdaqhatsHistory::reset()
+{
+    m_uWrite = 0;
+    m_uFill  = 0;
+}
+
+/**
+ * @brief append samples, the costs depend on the number of new samples only
+ * @param[in] pdIn    input samples
+ * @param[in] uCount  number of input samples
+ */
+void mccdaqhatsHistory::write(const double* pdIn, size_t uCount)
+{
+    if (!m_pdBase)
+        return;
+    if (uCount > m_uCapacity)
+    {
+        pdIn  += uCount - m_uCapacity;
+        uCount = m_uCapacity;
+    }
+    if (m_bMirror)
+        memcpy(&m_pdBase[m_uWrite], pdIn, uCount * sizeof(double)); // wraps through the mirror
+    else
+    {
+        size_t uFirst(m_uCapacity - m_uWrite);
+        if (uFirst > uCount)
+            uFirst = uCount;
+        memcpy(&m_pdBase[m_uWrite], pdIn, uFirst * sizeof(double));
+        memcpy(&m_pdBase[m_uWrite + m_uCapacity], pdIn, uFirst * sizeof(double));
+        memcpy(m_pdBase, &pdIn[uFirst], (uCount - uFirst) * sizeof(double));
+        memcpy(&m_pdBase[m_uCapacity], &pdIn[uFirst], (uCount - uFirst) * sizeof(double));
+    }
+    m_uWrite += uCount;
+    if (m_uWrite >= m_uCapacity)
+        m_uWrite -= m_uCapacity;
+    m_uFill = (m_uFill + uCount > m_uLength) ? m_uLength : (m_uFill + uCount);
+}
+
+/**
+ * @brief get the history as contiguous memory, which is valid until the next write
+ * @param[out] puCount  number of samples
+ * @return oldest sample or nullptr
+ */
+const double* mccdaqhatsHistory::data(size_t* puCount) const
+{
+    *puCount = m_uFill;
+    if (!m_pdBase || !m_uFill)
+        return nullptr;
+    return &m_pdBase[(m_uWrite + m_uCapacity - m_uFill) % m_uCapacity];
+}
+
+/* ========================================================================
+ * level-of-detail pyramid
+ * ======================================================================== */
+
+/// maximum retention time in seconds
+#define MAX_PYRAMID_TIME 86400.
+/// maximum number of buckets of level 0
+#define MAX_PYRAMID_BUCKETS (1 << 20)
+/// minimum number of buckets of the highest level
+#define MIN_PYRAMID_BUCKETS 16
+
+/// constructor: disabled pyramid
+mccdaqhatsPyramid::mccdaqhatsPyramid()
+    : m_dRate(0.)
+    , m_dTime(0.)
+    , m_uBase(16)
+{
+    reset();
+}
+
+/**
+ * @brief change sample rate and retention time, this reallocates and clears the pyramid on changes
+ * @param[in] dRate  sample rate in Hz
+ * @param[in] dTime  retention time in seconds, 0=disabled
+ * @return true, if the configuration was changed
+ */
+bool mccdaqhatsPyramid::configure(double dRate, double dTime)
+{
+    double dSamples;
+    size_t uBuckets;
+    if (!isfinite(dRate) || dRate < 0.)
+        dRate = 0.;
+    if (!isfinite(dTime) || dTime < 0.)
+        dTime = 0.;
+    if (dTime > MAX_PYRAMID_TIME)
+        dTime = MAX_PYRAMID_TIME;
+    if (dRate == m_dRate && dTime == m_dTime)
+        return false;
+    m_dRate = dRate;
+    m_dTime = dTime;
+    std::vector<Level>().swap(m_aLevel);
+    reset();
+    if (m_dRate <= 0. || m_dTime <= 0.)
+        return true;
+
+    // base bucket size: power of two, which limits the number of buckets of level 0
+    dSamples = m_dRate * m_dTime;
+    m_uBase  = 16;
+    while (dSamples / static_cast<double>(m_uBase) > static_cast<double>(MAX_PYRAMID_BUCKETS))
+        m_uBase *= 2;
+    uBuckets = static_cast<size_t>(ceil(dSamples / static_cast<double>(m_uBase)));
+    if (uBuckets < MIN_PYRAMID_BUCKETS)
+        uBuckets = MIN_PYRAMID_BUCKETS;
+    for (;;)
+    {
+        Level level;
+        level.aBucket.resize(uBuckets);
+        level.qwComplete = 0;
+        m_aLevel.push_back(level);
+        if (uBuckets < 2 * MIN_PYRAMID_BUCKETS)
+            break;
+        uBuckets = (uBuckets + 1) / 2;
+    }
+    return true;
+}
+
+/// clear pyramid
+void mccdaqhatsPyramid::reset()
+{
+    m_qwSamples = 0;
+    m_uPartial  = 0;
+    m_dMin      = std::numeric_limits<double>::infinity();
+    m_dMax      = -std::numeric_limits<double>::infinity();
+    m_dSum      = 0.;
+    for (size_t i = 0; i < m_aLevel.size(); ++i)
+        m_aLevel[i].qwComplete = 0;
+}
+
+/**
+ * @brief store a completed bucket and combine every 2nd bucket into the next level,
+ *        this is amortized O(1) per bucket
+ * @param[in] uLevel  level of bucket
+ * @param[in] bucket  completed bucket
+ */
+void mccdaqhatsPyramid::push(size_t uLevel, Bucket bucket)
+{
+    while (uLevel < m_aLevel.size())
+    {
+        Level& level(m_aLevel[uLevel]);
+        size_t uSize(level.aBucket.size());
+        level.aBucket[level.qwComplete % uSize] = bucket;
+        if (!(++level.qwComplete & 1) && uLevel + 1 < m_aLevel.size())
+        {
+            const Bucket& a(level.aBucket[(level.qwComplete - 2) % uSize]);
+            const Bucket& b(level.aBucket[(level.qwComplete - 1) % uSize]);
+            Bucket combined;
+            combined.fMin  = a.fMin < b.fMin ? a.fMin : b.fMin;
+            combined.fMax  = a.fMax > b.fMax ? a.fMax : b.fMax;
+            combined.fMean = 0.5f * (a.fMean + b.fMean);
+            ++uLevel;
+            bucket = combined;
+            continue;
+        }
+        break;
+    }
+}
+
+/**
+ * @brief add a block of a single channel, min/max/sum of the base buckets are vectorized
+ * @param[in] pdIn    input samples
+ * @param[in] uCount  number of input samples
+ */
+void mccdaqhatsPyramid::process(const double* pdIn, size_t uCount)
+{
+    if (m_aLevel.empty())
+        return;
+    m_qwSamples += uCount;
+    while (uCount)
+    {
+        size_t uTake(m_uBase - m_uPartial);
+        if (uTake > uCount)
+            uTake = uCount;
+        mccdaqhatsDsp::minmax(pdIn, uTake, m_dMin, m_dMax);
+        m_dSum     += mccdaqhatsDsp::sum(pdIn, uTake);
+        m_uPartial += uTake;
+        pdIn       += uTake;
+        uCount     -= uTake;
+        if (m_uPartial < m_uBase)
+            break;
+        Bucket bucket;
+        bucket.fMin  = static_cast<float>(m_dMin);
+        bucket.fMax  = static_cast<float>(m_dMax);
+        bucket.fMean = static_cast<float>(m_dSum / static_cast<double>(m_uBase));
+        push(0, bucket);
+        m_uPartial = 0;
+        m_dMin     = std::numeric_limits<double>::infinity();
+        m_dMax     = -std::numeric_limits<double>::infinity();
+        m_dSum     = 0.;
+    }
+}
+
+/**
+ * @brief render an envelope of a time range: the level is chosen,
+ *        so that every pixel covers 1…2 buckets; this is O(width)
+ * @param[in]  dAgo    end of time range in seconds before the latest sample
+ * @param[in]  dSpan   length of time range in seconds
+ * @param[in]  uWidth  number of pixels
+ * @param[out] adEnv   minimum and maximum of every pixel (2 * width values), NaN without data
+ * @param[out] adMean  mean of every pixel, NaN without data
+ * @param[out] pdDt    time per pixel in seconds
+ * @return true on success
+ */
+bool mccdaqhatsPyramid::envelope(double dAgo, double dSpan, size_t uWidth, std::vector<double>& adEnv,
+                                 std::vector<double>& adMean, double* pdDt) const
+{
+    double dEnd, dStart, dPerPixel;
+    size_t uLevel(0), uSize;
+    if (m_aLevel.empty() || !uWidth || !(dSpan > 0.) || !(dAgo >= 0.))
+        return false;
+    dEnd      = static_cast<double>(m_qwSamples) - dAgo * m_dRate;
+    dStart    = dEnd - dSpan * m_dRate;
+    dPerPixel = (dEnd - dStart) / static_cast<double>(uWidth);
+    while (uLevel + 1 < m_aLevel.size() && static_cast<double>(m_uBase << (uLevel + 1)) <= dPerPixel)
+        ++uLevel;
+    const Level& level(m_aLevel[uLevel]);
+    double dBucket(static_cast<double>(m_uBase << uLevel));
+    uSize = level.aBucket.size();
+    // valid buckets: the ring holds the last "uSize" completed buckets
+    epicsInt64 qwFirst(static_cast<epicsInt64>(level.qwComplete > uSize ? level.qwComplete - uSize : 0));
+    epicsInt64 qwLast(static_cast<epicsInt64>(level.qwComplete));
+    adEnv.resize(2 * uWidth);
+    adMean.resize(uWidth);
+    for (size_t i = 0; i < uWidth; ++i)
+    {
+        double dFrom(dStart + dPerPixel * static_cast<double>(i));
+        epicsInt64 j0(static_cast<epicsInt64>(floor(dFrom / dBucket)));
+        epicsInt64 j1(static_cast<epicsInt64>(ceil((dFrom + dPerPixel) / dBucket)));
+        float fMin(std::numeric_limits<float>::infinity()), fMax(-std::numeric_limits<float>::infinity());
+        double dSum(0.);
+        int iCount(0);
+        if (j1 <= j0)
+            j1 = j0 + 1;
+        if (j0 < qwFirst) j0 = qwFirst;
+        if (j1 > qwLast)  j1 = qwLast;
+        for (epicsInt64 j = j0; j < j1; ++j)
+        {
+            const Bucket& b(level.aBucket[static_cast<size_t>(j) % uSize]);
+            fMin  = b.fMin < fMin ? b.fMin : fMin;
+            fMax  = b.fMax > fMax ? b.fMax : fMax;
+            dSum += b.fMean;
+            ++iCount;
+        }
+        adEnv[2 * i]     = iCount ? static_cast<double>(fMin) : static_cast<double>(epicsNAN);
+        adEnv[2 * i + 1] = iCount ? static_cast<double>(fMax) : static_cast<double>(epicsNAN);
+        adMean[i]        = iCount ? (dSum / static_cast<double>(iCount)) : static_cast<double>(epicsNAN);
+    }
+    *pdDt = dPerPixel / m_dRate;
+    return true;
+}
+
+/* ========================================================================
+ * engineering unit conversion
+ * ======================================================================== */
+
+/// maximum number of polynomial coefficients (order 15)
+#define MAX_CONVERSION_COEF 16
+/// maximum number of table points
+#define MAX_CONVERSION_POINTS 512
+/// input range of all streaming modules in volts (with margin), see \ref mccdaqhatsConversion::range
+#define MAX_INPUT_VOLTS 16.
+
+/// constructor: no conversion
+mccdaqhatsConversion::mccdaqhatsConversion()
+    : m_iMode(CONVERSION_OFF)
+    , m_uHint(0)
+    , m_dRange(MAX_INPUT_VOLTS)
+{
+}
+
+/**
+ * @brief check coefficients for a conversion type
+ * @param[in] iMode   enum \ref ConversionMode
+ * @param[in] adCoef  coefficients or table
+ * @return nullptr on success or error text
+ */
+const char* mccdaqhatsConversion::check(int iMode, const std::vector<double>& adCoef)
+{
+    for (size_t i = 0; i < adCoef.size(); ++i)
+        if (!isfinite(adCoef[i]))
+            return "coefficients must be finite";
+    switch (iMode)
+    {
+        case CONVERSION_OFF:
+            break;
+        case CONVERSION_LINEAR:
+            if (adCoef.size() != 2)
+                return "linear conversion needs 2 coefficients (offset, gain)";
+            break;
+        case CONVERSION_POLYNOMIAL:
+            if (adCoef.empty() || adCoef.size() > MAX_CONVERSION_COEF)
+                return "polynomial conversion needs 1...16 coefficients";
+            break;
+        case CONVERSION_TABLE:
+            if (adCoef.size() < 4 || adCoef.size() > 2 * MAX_CONVERSION_POINTS || (adCoef.size() & 1))
+                return "table conversion needs 2...512 pairs of x and y";
+            for (size_t i = 2; i < adCoef.size(); i += 2)
+                if (!(adCoef[i] > adCoef[i - 2]))
+                    return "table conversion needs ascending x values";
+            break;
+        default:
+            return "invalid conversion type";
+    }
+    return nullptr;
+}
+
+/**
+ * @brief change the conversion, invalid configurations disable it
+ * @param[in] iMode   enum \ref ConversionMode
+ * @param[in] adCoef  coefficients or table
+ * @return true, if the configuration changed
+ */
+bool mccdaqhatsConversion::configure(int iMode, const std::vector<double>& adCoef)
+{
+    if (check(iMode, adCoef))
+        iMode = CONVERSION_OFF;
+    if (iMode == m_iMode && (iMode == CONVERSION_OFF || adCoef == m_adCoef))
+        return false;
+    m_iMode  = iMode;
+    m_adCoef = adCoef;
+    m_adX.clear();
+    m_adY.clear();
+    m_uHint  = 0;
+    m_dRange = MAX_INPUT_VOLTS;
+    switch (iMode)
+    {
+        case CONVERSION_LINEAR:
+            m_dRange = fabs(adCoef[0]) + fabs(adCoef[1]) * MAX_INPUT_VOLTS;
+            break;
+        case CONVERSION_POLYNOMIAL:
+        {
+            // upper bound: sum of the absolute terms at the end of the input range
+            double dPower(1.);
+            m_dRange = 0.;
+            for (size_t i = 0; i < adCoef.size(); ++i, dPower *= MAX_INPUT_VOLTS)
+                m_dRange += fabs(adCoef[i]) * dPower;
+            break;
+        }
+        case CONVERSION_TABLE:
+        {
+            // interpolation stays within the points, the extrapolation grows up to the end of the input range
+            const size_t uLast(adCoef.size() - 2);
+            m_dRange = 0.;
+            for (size_t i = 0; i + 1 < adCoef.size(); i += 2)
+            {
+                m_adX.push_back(adCoef[i]);
+                m_adY.push_back(adCoef[i + 1]);
+                if (fabs(adCoef[i + 1]) > m_dRange)
+                    m_dRange = fabs(adCoef[i + 1]);
+            }
+            if (-MAX_INPUT_VOLTS < adCoef[0])
+                m_dRange = std::max(m_dRange, fabs(adCoef[1] + (adCoef[3] - adCoef[1]) * (-MAX_INPUT_VOLTS - adCoef[0]) /
+                                                                (adCoef[2] - adCoef[0])));
+            if (MAX_INPUT_VOLTS > adCoef[uLast])
+                m_dRange = std::max(m_dRange, fabs(adCoef[uLast + 1] + (adCoef[uLast + 1] - adCoef[uLast - 1]) *
+                                                                (MAX_INPUT_VOLTS - adCoef[uLast]) / (adCoef[uLast] - adCoef[uLast - 2])));
+            break;
+        }
+    }
+    if (!isfinite(m_dRange) || m_dRange > 1e300)
+        m_dRange = 1e300;
+    return true;
+}
+
+/**
+ * @brief convert the values of a channel in place
+ * @param[in,out] pdData   first value of channel
+ * @param[in]     uStride  distance of values (number of channels of an interleaved block)
+ * @param[in]     uCount   number of values
+ */
+void mccdaqhatsConversion::process(double* pdData, size_t uStride, size_t uCount)
+{
+    switch (m_iMode)
+    {
+        case CONVERSION_LINEAR:
+        {
+            const double dOffset(m_adCoef[0]), dGain(m_adCoef[1]);
+            if (uStride == 1)
+            {
+                double* MCC_RESTRICT pd(pdData);
+                for (size_t i = 0; i < uCount; ++i)
+                    pd[i] = dOffset + dGain * pd[i];
+            }
+            else
+                for (size_t i = 0; i < uCount; ++i)
+                    pdData[i * uStride] = dOffset + dGain * pdData[i * uStride];
+            break;
+        }
+        case CONVERSION_POLYNOMIAL:
+        {
+            // Horner scheme for every value
+            const double* pdCoef(&m_adCoef[0]);
+            const size_t uOrder(m_adCoef.size() - 1);
+            for (size_t i = 0; i < uCount; ++i)
+            {
+                double dX(pdData[i * uStride]), dY(pdCoef[uOrder]);
+                for (size_t j = uOrder; j > 0; --j)
+                    dY = dY * dX + pdCoef[j - 1];
+                pdData[i * uStride] = dY;
+            }
+            break;
+        }
+        case CONVERSION_TABLE:
+        {
+            // signals are mostly continuous: search near the segment of the last value first
+            const size_t uLast(m_adX.size() - 2);
+            size_t k(m_uHint);
+            for (size_t i = 0; i < uCount; ++i)
+            {
+                double dX(pdData[i * uStride]);
+                if (isnan(dX))
+                    continue;
+                if (dX < m_adX[k] || dX > m_adX[k + 1])
+                {
+                    if (k > 0 && dX < m_adX[k] && dX >= m_adX[k - 1])
+                        --k;
+                    else if (k < uLast && dX > m_adX[k + 1] && dX <= m_adX[k + 2])
+                        ++k;
+                    else
+                    {
+                        // binary search, outside of the table the first or last segment is extrapolated
+                        size_t uLow(0), uHigh(uLast);
+                        while (uLow < uHigh)
+                        {
+                            size_t uMid((uLow + uHigh + 1) / 2);
+                            if (m_adX[uMid] <= dX)
+                                uLow = uMid;
+                            else
+                                uHigh = uMid - 1;
+                        }
+                        k = uLow;
+                    }
+                }
+                pdData[i * uStride] = m_adY[k] + (m_adY[k + 1] - m_adY[k]) * (dX - m_adX[k]) / (m_adX[k + 1] - m_adX[k]);
+            }
+            m_uHint = k;
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+/* ========================================================================
+ * biquad IIR filter
+ * ======================================================================== */
+
+/// constructor: disabled filter
+mccdaqhatsBiquad::mccdaqhatsBiquad()
+    : m_iType(BIQUAD_OFF)
+    , m_dFreq(0.)
+    , m_dQ(0.)
+    , m_dRate(0.)
+{
+}
+
+/**
+ * @brief change the filter design, the coefficients are calculated with the
+ *        "audio EQ cookbook" formulas (bilinear transform)
+ * @param[in] iType    enum \ref BiquadType
+ * @param[in] dFreq    cutoff or center frequency in Hz, limited to below Nyquist frequency
+ * @param[in] dQ       quality factor (0.7071 = Butterworth for a single stage)
+ * @param[in] iStages  number of cascaded stages (1...8)
+ * @param[in] dRate    sample rate in Hz
+ * @return true, if the configuration changed (the state is cleared)
+ */
+bool mccdaqhatsBiquad::configure(int iType, double dFreq, double dQ, int iStages, double dRate)
+{
+    if (iType < 0 || iType >= BIQUAD_COUNT || !(dFreq > 0.) || !(dQ > 0.) || !(dRate > 0.))
+        iType = BIQUAD_OFF;
+    if (iStages < 1)
+        iStages = 1;
+    else if (iStages > 8)
+        iStages = 8;
+    if (iType == BIQUAD_OFF)
+        iStages = 0;
+    if (iType == m_iType && dFreq == m_dFreq && dQ == m_dQ && dRate == m_dRate &&
+        static_cast<size_t>(iStages) == m_aStage.size())
+        return false;
+    m_iType = iType;
+    m_dFreq = dFreq;
+    m_dQ    = dQ;
+    m_dRate = dRate;
+    m_aStage.clear();
+    if (iType == BIQUAD_OFF)
+        return true;
+
+    double dW0(2. * M_PI * ((dFreq < 0.49 * dRate) ? dFreq : (0.49 * dRate)) / dRate);
+    double dCos(cos(dW0)), dAlpha(sin(dW0) / (2. * dQ));
+    double dA0(1. + dAlpha);
+    Stage st;
+    switch (iType)
+    {
+        case BIQUAD_LOWPASS:
+            st.dB0 = st.dB2 = (1. - dCos) / 2.;
+            st.dB1 = 1. - dCos;
+            break;
+        case BIQUAD_HIGHPASS:
+            st.dB0 = st.dB2 = (1. + dCos) / 2.;
+            st.dB1 = -(1. + dCos);
+            break;
+        case BIQUAD_BANDPASS:
+            st.dB0 = dAlpha;
+            st.dB1 = 0.;
+            st.dB2 = -dAlpha;
+            break;
+        default: // notch
+            st.dB0 = st.dB2 = 1.;
+            st.dB1 = -2. * dCos;
+            break;
+    }
+    st.dB0 /= dA0;
+    st.dB1 /= dA0;
+    st.dB2 /= dA0;
+    st.dA1  = -2. * dCos / dA0;
+    st.dA2  = (1. - dAlpha) / dA0;
+    st.dZ1  = st.dZ2 = 0.;
+    m_aStage.assign(static_cast<size_t>(iStages), st);
+    return true;
+}
+
+/// clear the state of all stages, e.g. after a gap
+void mccdaqhatsBiquad::reset()
+{
+    for (size_t i = 0; i < m_aStage.size(); ++i)
+        m_aStage[i].dZ1 = m_aStage[i].dZ2 = 0.;
+}
+
+/**
+ * @brief filter a block of values, input and output may be the same (in place);
+ *        the stages run one after the other over the whole block with
+ *        coefficients and state in registers
+ * @param[in]  pdIn        first input value
+ * @param[in]  uInStride   distance of input values (number of channels of an interleaved block)
+ * @param[out] pdOut       first output value
+ * @param[in]  uOutStride  distance of output values
+ * @param[in]  uCount      number of values
+ */
+void mccdaqhatsBiquad::process(const double* pdIn, size_t uInStride, double* pdOut, size_t uOutStride, size_t uCount)
+{
+    bool bFinite(true);
+    for (size_t k = 0; k < m_aStage.size(); ++k)
+    {
+        Stage& st(m_aStage[k]);
+        const double dB0(st.dB0), dB1(st.dB1), dB2(st.dB2), dA1(st.dA1), dA2(st.dA2);
+        double dZ1(st.dZ1), dZ2(st.dZ2);
+        const double* pdSrc(k ? pdOut : pdIn);
+        size_t uSrcStride(k ? uOutStride : uInStride);
+        for (size_t i = 0; i < uCount; ++i)
+        {
+            double dX(pdSrc[i * uSrcStride]);
+            double dY(dB0 * dX + dZ1);
+            dZ1 = dB1 * dX - dA1 * dY + dZ2;
+            dZ2 = dB2 * dX - dA2 * dY;
+            pdOut[i * uOutStride] = dY;
+        }
+        st.dZ1 = dZ1;
+        st.dZ2 = dZ2;
+        if (!isfinite(dZ1) || !isfinite(dZ2))
+            bFinite = false;
+    }
+    if (!m_aStage.size() && pdOut != pdIn)
+        for (size_t i = 0; i < uCount; ++i)
+            pdOut[i * uOutStride] = pdIn[i * uInStride];
+    if (!bFinite)
+        reset(); // a NaN input must not stop the filter forever
+}
+
+/* ========================================================================
+ * level-crossing events
+ * ======================================================================== */
+
+/// constructor: disabled detector
+mccdaqhatsEvents::mccdaqhatsEvents()
+    : m_iMode(EVENT_OFF)
+    , m_dLevel(0.)
+    , m_dHyst(0.)
+    , m_bArmRise(false)
+    , m_bArmFall(false)
+    , m_dPrev(static_cast<double>(epicsNAN))
+    , m_dwCount(0)
+{
+}
+
+/**
+ * @brief change the detector, the event counter is cleared on changes
+ * @param[in] iMode   enum \ref EventMode
+ * @param[in] dLevel  threshold
+ * @param[in] dHyst   hysteresis (>=0): before an event, the signal has to be
+ *                    below (rising) or above (falling) the threshold by this value
+ * @return true, if the configuration changed
+ */
+bool mccdaqhatsEvents::configure(int iMode, double dLevel, double dHyst)
+{
+    if (iMode < 0 || iMode >= EVENT_COUNT || !isfinite(dLevel))
+        iMode = EVENT_OFF;
+    if (!(dHyst >= 0.))
+        dHyst = 0.;
+    if (iMode == m_iMode && dLevel == m_dLevel && dHyst == m_dHyst)
+        return false;
+    m_iMode  = iMode;
+    m_dLevel = dLevel;
+    m_dHyst  = dHyst;
+    reset();
+    return true;
+}
+
+/// clear detector state and event counter
+void mccdaqhatsEvents::reset()
+{
+    restart();
+    m_dwCount = 0;
+}
+
+/// clear detector state, e.g. after a gap: the next event needs a new arming
+void mccdaqhatsEvents::restart()
+{
+    m_bArmRise = m_bArmFall = false;
+    m_dPrev    = static_cast<double>(epicsNAN);
+}
+
+/**
+ * @brief detect the events of a block; blocks without any possible state change are
+ *        found with a vectorized minimum/maximum search and are not scanned
+ * @param[in]  pdIn      values of channel
+ * @param[in]  uCount    number of values
+ * @param[out] adEvents  pairs of event position and direction (+1=rising, -1=falling),
+ *                       the position is the interpolated sample index inside the block
+ *                       (-1...0 for a crossing after the last sample of the previous block)
+ * @return number of events
+ */
+size_t mccdaqhatsEvents::process(const double* pdIn, size_t uCount, std::vector<double>& adEvents)
+{
+    const double dLevel(m_dLevel), dArmRise(m_dLevel - m_dHyst), dArmFall(m_dLevel + m_dHyst);
+    const bool bRising(m_iMode == EVENT_RISING || m_iMode == EVENT_BOTH);
+    const bool bFalling(m_iMode == EVENT_FALLING || m_iMode == EVENT_BOTH);
+    size_t uEvents(0);
+    double dMin(std::numeric_limits<double>::infinity()), dMax(-std::numeric_limits<double>::infinity());
+    adEvents.clear();
+    if (m_iMode == EVENT_OFF || !uCount)
+        return 0;
+    mccdaqhatsDsp::minmax(pdIn, uCount, dMin, dMax);
+    if ((!bRising  || (m_bArmRise ? !(dMax >= dLevel) : !(dMin < dArmRise))) &&
+        (!bFalling || (m_bArmFall ? !(dMin <= dLevel) : !(dMax > dArmFall))))
+    {
+        m_dPrev = pdIn[uCount - 1]; // nothing to do
+        return 0;
+    }
+    double dPrev(m_dPrev);
+    for (size_t i = 0; i < uCount; ++i)
+    {
+        double dX(pdIn[i]);
+        int iDir(0);
+        if (bRising)
+        {
+            if (m_bArmRise && dX >= dLevel)
+            {
+                m_bArmRise = false;
+                iDir = 1;
+            }
+            else if (dX < dArmRise)
+                m_bArmRise = true;
+        }
+        if (bFalling)
+        {
+            if (m_bArmFall && dX <= dLevel)
+            {
+                m_bArmFall = false;
+                iDir = -1;
+            }
+            else if (dX > dArmFall)
+                m_bArmFall = true;
+        }
+        if (iDir)
+        {
+            // linear interpolation between previous and current sample
+            double dPos(static_cast<double>(i));
+            if (isfinite(dPrev) && dPrev != dX)
+            {
+                double dFrac((dLevel - dPrev) / (dX - dPrev));
+                if (dFrac >= 0. && dFrac <= 1.)
+                    dPos += dFrac - 1.;
+            }
+            adEvents.push_back(dPos);
+            adEvents.push_back(static_cast<double>(iDir));
+            ++uEvents;
+            ++m_dwCount;
+        }
+        dPrev = dX;
+    }
+    m_dPrev = dPrev;
+    return uEvents;
+}
+
+/* ========================================================================
+ * frequency counter
+ * ======================================================================== */
+
+/// constructor: disabled counter
+mccdaqhatsFrequency::mccdaqhatsFrequency()
+    : m_dGate(0.)
+    , m_dLevel(0.)
+    , m_dHyst(0.)
+    , m_dRate(0.)
+    , m_qwGateLen(0)
+{
+    reset();
+}
+
+/**
+ * @brief change the counter, a running measurement is restarted on changes
+ * @param[in] dGate   gate time in seconds, 0=disabled
+ * @param[in] dLevel  threshold, 0 for zero crossings
+ * @param[in] dHyst   hysteresis (>=0)
+ * @param[in] dRate   sample rate in Hz
+ * @return true, if the configuration changed
+ */
+bool mccdaqhatsFrequency::configure(double dGate, double dLevel, double dHyst, double dRate)
+{
+    if (!(dGate > 0.) || !(dRate > 0.))
+        dGate = 0.;
+    if (dGate == m_dGate && dLevel == m_dLevel && dHyst == m_dHyst && dRate == m_dRate)
+        return false;
+    m_dGate     = dGate;
+    m_dLevel    = dLevel;
+    m_dHyst     = dHyst;
+    m_dRate     = dRate;
+    m_qwGateLen = 0;
+    if (dGate > 0.)
+    {
+        double dLen(floor(dGate * dRate + 0.5));
+        m_qwGateLen = (dLen < 1.) ? 1 : static_cast<epicsUInt64>(dLen);
+    }
+    m_events.configure(m_qwGateLen ? mccdaqhatsEvents::EVENT_RISING : mccdaqhatsEvents::EVENT_OFF, dLevel, dHyst);
+    reset();
+    return true;
+}
+
+/// restart measurement, e.g. after a gap
+void mccdaqhatsFrequency::reset()
+{
+    m_events.restart();
+    m_qwGatePos = 0;
+    m_dLast     = static_cast<double>(epicsNAN);
+    m_qwPeriods = 0;
+    m_dMean     = 0.;
+    m_dM2       = 0.;
+}
+
+/**
+ * @brief measure the periods of a block, constant costs per sample; the gate ends
+ *        with the block, which reaches the gate time
+ * @param[in]  pdIn     values of channel
+ * @param[in]  uCount   number of values
+ * @param[out] result   measurement of the finished gate
+ * @return true, if a gate finished with this block
+ */
+bool mccdaqhatsFrequency::process(const double* pdIn, size_t uCount, Result& result)
+{
+    if (!m_qwGateLen || !uCount)
+        return false;
+    m_events.process(pdIn, uCount, m_adEvents);
+    for (size_t i = 0; i < m_adEvents.size(); i += 2)
+    {
+        if (isfinite(m_dLast))
+        {
+            double dPeriod(m_adEvents[i] - m_dLast);
+            double dDelta(dPeriod - m_dMean);
+            ++m_qwPeriods;
+            m_dMean += dDelta / static_cast<double>(m_qwPeriods);
+            m_dM2   += dDelta * (dPeriod - m_dMean);
+        }
+        m_dLast = m_adEvents[i];
+    }
+    m_dLast     -= static_cast<double>(uCount); // positions relative to next block
+    m_qwGatePos += uCount;
+    if (m_qwGatePos < m_qwGateLen)
+        return false;
+    if (m_qwPeriods && m_dMean > 0.)
+    {
+        result.dFreq   = m_dRate / m_dMean;
+        result.dPeriod = m_dMean / m_dRate;
+        result.dJitter = (m_qwPeriods > 1) ? (sqrt(m_dM2 / static_cast<double>(m_qwPeriods - 1)) / m_dRate) : 0.;
+    }
+    else
+    {
+        result.dFreq   = 0.;
+        result.dPeriod = static_cast<double>(epicsNAN);
+        result.dJitter = static_cast<double>(epicsNAN);
+    }
+    // the next gate continues with the last crossing
+    m_qwGatePos = 0;
+    m_qwPeriods = 0;
+    m_dMean     = 0.;
+    m_dM2       = 0.;
+    return true;
+}
+
+/* ========================================================================
+ * virtual channel expressions
+ * ======================================================================== */
+
+/// maximum number of plan steps
+#define MAX_EXPRESSION_STEPS 64
+
+/// constructor: empty expression
+mccdaqhatsExpression::mccdaqhatsExpression()
+    : m_iChannels(0)
+{
+}
+
+/// remove the expression
+void mccdaqhatsExpression::clear()
+{
+    m_sText.clear();
+    m_aPlan.clear();
+    m_aStack.clear();
+    m_iChannels = 0;
+}
+
+/**
+ * @brief compile an expression; syntax (case insensitive):
+ *        sum     = product { ("+" | "-") product }
+ *        product = unary { ("*" | "/") unary }
+ *        unary   = "-" unary | primary
+ *        primary = number | "C0"..."C7" | "(" sum ")" | ("ABS" | "SQRT") "(" sum ")"
+ *                | ("MIN" | "MAX") "(" sum "," sum ")"
+ * @param[in]  sExpression  source text, empty removes the expression
+ * @param[out] psError      (optional) error text
+ * @return true on success, the old expression is kept on errors
+ */
+bool mccdaqhatsExpression::compile(const std::string& sExpression, std::string* psError)
+{
+    mccdaqhatsExpression tmp;
+    const char* szPos(sExpression.c_str());
+    size_t uMaxDepth(0);
+    if (sExpression.find_first_not_of(" \t") == std::string::npos)
+    {
+        clear();
+        return true;
+    }
+    if (!tmp.parseSum(szPos))
+        ;
+    else
+    {
+        while (isspace(static_cast<unsigned char>(*szPos)))
+            ++szPos;
+        if (*szPos)
+            tmp.m_sError = "unexpected character";
+        else if (tmp.m_aPlan.size() > MAX_EXPRESSION_STEPS)
+            tmp.m_sError = "expression is too long";
+    }
+    if (!tmp.m_sError.empty())
+    {
+        if (psError)
+            *psError = tmp.m_sError + " at position " + std::to_string(szPos - sExpression.c_str() + 1);
+        return false;
+    }
+    // stack depth of plan
+    for (size_t i = 0, uDepth = 0; i < tmp.m_aPlan.size(); ++i)
+    {
+        switch (tmp.m_aPlan[i].iCode)
+        {
+            case OP_CONST: case OP_CHANNEL:
+                ++uDepth;
+                break;
+            case OP_NEG: case OP_ABS: case OP_SQRT:
+                break;
+            default:
+                --uDepth;
+                break;
+        }
+        if (uDepth > uMaxDepth)
+            uMaxDepth = uDepth;
+    }
+    m_sText     = sExpression;
+    m_aPlan.swap(tmp.m_aPlan);
+    m_iChannels = tmp.m_iChannels;
+    m_aStack.clear();
+    m_aStack.resize(uMaxDepth);
+    return true;
+}
+
+/// append a step to the plan
+void mccdaqhatsExpression::emit(int iCode, int iChannel, double dValue)
+{
+    Op op;
+    op.iCode    = iCode;
+    op.iChannel = iChannel;
+    op.dValue   = dValue;
+    m_aPlan.push_back(op);
+}
+
+/// parser: sum = product { ("+" | "-") product }
+bool mccdaqhatsExpression::parseSum(const char*& szPos)
+{
+    if (!parseProduct(szPos))
+        return false;
+    for (;;)
+    {
+        while (isspace(static_cast<unsigned char>(*szPos)))
+            ++szPos;
+        char c(*szPos);
+        if (c != '+' && c != '-')
+            return true;
+        ++szPos;
+        if (!parseProduct(szPos))
+            return false;
+        emit(c == '+' ? OP_ADD : OP_SUB);
+    }
+}
+
+/// parser: product = unary { ("*" | "/") unary }
+bool mccdaqhatsExpression::parseProduct(const char*& szPos)
+{
+    if (!parseUnary(szPos))
+        return false;
+    for (;;)
+    {
+        while (isspace(static_cast<unsigned char>(*szPos)))
+            ++szPos;
+        char c(*szPos);
+        if (c != '*' && c != '/')
+            return true;
+        ++szPos;
+        if (!parseUnary(szPos))
+            return false;
+        emit(c == '*' ? OP_MUL : OP_DIV);
+    }
+}
+
+/// parser: unary = "-" unary | primary
+bool mccdaqhatsExpression::parseUnary(const char*& szPos)
+{
+    while (isspace(static_cast<unsigned char>(*szPos)))
+        ++szPos;
+    if (*szPos == '-')
+    {
+        ++szPos;
+        if (!parseUnary(szPos))
+            return false;
+        emit(OP_NEG);
+        return true;
+    }
+    return parsePrimary(szPos);
+}
+
+/// parser: primary = number | channel | "(" sum ")" | function "(" sum ["," sum] ")"
+bool mccdaqhatsExpression::parsePrimary(const char*& szPos)
+{
+    static const struct { const char* szName; int iCode; int iArgs; } aFunctions[] =
+        { { "ABS", OP_ABS, 1 }, { "SQRT", OP_SQRT, 1 }, { "MIN", OP_MIN, 2 }, { "MAX", OP_MAX, 2 } };
+    while (isspace(static_cast<unsigned char>(*szPos)))
+        ++szPos;
+    if (isdigit(static_cast<unsigned char>(*szPos)) || *szPos == '.')
+    {
+        char* szEnd(nullptr);
+        double dValue(strtod(szPos, &szEnd));
+        if (!szEnd || szEnd == szPos || !isfinite(dValue))
+        {
+            m_sError = "invalid number";
+            return false;
+        }
+        szPos = szEnd;
+        emit(OP_CONST, 0, dValue);
+        return true;
+    }
+    if (*szPos == '(')
+    {
+        ++szPos;
+        if (!parseSum(szPos))
+            return false;
+        while (isspace(static_cast<unsigned char>(*szPos)))
+            ++szPos;
+        if (*szPos != ')')
+        {
+            m_sError = "missing )";
+            return false;
+        }
+        ++szPos;
+        return true;
+    }
+    if (toupper(static_cast<unsigned char>(szPos[0])) == 'C' && szPos[1] >= '0' && szPos[1] <= '7' &&
+        !isalnum(static_cast<unsigned char>(szPos[2])))
+    {
+        int iChannel(szPos[1] - '0');
+        szPos += 2;
+        m_iChannels |= 1 << iChannel;
+        emit(OP_CHANNEL, iChannel);
+        return true;
+    }
+    for (size_t i = 0; i < sizeof(aFunctions) / sizeof(aFunctions[0]); ++i)
+    {
+        size_t uLen(strlen(aFunctions[i].szName)), j(0);
+        while (j < uLen && toupper(static_cast<unsigned char>(szPos[j])) == aFunctions[i].szName[j])
+            ++j;
+        if (j < uLen || isalnum(static_cast<unsigned char>(szPos[j])))
+            continue;
+        szPos += uLen;
+        while (isspace(static_cast<unsigned char>(*szPos)))
+            ++szPos;
+        if (*szPos != '(')
+        {
+            m_sError = "missing (";
+            return false;
+        }
+        for (int iArg = 0; iArg < aFunctions[i].iArgs; ++iArg)
+        {
+            ++szPos;
+            if (!parseSum(szPos))
+                return false;
+            while (isspace(static_cast<unsigned char>(*szPos)))
+                ++szPos;
+            if (*szPos != ((iArg + 1 < aFunctions[i].iArgs) ? ',' : ')'))
+            {
+                m_sError = (iArg + 1 < aFunctions[i].iArgs) ? "missing ," : "missing )";
+                return false;
+            }
+        }
+        ++szPos;
+        emit(aFunctions[i].iCode);
+        return true;
+    }
+    m_sError = *szPos ? "unknown name" : "unexpected end";
+    return false;
+}
+
+/**
+ * @brief helper for binary operations of the evaluation: result into "a", the four
+ *        combinations of constants and blocks are simple loops, which can be vectorized;
+ *        "pdOut" may be the same buffer as "pdA" or "pdB" (element-wise, so no restrict)
+ */
+template <class F> static void evaluateBinary(bool bConstA, double dA, const double* pdA,
+                                              bool bConstB, double dB, const double* pdB,
+                                              size_t uCount, double* pdOut, F f)
+{
+    if (bConstA)
+        for (size_t i = 0; i < uCount; ++i)
+            pdOut[i] = f(dA, pdB[i]);
+    else if (bConstB)
+        for (size_t i = 0; i < uCount; ++i)
+            pdOut[i] = f(pdA[i], dB);
+    else
+        for (size_t i = 0; i < uCount; ++i)
+            pdOut[i] = f(pdA[i], pdB[i]);
+}
+
+/**
+ * @brief evaluate the plan for a block of data
+ * @param[in]  apdIn   channel data, the used channels must not be nullptr
+ * @param[in]  uCount  number of samples per channel
+ * @param[out] pdOut   result, "uCount" values
+ */
+void mccdaqhatsExpression::evaluate(const double* const apdIn[8], size_t uCount, double* pdOut)
+{
+    size_t uTop(0);
+    for (size_t i = 0; i < m_aPlan.size(); ++i)
+    {
+        const Op& op(m_aPlan[i]);
+        switch (op.iCode)
+        {
+            case OP_CONST:
+            case OP_CHANNEL:
+            {
+                Entry& e(m_aStack[uTop++]);
+                e.bConst = (op.iCode == OP_CONST) || !apdIn[op.iChannel];
+                e.dValue = (op.iCode == OP_CONST) ? op.dValue : static_cast<double>(epicsNAN);
+                e.pdData = e.bConst ? nullptr : apdIn[op.iChannel]; // no copy
+                break;
+            }
+            case OP_NEG:
+            case OP_ABS:
+            case OP_SQRT:
+            {
+                Entry& a(m_aStack[uTop - 1]);
+                if (a.bConst)
+                    a.dValue = (op.iCode == OP_NEG) ? -a.dValue : ((op.iCode == OP_ABS) ? fabs(a.dValue) : sqrt(a.dValue));
+                else
+                {
+                    const double* pdA(a.pdData);
+                    a.adData.resize(uCount);
+                    double* pd(&a.adData[0]); // may be "pdA" itself: element-wise in place
+                    if (op.iCode == OP_NEG)
+                        for (size_t j = 0; j < uCount; ++j) pd[j] = -pdA[j];
+                    else if (op.iCode == OP_ABS)
+                        for (size_t j = 0; j < uCount; ++j) pd[j] = fabs(pdA[j]);
+                    else
+                        for (size_t j = 0; j < uCount; ++j) pd[j] = sqrt(pdA[j]);
+                    a.pdData = &a.adData[0];
+                }
+                break;
+            }
+            default:
+            {
+                Entry& a(m_aStack[uTop - 2]);
+                Entry& b(m_aStack[uTop - 1]);
+                --uTop;
+                if (a.bConst && b.bConst)
+                {
+                    switch (op.iCode)
+                    {
+                        case OP_ADD: a.dValue += b.dValue; break;
+                        case OP_SUB: a.dValue -= b.dValue; break;
+                        case OP_MUL: a.dValue *= b.dValue; break;
+                        case OP_DIV: a.dValue /= b.dValue; break;
+                        case OP_MIN: a.dValue = (b.dValue < a.dValue) ? b.dValue : a.dValue; break;
+                        case OP_MAX: a.dValue = (b.dValue > a.dValue) ? b.dValue : a.dValue; break;
+                    }
+                    break;
+                }
+                // the result buffer may be one of the inputs: the loops read an element before writing it
+                std::vector<double>& adOut(a.bConst ? b.adData : a.adData);
+                adOut.resize(uCount);
+                double* pdResult(&adOut[0]);
+                switch (op.iCode)
+                {
+                    case OP_ADD: evaluateBinary(a.bConst, a.dValue, a.pdData, b.bConst, b.dValue, b.pdData, uCount, pdResult, [](double x, double y) { return x + y; }); break;
+                    case OP_SUB: evaluateBinary(a.bConst, a.dValue, a.pdData, b.bConst, b.dValue, b.pdData, uCount, pdResult, [](double x, double y) { return x - y; }); break;
+                    case OP_MUL: evaluateBinary(a.bConst, a.dValue, a.pdData, b.bConst, b.dValue, b.pdData, uCount, pdResult, [](double x, double y) { return x * y; }); break;
+                    case OP_DIV: evaluateBinary(a.bConst, a.dValue, a.pdData, b.bConst, b.dValue, b.pdData, uCount, pdResult, [](double x, double y) { return x / y; }); break;
+                    case OP_MIN: evaluateBinary(a.bConst, a.dValue, a.pdData, b.bConst, b.dValue, b.pdData, uCount, pdResult, [](double x, double y) { return y < x ? y : x; }); break;
+                    case OP_MAX: evaluateBinary(a.bConst, a.dValue, a.pdData, b.bConst, b.dValue, b.pdData, uCount, pdResult, [](double x, double y) { return y > x ? y : x; }); break;
+                }
+                if (a.bConst)
+                    a.adData.swap(b.adData);
+                a.bConst = false;
+                a.pdData = &a.adData[0];
+                break;
+            }
+        }
+    }
+    if (!uTop)
+        return;
+    if (m_aStack[0].bConst)
+        for (size_t j = 0; j < uCount; ++j)
+            pdOut[j] = m_aStack[0].dValue;
+    else
+        memcpy(pdOut, m_aStack[0].pdData, uCount * sizeof(*pdOut));
+}
+
+/* ========================================================================
+ * deadband
+ * ======================================================================== */
+
+/// constructor: publish every change
+mccdaqhatsDeadband::mccdaqhatsDeadband()
+    : m_dDeadband(0.)
+    , m_iMode(DEADBAND_ABSOLUTE)
+    , m_dLast(0.)
+    , m_bValid(false)
+{
+}
+
+/**
+ * @brief change the deadband, the next value is published on changes
+ * @param[in] dDeadband  allowed change without publishing (>=0)
+ * @param[in] iMode      enum \ref DeadbandMode
+ * @return true, if the configuration changed
+ */
+bool mccdaqhatsDeadband::configure(double dDeadband, int iMode)
+{
+    if (!(dDeadband >= 0.))
+        dDeadband = 0.;
+    if (iMode < 0 || iMode >= DEADBAND_COUNT)
+        iMode = DEADBAND_ABSOLUTE;
+    if (dDeadband == m_dDeadband && iMode == m_iMode)
+        return false;
+    m_dDeadband = dDeadband;
+    m_iMode     = iMode;
+    reset();
+    return true;
+}
+
+/**
+ * @brief check a new value against the last published one; the first value, changes
+ *        from or to NaN and changes, which exceed the deadband, are published
+ * @param[in] dValue  new value
+ * @return true, if the value should be published (it is remembered then)
+ */
+bool mccdaqhatsDeadband::check(double dValue)
+{
+    if (m_bValid)
+    {
+        bool bNaN(isnan(dValue) != 0), bLastNaN(isnan(m_dLast) != 0);
+        if (bNaN && bLastNaN)
+            return false;
+        if (bNaN == bLastNaN)
+        {
+            double dLimit(m_dDeadband);
+            if (m_iMode == DEADBAND_RELATIVE)
+                dLimit *= 0.01 * fabs(m_dLast);
+            if (!(fabs(dValue - m_dLast) > dLimit))
+                return false;
+        }
+    }
+    m_dLast  = dValue;
+    m_bValid = true;
+    return true;
+}
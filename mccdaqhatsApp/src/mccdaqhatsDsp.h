@@ -0,0 +1,544 @@
+/*
+ * SPDX-License-Identifier: EPICS
+ * Helmholtz-Zentrum Berlin fuer Materialien und Energie GmbH 2023-2024
+ * Lutz Rossa <rossa@helmholtz-berlin.de>
+ */
+#ifndef MCCDAQHATSDSP_INCLUDED
+#define MCCDAQHATSDSP_INCLUDED
+
+#include <stddef.h>
+#include <epicsTypes.h>
+#include <string>
+#include <vector>
+
+/**
+ * \brief preprocessor helper macro for non-aliasing pointers: this allows the compiler
+ *        to vectorize the simple loops of the signal processing kernels
+ */
+#if defined(__GNUC__) || defined(_MSC_VER)
+#define MCC_RESTRICT __restrict
+#else
+#define MCC_RESTRICT
+#endif
+
+/// signal processing kernels for the streaming channels, they do not know about asyn
+namespace mccdaqhatsDsp
+{
+    void   deinterleave(const double* MCC_RESTRICT pdIn, size_t uStride, size_t uOffset, size_t uCount, double* MCC_RESTRICT pdOut);
+    double sum(const double* MCC_RESTRICT pdIn, size_t uCount);
+    double dot(const double* MCC_RESTRICT pdA, const double* MCC_RESTRICT pdB, size_t uCount);
+    double sumsqdev(const double* MCC_RESTRICT pdIn, size_t uCount, double dMean);
+    void   minmax(const double* MCC_RESTRICT pdIn, size_t uCount, double& dMin, double& dMax);
+}
+
+/// decimation filter of a single channel, the state is carried across blocks
+class mccdaqhatsDecimator
+{
+public:
+    /// filter types, same order as parameter enumeration
+    enum FilterType
+    {
+        FILTER_BOXCAR = 0, ///< average of "factor" samples
+        FILTER_CIC,        ///< 3rd order cascaded integrator comb
+        FILTER_FIR,        ///< windowed sinc low pass (Blackman)
+        FILTER_COUNT
+    };
+
+    /// maximum decimation factor of FILTER_FIR, the filter has 8*factor+1 coefficients
+    static const int MAX_FIR_FACTOR = 1024;
+
+    mccdaqhatsDecimator();
+    bool   configure(int iFactor, int iType, double dRange = 16.);
+    void   reset();
+    size_t process(const double* pdIn, size_t uCount, std::vector<double>& adOut);
+    int    factor() const { return m_iFactor; }
+    int    type() const   { return m_iType; }
+
+private:
+    int                 m_iFactor;  ///< decimation factor, 1=disabled
+    int                 m_iType;    ///< enum \ref FilterType
+    int                 m_iPhase;   ///< input samples until next output
+    double              m_dSum;     ///< boxcar: partial sum
+    epicsUInt64         m_aqwInt[3];   ///< CIC: integrators (fixed point, modulo arithmetic)
+    epicsUInt64         m_aqwComb[3];  ///< CIC: comb delays (fixed point, modulo arithmetic)
+    double              m_dRange;      ///< CIC: input range ±range, values outside are clipped
+    double              m_dScale;      ///< CIC: fixed point scale of input
+    double              m_dGain;       ///< CIC: inverse of fixed point scale and DC gain
+    std::vector<double> m_adTaps;   ///< FIR: symmetric coefficients
+    std::vector<double> m_adHist;   ///< FIR: last (taps - 1) samples followed by the current block
+};
+
+/// streaming statistics of a single channel (Welford/Chan accumulators)
+class mccdaqhatsStatistics
+{
+public:
+    /// statistics window, same order as parameter enumeration
+    enum StatMode
+    {
+        STAT_OFF = 0,    ///< disabled
+        STAT_BLOCK,      ///< every block of data (all blocks until \ref next)
+        STAT_SLIDING,    ///< last N samples
+        STAT_CUMULATIVE, ///< all samples since reset
+        STAT_COUNT
+    };
+
+    /// result of a statistics window
+    struct Result
+    {
+        double      dMean;  ///< arithmetic mean
+        double      dRms;   ///< root mean square
+        double      dMin;   ///< minimum
+        double      dMax;   ///< maximum
+        double      dStd;   ///< sample standard deviation
+        epicsUInt64 qwCount;///< number of samples
+    };
+
+    mccdaqhatsStatistics();
+    bool configure(int iMode, int iWindow);
+    void reset();
+    bool process(const double* pdIn, size_t uCount, Result& result);
+    void next() { m_bNext = true; }
+    int  mode() const { return m_iMode; }
+
+private:
+    /// sliding: element of a monotonic queue
+    struct QueueEntry
+    {
+        double      dValue; ///< sample value
+        epicsUInt32 dwIdx;  ///< running sample index
+    };
+
+    void merge(epicsUInt64 qwCount, double dMean, double dM2, double dMin, double dMax);
+    void slide(double dValue);
+    void recalc();
+
+    int                      m_iMode;    ///< enum \ref StatMode
+    epicsUInt32              m_dwWindow; ///< sliding: window length N
+    bool                     m_bNext;    ///< block: start a new window with next block
+    epicsUInt64              m_qwCount;  ///< number of samples
+    double                   m_dMean;    ///< running mean
+    double                   m_dM2;      ///< running sum of squared deviations from mean
+    double                   m_dMin;     ///< block, cumulative: minimum
+    double                   m_dMax;     ///< block, cumulative: maximum
+    std::vector<double>      m_adRing;   ///< sliding: last N samples
+    epicsUInt32              m_dwPos;    ///< sliding: next write position in ring
+    epicsUInt32              m_dwIndex;  ///< sliding: running sample index (modulo 2^32)
+    epicsUInt32              m_dwRecalc; ///< sliding: samples until exact recalculation
+    std::vector<QueueEntry>  m_aQueue[2];    ///< sliding: monotonic queues for minimum (0) and maximum (1)
+    epicsUInt32              m_adwQHead[2];  ///< sliding: first element of min/max queue
+    epicsUInt32              m_adwQCount[2]; ///< sliding: number of elements of min/max queue
+};
+
+/// windowed real FFT with Welch averaging of a single channel
+class mccdaqhatsSpectrum
+{
+public:
+    /// output type, same order as parameter enumeration
+    enum OutputType
+    {
+        OUTPUT_OFF = 0,   ///< disabled
+        OUTPUT_MAGNITUDE, ///< amplitude spectrum (peak amplitude of a sine)
+        OUTPUT_PSD,       ///< one-sided power spectral density per Hz
+        OUTPUT_COUNT
+    };
+
+    /// window function, same order as parameter enumeration
+    enum WindowType
+    {
+        WINDOW_RECT = 0,  ///< rectangular
+        WINDOW_HANN,      ///< Hann
+        WINDOW_HAMMING,   ///< Hamming
+        WINDOW_BLACKMAN,  ///< Blackman
+        WINDOW_COUNT
+    };
+
+    mccdaqhatsSpectrum();
+    bool   configure(int iOutput, int iSize, int iWindow, int iOverlap, int iAverages);
+    void   reset();
+    bool   process(const double* pdIn, size_t uCount, double dRate, std::vector<double>& adOut);
+    void   frequencies(double dRate, std::vector<double>& adOut) const;
+    int    output() const { return m_iOutput; }
+    size_t bins() const   { return m_uSize / 2 + 1; }
+
+private:
+    void   transform();
+
+    int                      m_iOutput;   ///< enum \ref OutputType
+    int                      m_iWindow;   ///< enum \ref WindowType
+    int                      m_iOverlap;  ///< segment overlap in percent
+    int                      m_iAverages; ///< number of averaged segments
+    size_t                   m_uSize;     ///< FFT size N (power of two)
+    size_t                   m_uHop;      ///< input samples between segments
+    size_t                   m_uFill;     ///< number of samples in "m_adInput"
+    int                      m_iCount;    ///< number of segments in "m_adPower"
+    double                   m_dWinSum;   ///< sum of window coefficients
+    double                   m_dWinSum2;  ///< sum of squared window coefficients
+    std::vector<double>      m_adInput;   ///< input samples of next segment
+    std::vector<double>      m_adWindow;  ///< window coefficients
+    std::vector<double>      m_adRe;      ///< N/2 point complex FFT: real part
+    std::vector<double>      m_adIm;      ///< N/2 point complex FFT: imaginary part
+    std::vector<double>      m_adCos;     ///< twiddle factors of N point FFT: cosine
+    std::vector<double>      m_adSin;     ///< twiddle factors of N point FFT: sine
+    std::vector<epicsUInt32> m_adwRev;    ///< bit reversal permutation of N/2 point FFT
+    std::vector<double>      m_adPower;   ///< accumulated power of N/2+1 bins
+};
+
+/// software oscilloscope of a module: level trigger on one channel, captures all channels
+class mccdaqhatsScope
+{
+public:
+    /// trigger mode, same order as parameter enumeration
+    enum ScopeMode
+    {
+        SCOPE_OFF = 0,  ///< disabled
+        SCOPE_AUTO,     ///< trigger or forced capture after "pre+post" samples without trigger
+        SCOPE_NORMAL,   ///< capture on every trigger
+        SCOPE_SINGLE,   ///< capture on next trigger after arming only
+        SCOPE_MODES
+    };
+
+    /// trigger slope, same order as parameter enumeration
+    enum ScopeSlope
+    {
+        SLOPE_RISING = 0, ///< trigger, if the signal rises above the level
+        SLOPE_FALLING     ///< trigger, if the signal falls below the level
+    };
+
+    /// scope state, same order as parameter enumeration
+    enum ScopeState
+    {
+        STATE_IDLE = 0, ///< disabled
+        STATE_WAITING,  ///< waiting for trigger
+        STATE_TRIGGERED,///< triggered, acquiring post-trigger samples
+        STATE_DONE      ///< single capture done, waiting for arming
+    };
+
+    mccdaqhatsScope();
+    bool          configure(int iMode, int iSource, double dLevel, int iSlope, double dHyst, int iPre, int iPost);
+    void          reset();
+    void          arm();
+    bool          process(const double* const apdIn[8], size_t uCount);
+    int           state() const    { return m_iState; }
+    epicsUInt32   count() const    { return m_dwCount; }
+    size_t        length() const   { return m_uLength; }
+    const double* capture(int iChannel) const { return m_uLength ? &m_adCapture[iChannel][0] : nullptr; }
+
+private:
+    void push(const double* const apdIn[8], size_t uPos, size_t uCount);
+    void finish();
+
+    int                 m_iMode;          ///< enum \ref ScopeMode
+    int                 m_iSource;        ///< trigger channel
+    double              m_dLevel;         ///< trigger level
+    int                 m_iSlope;         ///< enum \ref ScopeSlope
+    double              m_dHyst;          ///< trigger hysteresis (>= 0)
+    size_t              m_uPre;           ///< number of samples before trigger
+    size_t              m_uPost;          ///< number of samples from trigger on
+    size_t              m_uLength;        ///< capture length "pre+post", ring size
+    int                 m_iState;         ///< enum \ref ScopeState
+    bool                m_bArmed;         ///< hysteresis: signal was on the other side of the level
+    size_t              m_uWrite;         ///< next write position of rings
+    size_t              m_uValid;         ///< number of valid samples in rings
+    size_t              m_uRemain;        ///< remaining post-trigger samples
+    size_t              m_uWait;          ///< auto mode: samples since arming
+    epicsUInt32         m_dwCount;        ///< number of captures
+    std::vector<double> m_adRing[8];      ///< pre-trigger history of every channel
+    std::vector<double> m_adCapture[8];   ///< last capture of every channel
+};
+
+/**
+ * @brief rolling history of a single channel: the ring is mapped twice into consecutive
+ *        virtual memory, so the latest samples are always contiguous without copying;
+ *        without mirrored mapping every sample is written twice into a buffer of double size
+ */
+class mccdaqhatsHistory
+{
+public:
+    mccdaqhatsHistory();
+    ~mccdaqhatsHistory();
+    bool          configure(size_t uLength, bool bMirror = true);
+    void          reset();
+    void          write(const double* pdIn, size_t uCount);
+    const double* data(size_t* puCount) const;
+    size_t        length() const   { return m_uLength; }
+    bool          mirrored() const { return m_bMirror; }
+
+private:
+    mccdaqhatsHistory(const mccdaqhatsHistory&);
+    mccdaqhatsHistory& operator=(const mccdaqhatsHistory&);
+    void release();
+
+    double*             m_pdBase;     ///< start of ring, mapped twice (2 * "m_uCapacity" samples)
+    size_t              m_uCapacity;  ///< ring size in samples (multiple of page size)
+    size_t              m_uLength;    ///< requested history length in samples
+    size_t              m_uWrite;     ///< next write position
+    size_t              m_uFill;      ///< number of valid samples
+    bool                m_bMirror;    ///< true: virtual memory mirror, false: "m_adFallback"
+    std::vector<double> m_adFallback; ///< buffer of double size without mirrored mapping
+};
+
+/**
+ * @brief min/max/mean level-of-detail pyramid of a single channel: every level is a ring of
+ *        buckets with twice the size of the level below, covering the same retention time
+ */
+class mccdaqhatsPyramid
+{
+public:
+    mccdaqhatsPyramid();
+    bool   configure(double dRate, double dTime);
+    void   reset();
+    void   process(const double* pdIn, size_t uCount);
+    bool   envelope(double dAgo, double dSpan, size_t uWidth, std::vector<double>& adEnv,
+                    std::vector<double>& adMean, double* pdDt) const;
+    size_t levels() const { return m_aLevel.size(); }
+
+private:
+    /// aggregated samples
+    struct Bucket
+    {
+        float fMin;  ///< minimum
+        float fMax;  ///< maximum
+        float fMean; ///< mean
+    };
+
+    /// level of pyramid
+    struct Level
+    {
+        std::vector<Bucket> aBucket;     ///< ring of buckets
+        epicsUInt64         qwComplete;  ///< number of completed buckets since reset
+    };
+
+    void push(size_t uLevel, Bucket bucket);
+
+    double             m_dRate;      ///< sample rate in Hz
+    double             m_dTime;      ///< retention time in seconds
+    size_t             m_uBase;      ///< samples per bucket of level 0 (power of two)
+    epicsUInt64        m_qwSamples;  ///< number of samples since reset
+    size_t             m_uPartial;   ///< number of samples in partial bucket of level 0
+    double             m_dMin;       ///< partial bucket: minimum
+    double             m_dMax;       ///< partial bucket: maximum
+    double             m_dSum;       ///< partial bucket: sum
+    std::vector<Level> m_aLevel;     ///< levels of pyramid
+};
+
+/// engineering unit conversion of a single channel
+class mccdaqhatsConversion
+{
+public:
+    /// conversion types, same order as parameter enumeration
+    enum ConversionMode
+    {
+        CONVERSION_OFF = 0,    ///< volts
+        CONVERSION_LINEAR,     ///< c0 + c1 * x
+        CONVERSION_POLYNOMIAL, ///< c0 + c1 * x + c2 * x^2 + ... + cN * x^N
+        CONVERSION_TABLE,      ///< linear interpolation of x0, y0, x1, y1, ... (ascending x)
+        CONVERSION_COUNT
+    };
+
+    mccdaqhatsConversion();
+    static const char* check(int iMode, const std::vector<double>& adCoef);
+    bool configure(int iMode, const std::vector<double>& adCoef);
+    int  mode() const { return m_iMode; }
+    double range() const { return m_dRange; }
+    void process(double* pdData, size_t uStride, size_t uCount);
+
+private:
+    int                 m_iMode;   ///< enum \ref ConversionMode
+    std::vector<double> m_adCoef;  ///< coefficients or table, as written
+    std::vector<double> m_adX;     ///< table: ascending x values
+    std::vector<double> m_adY;     ///< table: y values
+    size_t              m_uHint;   ///< table: segment of last value
+    double              m_dRange;  ///< maximum absolute output for inputs within ±MAX_INPUT_VOLTS
+};
+
+/// cascaded biquad IIR filter of a single channel, the state is kept across blocks
+class mccdaqhatsBiquad
+{
+public:
+    /// filter types, same order as parameter enumeration
+    enum BiquadType
+    {
+        BIQUAD_OFF = 0,  ///< disabled
+        BIQUAD_LOWPASS,  ///< 2nd order low-pass per stage
+        BIQUAD_HIGHPASS, ///< 2nd order high-pass per stage
+        BIQUAD_BANDPASS, ///< band-pass with 0 dB at center frequency
+        BIQUAD_NOTCH,    ///< notch at center frequency
+        BIQUAD_COUNT
+    };
+
+    mccdaqhatsBiquad();
+    bool configure(int iType, double dFreq, double dQ, int iStages, double dRate);
+    void reset();
+    int  type() const { return m_iType; }
+    void process(const double* pdIn, size_t uInStride, double* pdOut, size_t uOutStride, size_t uCount);
+
+private:
+    /// normalized coefficients and state of a single stage (transposed direct form II)
+    struct Stage
+    {
+        double dB0, dB1, dB2, dA1, dA2; ///< coefficients, a0=1
+        double dZ1, dZ2;                ///< state
+    };
+
+    int                m_iType;   ///< enum \ref BiquadType
+    double             m_dFreq;   ///< cutoff or center frequency in Hz
+    double             m_dQ;      ///< quality factor
+    double             m_dRate;   ///< sample rate in Hz
+    std::vector<Stage> m_aStage;  ///< cascaded stages (same coefficients)
+};
+
+/// level-crossing event detector of a single channel (threshold with hysteresis)
+class mccdaqhatsEvents
+{
+public:
+    /// detected edges, same order as parameter enumeration
+    enum EventMode
+    {
+        EVENT_OFF = 0, ///< disabled
+        EVENT_RISING,  ///< crossing of level upwards
+        EVENT_FALLING, ///< crossing of level downwards
+        EVENT_BOTH,    ///< both directions
+        EVENT_COUNT
+    };
+
+    mccdaqhatsEvents();
+    bool configure(int iMode, double dLevel, double dHyst);
+    void reset();
+    void restart();
+    int  mode() const { return m_iMode; }
+    epicsUInt32 count() const { return m_dwCount; }
+    size_t process(const double* pdIn, size_t uCount, std::vector<double>& adEvents);
+
+private:
+    int         m_iMode;      ///< enum \ref EventMode
+    double      m_dLevel;     ///< threshold
+    double      m_dHyst;      ///< hysteresis: distance of re-arm level from threshold
+    bool        m_bArmRise;   ///< signal was below (level - hysteresis) since last rising event
+    bool        m_bArmFall;   ///< signal was above (level + hysteresis) since last falling event
+    double      m_dPrev;      ///< last value of previous block (NaN=unknown)
+    epicsUInt32 m_dwCount;    ///< number of events since configuration
+};
+
+/**
+ * @brief reciprocal frequency counter of a single channel: it measures the periods between
+ *        interpolated rising level crossings and reports their mean and deviation per gate time
+ */
+class mccdaqhatsFrequency
+{
+public:
+    /// measurement of a gate time
+    struct Result
+    {
+        double dFreq;    ///< frequency in Hz, 0=no full period
+        double dPeriod;  ///< mean period in seconds, NaN=no full period
+        double dJitter;  ///< standard deviation of periods in seconds, NaN=no full period
+    };
+
+    mccdaqhatsFrequency();
+    bool configure(double dGate, double dLevel, double dHyst, double dRate);
+    void reset();
+    bool enabled() const { return m_qwGateLen != 0; }
+    bool process(const double* pdIn, size_t uCount, Result& result);
+
+private:
+    mccdaqhatsEvents    m_events;     ///< detector of rising crossings
+    std::vector<double> m_adEvents;   ///< crossings of current block
+    double              m_dGate;      ///< gate time in seconds, 0=disabled
+    double              m_dLevel;     ///< threshold
+    double              m_dHyst;      ///< hysteresis
+    double              m_dRate;      ///< sample rate in Hz
+    epicsUInt64         m_qwGateLen;  ///< gate time in samples, 0=disabled
+    epicsUInt64         m_qwGatePos;  ///< samples since start of gate
+    double              m_dLast;      ///< position of last crossing relative to next block (NaN=none)
+    epicsUInt64         m_qwPeriods;  ///< number of periods in current gate
+    double              m_dMean;      ///< mean period in samples (Welford)
+    double              m_dM2;        ///< sum of squared deviations (Welford)
+};
+
+/**
+ * @brief arithmetic expression over the channels of a module: it is compiled once into a
+ *        postfix plan, which is evaluated for whole blocks (every operation is a simple loop)
+ */
+class mccdaqhatsExpression
+{
+public:
+    mccdaqhatsExpression();
+    bool compile(const std::string& sExpression, std::string* psError = nullptr);
+    void clear();
+    bool empty() const { return m_aPlan.empty(); }
+    const std::string& text() const { return m_sText; }
+    int  channels() const { return m_iChannels; }
+    void evaluate(const double* const apdIn[8], size_t uCount, double* pdOut);
+
+private:
+    /// operation codes of the plan
+    enum OpCode
+    {
+        OP_CONST = 0, ///< push constant
+        OP_CHANNEL,   ///< push channel
+        OP_ADD,       ///< a + b
+        OP_SUB,       ///< a - b
+        OP_MUL,       ///< a * b
+        OP_DIV,       ///< a / b
+        OP_NEG,       ///< -a
+        OP_ABS,       ///< abs(a)
+        OP_SQRT,      ///< sqrt(a)
+        OP_MIN,       ///< min(a, b)
+        OP_MAX        ///< max(a, b)
+    };
+
+    /// step of the plan
+    struct Op
+    {
+        int    iCode;    ///< enum \ref OpCode
+        int    iChannel; ///< OP_CHANNEL: channel number
+        double dValue;   ///< OP_CONST: value
+    };
+
+    /// entry of the evaluation stack
+    struct Entry
+    {
+        bool                bConst; ///< true: "dValue", false: "pdData"
+        double              dValue; ///< constant value
+        const double*       pdData; ///< values of block: channel data or "adData"
+        std::vector<double> adData; ///< own buffer of intermediate values
+    };
+
+    bool parseSum(const char*& szPos);
+    bool parseProduct(const char*& szPos);
+    bool parseUnary(const char*& szPos);
+    bool parsePrimary(const char*& szPos);
+    void emit(int iCode, int iChannel = 0, double dValue = 0.);
+
+    std::string        m_sText;     ///< source text
+    std::string        m_sError;    ///< compiler error
+    std::vector<Op>    m_aPlan;     ///< postfix plan
+    std::vector<Entry> m_aStack;    ///< evaluation stack (allocated by "compile")
+    int                m_iChannels; ///< bit mask of used channels
+};
+
+/// deadband filter of a scalar value: it decides, if a new value is published
+class mccdaqhatsDeadband
+{
+public:
+    /// deadband types, same order as parameter enumeration
+    enum DeadbandMode
+    {
+        DEADBAND_ABSOLUTE = 0, ///< change in units of the value
+        DEADBAND_RELATIVE,     ///< change in percent of the last published value
+        DEADBAND_COUNT
+    };
+
+    mccdaqhatsDeadband();
+    bool configure(double dDeadband, int iMode);
+    void reset() { m_bValid = false; }
+    bool check(double dValue);
+
+private:
+    double m_dDeadband; ///< allowed change without publishing
+    int    m_iMode;     ///< enum \ref DeadbandMode
+    double m_dLast;     ///< last published value
+    bool   m_bValid;    ///< "m_dLast" is valid
+};
+
+#endif /*MCCDAQHATSDSP_INCLUDED*/
@@ -0,0 +1,544 @@
+/*
+ * SPDX-License-Identifier: EPICS
+ * Helmholtz-Zentrum Berlin fuer Materialien und Energie GmbH 2023-2024
+ * Lutz Rossa <rossa@helmholtz-berlin.de>
+ */
+#include <math.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <epicsMath.h>
+#include <epicsUnitTest.h>
+#include <testMain.h>
+#include "mccdaqhatsDsp.h"
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+/**
+ * @brief reproducible pseudo random numbers (linear congruential generator)
+ * @param[in,out] dwSeed  state of generator
+ * @return value in range -1…1
+ */
+static double testRandom(epicsUInt32& dwSeed)
+{
+    dwSeed = dwSeed * 1664525u + 1013904223u;
+    return static_cast<double>(dwSeed >> 8) / static_cast<double>(1u << 23) - 1.;
+}
+
+/// @brief DC gain of all decimation filters, also across block boundaries
+static void testDecimator()
+{
+    static const char* aszNames[mccdaqhatsDecimator::FILTER_COUNT] = { "boxcar", "CIC", "FIR" };
+    const double dValue(-3.25);
+    std::vector<double> adIn(1000, dValue), adOut;
+
+    for (int iType = 0; iType < mccdaqhatsDecimator::FILTER_COUNT; ++iType)
+    {
+        mccdaqhatsDecimator decimator;
+        size_t uOut(0);
+        decimator.configure(10, iType);
+        for (size_t i = 0; i < adIn.size(); i += 333) // uneven blocks
+        {
+            size_t uCount(adIn.size() - i < 333 ? adIn.size() - i : 333);
+            uOut += decimator.process(&adIn[i], uCount, adOut);
+        }
+        testOk(uOut == adIn.size() / 10 && !adOut.empty() && fabs(adOut.back() - dValue) < 1e-9,
+               "%s: %u outputs, DC value %g (expected %g)", aszNames[iType], static_cast<unsigned>(uOut),
+               adOut.empty() ? 0. : adOut.back(), dValue);
+    }
+
+    // CIC with converted values above ±16: the fixed point scale follows the range
+    {
+        mccdaqhatsDecimator decimator;
+        std::vector<double> adLarge(100, 750.);
+        decimator.configure(10, mccdaqhatsDecimator::FILTER_CIC, 1000.);
+        decimator.process(&adLarge[0], adLarge.size(), adOut);
+        testOk(!adOut.empty() && fabs(adOut.back() - 750.) < 1e-9, "CIC range 1000: DC value %g (expected 750)",
+               adOut.empty() ? 0. : adOut.back());
+    }
+
+    // FIR is limited to factors with full length filters, other types are not
+    {
+        mccdaqhatsDecimator fir, cic;
+        fir.configure(4096, mccdaqhatsDecimator::FILTER_FIR);
+        cic.configure(4096, mccdaqhatsDecimator::FILTER_CIC);
+        testOk(fir.factor() == mccdaqhatsDecimator::MAX_FIR_FACTOR && cic.factor() == 4096,
+               "factor 4096: FIR uses %d, CIC uses %d", fir.factor(), cic.factor());
+    }
+}
+
+
+/// @brief Welford/Chan accumulators against a two pass reference
+static void testStatistics()
+{
+    const size_t uCount(10000), uWindow(100);
+    std::vector<double> adIn(uCount);
+    epicsUInt32 dwSeed(12345);
+    mccdaqhatsStatistics stat;
+    mccdaqhatsStatistics::Result result;
+    double dMean(0.), dM2(0.), dMin(1e300), dMax(-1e300);
+    bool bOk(false);
+
+    for (size_t i = 0; i < uCount; ++i)
+        adIn[i] = 1000. + testRandom(dwSeed); // large offset: the naive sum of squares loses precision
+    for (size_t i = 0; i < uCount; ++i)
+        dMean += adIn[i];
+    dMean /= static_cast<double>(uCount);
+    for (size_t i = 0; i < uCount; ++i)
+    {
+        dM2 += (adIn[i] - dMean) * (adIn[i] - dMean);
+        if (adIn[i] < dMin) dMin = adIn[i];
+        if (adIn[i] > dMax) dMax = adIn[i];
+    }
+
+    // cumulative: merged blocks of different length
+    stat.configure(mccdaqhatsStatistics::STAT_CUMULATIVE, 0);
+    for (size_t i = 0; i < uCount; i += 777)
+        bOk = stat.process(&adIn[i], (uCount - i < 777) ? (uCount - i) : 777, result);
+    testOk(bOk && result.qwCount == uCount, "cumulative: %u samples", static_cast<unsigned>(result.qwCount));
+    testOk(fabs(result.dMean - dMean) < 1e-10, "cumulative: mean %.12g (expected %.12g)", result.dMean, dMean);
+    testOk(fabs(result.dStd - sqrt(dM2 / static_cast<double>(uCount - 1))) < 1e-10,
+           "cumulative: std %.12g (expected %.12g)", result.dStd, sqrt(dM2 / static_cast<double>(uCount - 1)));
+    testOk(result.dMin == dMin && result.dMax == dMax, "cumulative: min %g max %g", result.dMin, result.dMax);
+
+    // sliding: last N samples
+    dMean = dM2 = 0.;
+    dMin = 1e300;
+    dMax = -1e300;
+    for (size_t i = uCount - uWindow; i < uCount; ++i)
+        dMean += adIn[i];
+    dMean /= static_cast<double>(uWindow);
+    for (size_t i = uCount - uWindow; i < uCount; ++i)
+    {
+        dM2 += (adIn[i] - dMean) * (adIn[i] - dMean);
+        if (adIn[i] < dMin) dMin = adIn[i];
+        if (adIn[i] > dMax) dMax = adIn[i];
+    }
+    stat.configure(mccdaqhatsStatistics::STAT_SLIDING, static_cast<int>(uWindow));
+    for (size_t i = 0; i < uCount; i += 333)
+        bOk = stat.process(&adIn[i], (uCount - i < 333) ? (uCount - i) : 333, result);
+    testOk(bOk && result.qwCount == uWindow && fabs(result.dMean - dMean) < 1e-9
+           && fabs(result.dStd - sqrt(dM2 / static_cast<double>(uWindow - 1))) < 1e-9,
+           "sliding: mean %.12g std %.12g", result.dMean, result.dStd);
+    testOk(result.dMin == dMin && result.dMax == dMax, "sliding: min %g max %g", result.dMin, result.dMax);
+}
+
+/// @brief amplitude and PSD scaling of the spectrum with a bin centered sine
+static void testSpectrum()
+{
+    const size_t uSize(1024), uBin(64);
+    const double dRate(10000.), dAmpl(2.), dOffset(0.5);
+    std::vector<double> adIn(uSize), adOut;
+    mccdaqhatsSpectrum spectrum;
+    double dSum(0.);
+
+    for (size_t i = 0; i < uSize; ++i)
+        adIn[i] = dOffset + dAmpl * sin(2. * M_PI * static_cast<double>(uBin * i) / static_cast<double>(uSize));
+
+    // rectangular window: the sine falls into a single bin
+    spectrum.configure(mccdaqhatsSpectrum::OUTPUT_MAGNITUDE, static_cast<int>(uSize), mccdaqhatsSpectrum::WINDOW_RECT, 0, 1);
+    bool bReady(spectrum.process(&adIn[0], uSize, dRate, adOut));
+    testOk(bReady && adOut.size() == uSize / 2 + 1,
+           "magnitude spectrum with %u bins", static_cast<unsigned>(uSize / 2 + 1));
+    testOk(fabs(adOut[uBin] - dAmpl) < 1e-9, "rect: sine amplitude %g (expected %g)", adOut[uBin], dAmpl);
+    testOk(fabs(adOut[0] - dOffset) < 1e-9, "rect: DC value %g (expected %g)", adOut[0], dOffset);
+
+    // Hann window: the coherent gain is compensated
+    spectrum.configure(mccdaqhatsSpectrum::OUTPUT_MAGNITUDE, static_cast<int>(uSize), mccdaqhatsSpectrum::WINDOW_HANN, 0, 1);
+    spectrum.process(&adIn[0], uSize, dRate, adOut);
+    testOk(fabs(adOut[uBin] - dAmpl) < 1e-9, "hann: sine amplitude %g (expected %g)", adOut[uBin], dAmpl);
+
+    // PSD: the integral over all bins except DC is the mean square of the sine
+    spectrum.configure(mccdaqhatsSpectrum::OUTPUT_PSD, static_cast<int>(uSize), mccdaqhatsSpectrum::WINDOW_HANN, 0, 1);
+    spectrum.process(&adIn[0], uSize, dRate, adOut);
+    for (size_t k = 2; k < adOut.size(); ++k)
+        dSum += adOut[k] * dRate / static_cast<double>(uSize);
+    testOk(fabs(dSum - 0.5 * dAmpl * dAmpl) < 1e-6, "hann: PSD integral %g (expected %g)", dSum, 0.5 * dAmpl * dAmpl);
+
+    // Welch averaging of a stationary signal does not change the result
+    spectrum.configure(mccdaqhatsSpectrum::OUTPUT_MAGNITUDE, static_cast<int>(uSize), mccdaqhatsSpectrum::WINDOW_HANN, 50, 4);
+    adIn.resize(4 * uSize);
+    for (size_t i = 0; i < adIn.size(); ++i)
+        adIn[i] = dOffset + dAmpl * sin(2. * M_PI * static_cast<double>(uBin * i) / static_cast<double>(uSize));
+    bReady = spectrum.process(&adIn[0], adIn.size(), dRate, adOut);
+    testOk(bReady && fabs(adOut[uBin] - dAmpl) < 1e-9,
+           "welch: sine amplitude %g (expected %g)", adOut[uBin], dAmpl);
+}
+
+/**
+ * @brief feed a trigger signal and its sample index as 2nd channel in uneven blocks into a scope
+ * @param[in,out] scope   scope under test
+ * @param[in]     adTrig  trigger signal (channel 0)
+ * @param[in]     uBlock  block size
+ * @return true, if any block completed a capture
+ */
+static bool testScopeFeed(mccdaqhatsScope& scope, const std::vector<double>& adTrig, size_t uBlock)
+{
+    std::vector<double> adIndex(adTrig.size());
+    bool bResult(false);
+    for (size_t i = 0; i < adIndex.size(); ++i)
+        adIndex[i] = static_cast<double>(i);
+    for (size_t i = 0; i < adTrig.size(); i += uBlock)
+    {
+        const double* apdIn[8] = { &adTrig[i], &adIndex[i], nullptr, nullptr, nullptr, nullptr, nullptr, nullptr };
+        if (scope.process(apdIn, (adTrig.size() - i < uBlock) ? (adTrig.size() - i) : uBlock))
+            bResult = true;
+    }
+    return bResult;
+}
+
+/// @brief pre-trigger history, hysteresis, auto and single mode of the software oscilloscope
+static void testScope()
+{
+    std::vector<double> adTrig(40, -1.);
+    const double* pdCapture(nullptr);
+    bool bReady(false);
+
+    // an edge before the pre-trigger history is filled does not trigger
+    {
+        mccdaqhatsScope scope;
+        scope.configure(mccdaqhatsScope::SCOPE_NORMAL, 0, 0.5, mccdaqhatsScope::SLOPE_RISING, 0., 10, 5);
+        for (size_t i = 2; i < 6; ++i)
+            adTrig[i] = 1.;
+        for (size_t i = 20; i < adTrig.size(); ++i)
+            adTrig[i] = 1.;
+        bReady = testScopeFeed(scope, adTrig, 7);
+        testOk(bReady && scope.count() == 1 && scope.length() == 15,
+               "pre-trigger: %u capture(s) of %u samples", static_cast<unsigned>(scope.count()),
+               static_cast<unsigned>(scope.length()));
+        pdCapture = scope.capture(1);
+        testOk(pdCapture && pdCapture[0] == 10. && pdCapture[10] == 20. && pdCapture[14] == 24.,
+               "pre-trigger: capture starts at sample %g, trigger at %g", pdCapture ? pdCapture[0] : -1.,
+               pdCapture ? pdCapture[10] : -1.);
+        testOk(scope.state() == mccdaqhatsScope::STATE_WAITING, "normal: waiting for next trigger");
+    }
+
+    // noise inside the hysteresis does not arm the trigger
+    {
+        mccdaqhatsScope scope;
+        scope.configure(mccdaqhatsScope::SCOPE_NORMAL, 0, 0., mccdaqhatsScope::SLOPE_RISING, 0.5, 2, 3);
+        for (size_t i = 0; i < adTrig.size(); ++i)
+            adTrig[i] = (i & 1) ? 0.2 : -0.2;
+        adTrig[30] = -1.;
+        adTrig[31] = 0.;
+        bReady    = testScopeFeed(scope, adTrig, 8);
+        pdCapture = scope.capture(1);
+        testOk(bReady && scope.count() == 1 && pdCapture && pdCapture[2] == 31.,
+               "hysteresis: %u capture(s), trigger at %g (expected 31)", static_cast<unsigned>(scope.count()),
+               pdCapture ? pdCapture[2] : -1.);
+    }
+
+    // auto: forced capture without trigger
+    {
+        mccdaqhatsScope scope;
+        scope.configure(mccdaqhatsScope::SCOPE_AUTO, 0, 5., mccdaqhatsScope::SLOPE_RISING, 0., 4, 4);
+        adTrig.assign(40, 0.);
+        bReady = testScopeFeed(scope, adTrig, 9);
+        testOk(bReady && scope.count() >= 2, "auto: %u forced capture(s)",
+               static_cast<unsigned>(scope.count()));
+    }
+
+    // single: one capture until armed again
+    {
+        mccdaqhatsScope scope;
+        scope.configure(mccdaqhatsScope::SCOPE_SINGLE, 0, 0., mccdaqhatsScope::SLOPE_FALLING, 0., 2, 2);
+        for (size_t i = 0; i < adTrig.size(); ++i)
+            adTrig[i] = (i & 4) ? -1. : 1.; // falling edge every 8 samples
+        testScopeFeed(scope, adTrig, 5);
+        testOk(scope.count() == 1 && scope.state() == mccdaqhatsScope::STATE_DONE, "single: %u capture(s), state %d",
+               static_cast<unsigned>(scope.count()), scope.state());
+        scope.arm();
+        testScopeFeed(scope, adTrig, 5);
+        testOk(scope.count() == 2 && scope.state() == mccdaqhatsScope::STATE_DONE, "single: %u capture(s) after arming",
+               static_cast<unsigned>(scope.count()));
+    }
+}
+
+/// @brief contiguous history after wrap-around with mirrored mapping and with double writes
+static void testHistory()
+{
+    static const char* aszNames[2] = { "fallback", "mirror" };
+    const size_t uLength(1000), uTotal(5000);
+    std::vector<double> adIn(uTotal);
+
+    for (size_t i = 0; i < uTotal; ++i)
+        adIn[i] = static_cast<double>(i);
+    for (int iMirror = 0; iMirror < 2; ++iMirror)
+    {
+        mccdaqhatsHistory history;
+        const double* pdHist(nullptr);
+        size_t uCount(0), uErrors(0);
+        history.configure(uLength, iMirror != 0);
+        if (iMirror)
+            testDiag("history uses %s", history.mirrored() ? "a mirrored mapping" : "double writes");
+        else
+            testOk(!history.mirrored(), "fallback: double writes");
+
+        // partially filled
+        history.write(&adIn[0], 100);
+        pdHist = history.data(&uCount);
+        testOk(pdHist && uCount == 100 && pdHist[0] == 0. && pdHist[99] == 99., "%s: %u samples before wrap",
+               aszNames[iMirror], static_cast<unsigned>(uCount));
+
+        // uneven blocks: the ring wraps inside of many blocks
+        for (size_t i = 100; i < uTotal; i += 333)
+            history.write(&adIn[i], (uTotal - i < 333) ? (uTotal - i) : 333);
+        pdHist = history.data(&uCount);
+        for (size_t i = 0; pdHist && i < uCount; ++i)
+            if (pdHist[i] != static_cast<double>(uTotal - uCount + i))
+                ++uErrors;
+        testOk(pdHist && uCount == uLength && !uErrors, "%s: %u contiguous samples after wrap, %u errors",
+               aszNames[iMirror], static_cast<unsigned>(uCount), static_cast<unsigned>(uErrors));
+
+        // a block larger than the ring keeps its latest samples
+        history.write(&adIn[0], uTotal);
+        pdHist = history.data(&uCount);
+        testOk(pdHist && uCount == uLength && pdHist[0] == static_cast<double>(uTotal - uLength) &&
+               pdHist[uLength - 1] == static_cast<double>(uTotal - 1), "%s: large block", aszNames[iMirror]);
+    }
+}
+
+/**
+ * @brief check an envelope of a ramp (value = sample number): every pixel covers 1…3 whole buckets,
+ *        pixels after the latest completed bucket are empty
+ * @param[in] adEnv    minimum and maximum of every pixel
+ * @param[in] uBucket  expected bucket size of the chosen level
+ * @return number of pixels, which do not match
+ */
+static size_t testEnvelopeBuckets(const std::vector<double>& adEnv, size_t uBucket)
+{
+    size_t uErrors(0);
+    for (size_t i = 0; i < adEnv.size(); i += 2)
+    {
+        double dWidth(adEnv[i + 1] - adEnv[i] + 1.);
+        if (isnan(adEnv[i]) && i > 0)
+            continue;
+        if (!(dWidth > 0.) || fmod(adEnv[i], static_cast<double>(uBucket)) != 0. ||
+            fmod(dWidth, static_cast<double>(uBucket)) != 0. || dWidth > 3. * static_cast<double>(uBucket))
+            ++uErrors;
+    }
+    return uErrors;
+}
+
+/// @brief level choice and ring indexing of the min/max/mean pyramid after wrap-around
+static void testPyramid()
+{
+    const double dRate(1000.), dTime(10.); // 10000 samples: 625 base buckets of 16 samples
+    const size_t uTotal(35000);            // all rings wrapped several times
+    std::vector<double> adIn(uTotal), adEnv, adMean;
+    mccdaqhatsPyramid pyramid;
+    size_t uErrors(0);
+    double dDt(0.);
+    bool bOk(false);
+
+    for (size_t i = 0; i < uTotal; ++i)
+        adIn[i] = static_cast<double>(i);
+    pyramid.configure(dRate, dTime);
+    for (size_t i = 0; i < uTotal; i += 777)
+        pyramid.process(&adIn[i], (uTotal - i < 777) ? (uTotal - i) : 777);
+    testOk(pyramid.levels() == 6, "%u levels", static_cast<unsigned>(pyramid.levels()));
+
+    // 5 samples per pixel: base level, the last 8 samples are not complete
+    bOk = pyramid.envelope(0., 0.5, 100, adEnv, adMean, &dDt);
+    uErrors = testEnvelopeBuckets(adEnv, 16);
+    testOk(bOk && !uErrors && fabs(dDt - 0.005) < 1e-12, "zoomed in: base buckets, %u errors, dt %g",
+           static_cast<unsigned>(uErrors), dDt);
+
+    // 80 samples per pixel: level of 64 samples per bucket
+    bOk = pyramid.envelope(0., 8., 100, adEnv, adMean, &dDt);
+    uErrors = testEnvelopeBuckets(adEnv, 64);
+    testOk(bOk && !uErrors && fabs(dDt - 0.08) < 1e-12, "zoomed out: 64 samples per bucket, %u errors, dt %g",
+           static_cast<unsigned>(uErrors), dDt);
+
+    // after wrap-around the pixels are in order and end with the latest completed bucket
+    uErrors = 0;
+    for (size_t i = 1; i < adMean.size(); ++i)
+        if (!(adMean[i] > adMean[i - 1]) || !(adEnv[2 * i] >= adEnv[2 * i - 2]))
+            ++uErrors;
+    testOk(!uErrors && adEnv.back() == 34943., "wrapped rings: %u errors, latest maximum %g (expected 34943)",
+           static_cast<unsigned>(uErrors), adEnv.back());
+
+    // older than retention time: no data
+    bOk = pyramid.envelope(20., 1., 10, adEnv, adMean, &dDt);
+    testOk(bOk && isnan(adEnv[0]) && isnan(adMean[9]), "expired range: NaN");
+}
+
+/**
+ * @brief feed values into a deadband
+ * @param[in,out] deadband  deadband under test
+ * @param[in]     adIn      values
+ * @param[in]     uCount    number of values
+ * @return string with "1" for every published and "0" for every suppressed value
+ */
+static std::string testDeadbandFeed(mccdaqhatsDeadband& deadband, const double* adIn, size_t uCount)
+{
+    std::string sResult;
+    for (size_t i = 0; i < uCount; ++i)
+        sResult += deadband.check(adIn[i]) ? '1' : '0';
+    return sResult;
+}
+
+/// @brief absolute and relative deadband, NaN values and configuration changes
+static void testDeadband()
+{
+    const double dNaN(static_cast<double>(epicsNAN));
+    const double adAbs[] = { 1., 1.4, 1.6, 1.2, 1.0 };
+    const double adRel[] = { 100., 109., 111., 101., 99. };
+    const double adZero[] = { 0., 0.001, 0.001 };
+    const double adNaN[] = { 5., dNaN, dNaN, 5., 5.1 };
+    mccdaqhatsDeadband deadband;
+    std::string sResult;
+
+    deadband.configure(0.5, mccdaqhatsDeadband::DEADBAND_ABSOLUTE);
+    sResult = testDeadbandFeed(deadband, adAbs, sizeof(adAbs) / sizeof(adAbs[0]));
+    testOk(sResult == "10101", "absolute 0.5: %s (expected 10101)", sResult.c_str());
+
+    // the deadband is a percentage of the last published value
+    testOk(deadband.configure(10., mccdaqhatsDeadband::DEADBAND_RELATIVE), "relative: configuration changed");
+    sResult = testDeadbandFeed(deadband, adRel, sizeof(adRel) / sizeof(adRel[0]));
+    testOk(sResult == "10101", "relative 10%%: %s (expected 10101)", sResult.c_str());
+    deadband.reset();
+    sResult = testDeadbandFeed(deadband, adZero, sizeof(adZero) / sizeof(adZero[0]));
+    testOk(sResult == "110", "relative to zero: %s (expected 110)", sResult.c_str());
+
+    // changes from and to NaN are published once
+    deadband.configure(1., mccdaqhatsDeadband::DEADBAND_ABSOLUTE);
+    sResult = testDeadbandFeed(deadband, adNaN, sizeof(adNaN) / sizeof(adNaN[0]));
+    testOk(sResult == "11010", "NaN: %s (expected 11010)", sResult.c_str());
+
+    // a new configuration publishes the next value
+    testOk(!deadband.configure(1., mccdaqhatsDeadband::DEADBAND_ABSOLUTE) && !deadband.check(5.1) &&
+           deadband.configure(2., mccdaqhatsDeadband::DEADBAND_ABSOLUTE) && deadband.check(5.1),
+           "configuration change publishes the next value");
+}
+
+/// @brief engineering unit conversion: linear and table with extrapolation
+static void testConversion()
+{
+    mccdaqhatsConversion conv;
+    std::vector<double> adCoef;
+    double adData[4] = { -1., 0., 1.5, 3. };
+
+    adCoef.push_back(10.);
+    adCoef.push_back(2.);
+    testOk(conv.configure(mccdaqhatsConversion::CONVERSION_LINEAR, adCoef), "linear conversion configured");
+    conv.process(adData, 2, 2); // every 2nd value of an interleaved block
+    testOk(adData[0] == 8. && adData[1] == 0. && adData[2] == 13. && adData[3] == 3., "linear: %g %g %g %g",
+           adData[0], adData[1], adData[2], adData[3]);
+    testOk(conv.range() == 10. + 2. * 16., "linear: range %g (expected 42)", conv.range());
+
+    adCoef.clear();
+    adCoef.push_back(0.);  adCoef.push_back(0.);
+    adCoef.push_back(1.);  adCoef.push_back(10.);
+    adCoef.push_back(2.);  adCoef.push_back(30.);
+    testOk(mccdaqhatsConversion::check(mccdaqhatsConversion::CONVERSION_TABLE, std::vector<double>(3, 0.)) != nullptr,
+           "table with odd number of values is refused");
+    conv.configure(mccdaqhatsConversion::CONVERSION_TABLE, adCoef);
+    adData[0] = -1.; adData[1] = 0.5; adData[2] = 1.5; adData[3] = 3.;
+    conv.process(adData, 1, 4);
+    testOk(adData[0] == -10. && adData[1] == 5. && adData[2] == 20. && adData[3] == 50., "table: %g %g %g %g",
+           adData[0], adData[1], adData[2], adData[3]);
+}
+
+/// @brief compiler errors and evaluation of virtual channel expressions
+static void testExpression()
+{
+    static const struct { const char* szText; const char* szError; } aErrors[] =
+        { { "C0 +",         "unexpected end" },
+          { "FOO(C0)",      "unknown name" },
+          { "MIN(C0 C1)",   "missing ," },
+          { "(C0 + C1",     "missing )" },
+          { "SQRT C0",      "missing (" },
+          { "C0 C1",        "unexpected character" } };
+    const double adC0[3] = { 1., 4., -9. }, adC1[3] = { 2., 3., 1. };
+    const double* apdIn[8] = { adC0, adC1, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr };
+    double adOut[3] = { 0., 0., 0. };
+    mccdaqhatsExpression expr;
+
+    for (size_t i = 0; i < sizeof(aErrors) / sizeof(aErrors[0]); ++i)
+    {
+        std::string sError;
+        bool bOk(expr.compile(aErrors[i].szText, &sError));
+        testOk(!bOk && sError.compare(0, strlen(aErrors[i].szError), aErrors[i].szError) == 0,
+               "\"%s\": %s", aErrors[i].szText, sError.c_str());
+    }
+    testOk(expr.empty(), "failed compilation keeps the old (empty) expression");
+    testOk(expr.compile("max(C0, c1) * 2 - sqrt(abs(C0)) / -1") && expr.channels() == 3, "valid expression");
+    expr.evaluate(apdIn, 3, adOut);
+    testOk(adOut[0] == 5. && adOut[1] == 10. && adOut[2] == 5., "evaluation %g %g %g (expected 5 10 5)",
+           adOut[0], adOut[1], adOut[2]);
+}
+
+/// @brief DC gain of the biquad filter types
+static void testBiquad()
+{
+    static const struct { int iType; const char* szName; double dGain; } aTypes[] =
+        { { mccdaqhatsBiquad::BIQUAD_LOWPASS,  "low-pass",  1. },
+          { mccdaqhatsBiquad::BIQUAD_HIGHPASS, "high-pass", 0. },
+          { mccdaqhatsBiquad::BIQUAD_BANDPASS, "band-pass", 0. },
+          { mccdaqhatsBiquad::BIQUAD_NOTCH,    "notch",     1. } };
+    std::vector<double> adIn(20000, 2.5), adOut(adIn.size());
+
+    for (size_t i = 0; i < sizeof(aTypes) / sizeof(aTypes[0]); ++i)
+    {
+        mccdaqhatsBiquad biquad;
+        biquad.configure(aTypes[i].iType, 100., 0.707, 2, 10000.);
+        biquad.process(&adIn[0], 1, &adOut[0], 1, adIn.size() / 2); // two blocks: state is kept
+        biquad.process(&adIn[adIn.size() / 2], 1, &adOut[adIn.size() / 2], 1, adIn.size() / 2);
+        testOk(fabs(adOut.back() - 2.5 * aTypes[i].dGain) < 1e-6, "%s: DC output %g (expected %g)",
+               aTypes[i].szName, adOut.back(), 2.5 * aTypes[i].dGain);
+    }
+}
+
+/// @brief level crossings and frequency counter with a sine
+static void testEvents()
+{
+    const double dRate(10000.), dFreq(123.);
+    std::vector<double> adIn(10000), adEvents;
+    mccdaqhatsEvents events;
+    mccdaqhatsFrequency freq;
+    mccdaqhatsFrequency::Result result;
+    bool bResult(false);
+
+    for (size_t i = 0; i < adIn.size(); ++i)
+        adIn[i] = sin(2. * M_PI * dFreq * static_cast<double>(i) / dRate + 0.1);
+    events.configure(mccdaqhatsEvents::EVENT_RISING, 0., 0.1);
+    events.process(&adIn[0], adIn.size() / 2, adEvents);
+    events.process(&adIn[adIn.size() / 2], adIn.size() / 2, adEvents);
+    testOk(events.count() == 123, "rising events: %u (expected 123)", static_cast<unsigned>(events.count()));
+
+    freq.configure(0.5, 0., 0.1, dRate);
+    for (size_t i = 0; i < adIn.size(); i += 1000)
+        bResult |= freq.process(&adIn[i], 1000, result);
+    testOk(bResult && fabs(result.dFreq - dFreq) < 1e-3, "frequency %.6g Hz (expected %g Hz)", result.dFreq, dFreq);
+}
+
+MAIN(mccdaqhatsDspTest)
+{
+    testPlan(62);
+    testDiag("decimator");
+    testDecimator();
+    testDiag("statistics");
+    testStatistics();
+    testDiag("spectrum");
+    testSpectrum();
+    testDiag("scope");
+    testScope();
+    testDiag("history");
+    testHistory();
+    testDiag("pyramid");
+    testPyramid();
+    testDiag("deadband");
+    testDeadband();
+    testDiag("conversion");
+    testConversion();
+    testDiag("expression");
+    testExpression();
+    testDiag("biquad");
+    testBiquad();
+    testDiag("events");
+    testEvents();
+    return testDone();
+}